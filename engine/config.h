@@ -15,6 +15,8 @@
 #include <xmmintrin.h>
 #include <assert.h>
 
+typedef uint64_t	uint64;
+typedef int64_t		int64;
 typedef uint32_t	uint32;
 typedef int32_t		int32;
 typedef uint16_t	uint16;
@@ -0,0 +1,773 @@
+#include "config.h"
+#include "bcEncoder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "mipGenerator.h"
+#include "textureContainer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BCN_SSE 1
+#endif
+
+namespace Resource::BCn {
+
+	// a 4x4 block as channel planes, four pixels of one channel fill a SSE register
+	struct Block {
+		alignas(16) float c[4][16];
+	};
+
+	using Palette = float[16][4];
+
+	static Block LoadBlock(const uchar* rgba) {
+		Block b;
+		for (int i = 0; i < 16; ++i) {
+			for (int ch = 0; ch < 4; ++ch) {
+				b.c[ch][i] = rgba[i * 4 + ch];
+			}
+		}
+		return b;
+	}
+
+	// nearest palette entry for every pixel over the first `channels` channels, returns the summed squared error
+	static float SelectIndices(const Block& b, int channels, const Palette& palette, int paletteSize, uchar* indices) {
+		float total = 0.0f;
+#ifdef BCN_SSE
+		for (int p = 0; p < 16; p += 4) {
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			for (int k = 0; k < paletteSize; ++k) {
+				__m128 d = _mm_setzero_ps();
+				for (int ch = 0; ch < channels; ++ch) {
+					const __m128 diff = _mm_sub_ps(_mm_load_ps(&b.c[ch][p]), _mm_set1_ps(palette[k][ch]));
+					d = _mm_add_ps(d, _mm_mul_ps(diff, diff));
+				}
+				const __m128 closer = _mm_cmplt_ps(d, best);
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)k)), _mm_andnot_ps(closer, bestIndex));
+			}
+
+			alignas(16) float index[4];
+			alignas(16) float error[4];
+			_mm_store_ps(index, bestIndex);
+			_mm_store_ps(error, best);
+			for (int i = 0; i < 4; ++i) {
+				indices[p + i] = (uchar)index[i];
+				total += error[i];
+			}
+		}
+#else
+		for (int p = 0; p < 16; ++p) {
+			float best = FLT_MAX;
+			for (int k = 0; k < paletteSize; ++k) {
+				float d = 0.0f;
+				for (int ch = 0; ch < channels; ++ch) {
+					const float diff = b.c[ch][p] - palette[k][ch];
+					d += diff * diff;
+				}
+				if (d < best) {
+					best = d;
+					indices[p] = (uchar)k;
+				}
+			}
+			total += best;
+		}
+#endif
+		return total;
+	}
+
+	// end points of the line the block's colors lie closest to
+	static void FitLine(const Block& b, int channels, BCQuality quality, float* lo, float* hi) {
+		float mean[4] = {};
+		float mn[4];
+		float mx[4];
+		for (int ch = 0; ch < channels; ++ch) {
+			mn[ch] = *std::min_element(b.c[ch], b.c[ch] + 16);
+			mx[ch] = *std::max_element(b.c[ch], b.c[ch] + 16);
+			for (int i = 0; i < 16; ++i) mean[ch] += b.c[ch][i];
+			mean[ch] /= 16.0f;
+		}
+
+		float cov[4][4] = {};
+		for (int i = 0; i < 16; ++i) {
+			for (int r = 0; r < channels; ++r) {
+				for (int c = 0; c < channels; ++c) {
+					cov[r][c] += (b.c[r][i] - mean[r]) * (b.c[c][i] - mean[c]);
+				}
+			}
+		}
+
+		if (quality == BCQuality::Fast) {
+			// bounding box, the diagonal is picked from the sign of the covariance with the first channel
+			for (int ch = 0; ch < channels; ++ch) {
+				lo[ch] = mn[ch];
+				hi[ch] = mx[ch];
+				if (ch > 0 && cov[0][ch] < 0.0f) std::swap(lo[ch], hi[ch]);
+			}
+		}
+		else {
+			// principal axis by power iteration, starting along the bounding box diagonal
+			float axis[4];
+			for (int ch = 0; ch < channels; ++ch) axis[ch] = mx[ch] - mn[ch];
+			for (int it = 0; it < 8; ++it) {
+				float next[4] = {};
+				float largest = 0.0f;
+				for (int r = 0; r < channels; ++r) {
+					for (int c = 0; c < channels; ++c) next[r] += cov[r][c] * axis[c];
+					largest = std::max(largest, std::abs(next[r]));
+				}
+				if (largest < 1e-6f) break;
+				for (int ch = 0; ch < channels; ++ch) axis[ch] = next[ch] / largest;
+			}
+
+			float len2 = 0.0f;
+			for (int ch = 0; ch < channels; ++ch) len2 += axis[ch] * axis[ch];
+			float tMin = 0.0f;
+			float tMax = 0.0f;
+			if (len2 > 1e-12f) {
+				tMin = FLT_MAX;
+				tMax = -FLT_MAX;
+				for (int i = 0; i < 16; ++i) {
+					float t = 0.0f;
+					for (int ch = 0; ch < channels; ++ch) t += (b.c[ch][i] - mean[ch]) * axis[ch];
+					t /= len2;
+					tMin = std::min(tMin, t);
+					tMax = std::max(tMax, t);
+				}
+			}
+			for (int ch = 0; ch < channels; ++ch) {
+				lo[ch] = std::clamp(mean[ch] + tMin * axis[ch], 0.0f, 255.0f);
+				hi[ch] = std::clamp(mean[ch] + tMax * axis[ch], 0.0f, 255.0f);
+			}
+		}
+
+		// pull the ends in a little, the interpolated entries then cover the middle of the block better
+		for (int ch = 0; ch < channels; ++ch) {
+			const float inset = (hi[ch] - lo[ch]) / 16.0f;
+			lo[ch] += inset;
+			hi[ch] -= inset;
+		}
+	}
+
+	// least squares end points for the given indices, weights[k] is how far entry k lies from e0 towards e1
+	static bool RefineEndpoints(const Block& b, int channels, const uchar* indices, const float* weights, float* e0, float* e1) {
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (int i = 0; i < 16; ++i) {
+			const float w = weights[indices[i]];
+			const float a = 1.0f - w;
+			aa += a * a;
+			ab += a * w;
+			bb += w * w;
+			for (int ch = 0; ch < channels; ++ch) {
+				ax[ch] += a * b.c[ch][i];
+				bx[ch] += w * b.c[ch][i];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) < 1e-6f) return false;
+		for (int ch = 0; ch < channels; ++ch) {
+			e0[ch] = std::clamp((bb * ax[ch] - ab * bx[ch]) / det, 0.0f, 255.0f);
+			e1[ch] = std::clamp((aa * bx[ch] - ab * ax[ch]) / det, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	//------------------------------------------------------------------------------
+	// BC1
+
+	static uint16 To565(const float* c) {
+		const int r = std::clamp((int)std::lround(c[0] * 31.0f / 255.0f), 0, 31);
+		const int g = std::clamp((int)std::lround(c[1] * 63.0f / 255.0f), 0, 63);
+		const int b = std::clamp((int)std::lround(c[2] * 31.0f / 255.0f), 0, 31);
+		return (uint16)((r << 11) | (g << 5) | b);
+	}
+
+	static void From565(uint16 v, int* c) {
+		const int r = (v >> 11) & 31;
+		const int g = (v >> 5) & 63;
+		const int b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	// the four color mode palette, also what BC3 always decodes its color half as
+	static void PaletteBC1(uint16 c0, uint16 c1, int (*palette)[4]) {
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (int ch = 0; ch < 3; ++ch) {
+			palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+			palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+		}
+	}
+
+	static float SelectBC1(const Block& b, uint16 c0, uint16 c1, uchar* indices) {
+		int ip[4][4];
+		PaletteBC1(c0, c1, ip);
+		Palette palette;
+		for (int k = 0; k < 4; ++k) {
+			for (int ch = 0; ch < 3; ++ch) palette[k][ch] = (float)ip[k][ch];
+		}
+		return SelectIndices(b, 3, palette, 4, indices);
+	}
+
+	static void WriteBC1(uint16 c0, uint16 c1, uchar* indices, uchar* out) {
+		// c0 > c1 selects the four color mode, swapping the ends swaps entries 0/1 and 2/3
+		if (c0 < c1) {
+			std::swap(c0, c1);
+			for (int i = 0; i < 16; ++i) indices[i] ^= 1;
+		}
+		else if (c0 == c1) {
+			std::fill(indices, indices + 16, (uchar)0);
+		}
+
+		uint32 bits = 0;
+		for (int i = 0; i < 16; ++i) bits |= (uint32)indices[i] << (i * 2);
+		std::memcpy(out, &c0, 2);
+		std::memcpy(out + 2, &c1, 2);
+		std::memcpy(out + 4, &bits, 4);
+	}
+
+	void EncodeBC1(const uchar* block, uchar* out, BCQuality quality) {
+		const Block b = LoadBlock(block);
+
+		float lo[4];
+		float hi[4];
+		FitLine(b, 3, quality, lo, hi);
+
+		uint16 c0 = To565(hi);
+		uint16 c1 = To565(lo);
+		uchar indices[16];
+		float error = SelectBC1(b, c0, c1, indices);
+
+		if (quality == BCQuality::High) {
+			static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			for (int it = 0; it < 2 && error > 0.0f; ++it) {
+				float e0[4];
+				float e1[4];
+				if (!RefineEndpoints(b, 3, indices, weights, e0, e1)) break;
+
+				const uint16 n0 = To565(e0);
+				const uint16 n1 = To565(e1);
+				uchar candidate[16];
+				const float e = SelectBC1(b, n0, n1, candidate);
+				if (e >= error) break;
+
+				c0 = n0;
+				c1 = n1;
+				error = e;
+				std::memcpy(indices, candidate, 16);
+			}
+		}
+
+		WriteBC1(c0, c1, indices, out);
+	}
+
+	//------------------------------------------------------------------------------
+	// BC4, BC3 alpha and BC5
+
+	static void PaletteBC4(int r0, int r1, int* palette) {
+		palette[0] = r0;
+		palette[1] = r1;
+		if (r0 > r1) {
+			for (int k = 2; k < 8; ++k) palette[k] = ((8 - k) * r0 + (k - 1) * r1 + 3) / 7;
+		}
+		else {
+			for (int k = 2; k < 6; ++k) palette[k] = ((6 - k) * r0 + (k - 1) * r1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	static float SelectBC4(const Block& b, int r0, int r1, uchar* indices) {
+		int ip[8];
+		PaletteBC4(r0, r1, ip);
+		Palette palette;
+		for (int k = 0; k < 8; ++k) palette[k][0] = (float)ip[k];
+		return SelectIndices(b, 1, palette, 8, indices);
+	}
+
+	void EncodeBC4(const uchar* block, uchar* out, BCQuality quality, int channel) {
+		Block b;
+		int mn = 255;
+		int mx = 0;
+		// the 6 value mode has 0 and 255 for free, its ends only need to span the rest
+		int mn6 = 255;
+		int mx6 = 0;
+		for (int i = 0; i < 16; ++i) {
+			const int v = block[i * 4 + channel];
+			b.c[0][i] = (float)v;
+			mn = std::min(mn, v);
+			mx = std::max(mx, v);
+			if (v != 0 && v != 255) {
+				mn6 = std::min(mn6, v);
+				mx6 = std::max(mx6, v);
+			}
+		}
+
+		int r0 = mx;
+		int r1 = mn;
+		uchar indices[16] = {};
+		float error = mx == mn ? 0.0f : SelectBC4(b, r0, r1, indices);
+
+		auto consider = [&](int c0, int c1) {
+			uchar candidate[16];
+			const float e = SelectBC4(b, c0, c1, candidate);
+			if (e < error) {
+				r0 = c0;
+				r1 = c1;
+				error = e;
+				std::memcpy(indices, candidate, 16);
+			}
+		};
+
+		if (error > 0.0f && quality != BCQuality::Fast) {
+			if (mn6 <= mx6) consider(mn6, mx6);
+			else consider(0, 255);
+		}
+
+		if (error > 0.0f && quality == BCQuality::High) {
+			// small search around whichever mode won, keeping the order that selects the mode
+			const int b0 = r0;
+			const int b1 = r1;
+			for (int d0 = -2; d0 <= 2; ++d0) {
+				for (int d1 = -2; d1 <= 2; ++d1) {
+					const int c0 = std::clamp(b0 + d0, 0, 255);
+					const int c1 = std::clamp(b1 + d1, 0, 255);
+					if ((c0 > c1) == (b0 > b1)) consider(c0, c1);
+				}
+			}
+		}
+
+		uint64 bits = 0;
+		for (int i = 0; i < 16; ++i) bits |= (uint64)indices[i] << (i * 3);
+		out[0] = (uchar)r0;
+		out[1] = (uchar)r1;
+		for (int i = 0; i < 6; ++i) out[2 + i] = (uchar)(bits >> (i * 8));
+	}
+
+	void EncodeBC3(const uchar* block, uchar* out, BCQuality quality) {
+		EncodeBC4(block, out, quality, 3);
+		EncodeBC1(block, out + 8, quality);
+	}
+
+	void EncodeBC5(const uchar* block, uchar* out, BCQuality quality) {
+		EncodeBC4(block, out, quality, 0);
+		EncodeBC4(block, out + 8, quality, 1);
+	}
+
+	//------------------------------------------------------------------------------
+	// BC7 mode 6
+
+	static const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Mode6Endpoints {
+		int c[2][4]; // 7 bit
+		int p[2];
+	};
+
+	static int Expand7(int c, int p) {
+		return (c << 1) | p;
+	}
+
+	static void PaletteBC7(const Mode6Endpoints& e, int (*palette)[4]) {
+		for (int k = 0; k < 16; ++k) {
+			for (int ch = 0; ch < 4; ++ch) {
+				const int a = Expand7(e.c[0][ch], e.p[0]);
+				const int b = Expand7(e.c[1][ch], e.p[1]);
+				palette[k][ch] = ((64 - bc7Weights[k]) * a + bc7Weights[k] * b + 32) >> 6;
+			}
+		}
+	}
+
+	static float SelectBC7(const Block& b, const Mode6Endpoints& e, uchar* indices) {
+		int ip[16][4];
+		PaletteBC7(e, ip);
+		Palette palette;
+		for (int k = 0; k < 16; ++k) {
+			for (int ch = 0; ch < 4; ++ch) palette[k][ch] = (float)ip[k][ch];
+		}
+		return SelectIndices(b, 4, palette, 16, indices);
+	}
+
+	// 7 bits per channel plus a p-bit shared by the endpoint's channels
+	static void Quantize7(const float* value, int p, int* c) {
+		for (int ch = 0; ch < 4; ++ch) {
+			c[ch] = std::clamp((int)std::lround((value[ch] - p) / 2.0f), 0, 127);
+		}
+	}
+
+	static float QuantizationError(const float* value, int p) {
+		int c[4];
+		Quantize7(value, p, c);
+		float e = 0.0f;
+		for (int ch = 0; ch < 4; ++ch) {
+			const float d = value[ch] - Expand7(c[ch], p);
+			e += d * d;
+		}
+		return e;
+	}
+
+	static float EncodeMode6(const Block& b, const float* lo, const float* hi, bool allPBits, Mode6Endpoints& best, uchar* indices) {
+		float bestError = FLT_MAX;
+		for (int bit0 = 0; bit0 < 2; ++bit0) {
+			for (int bit1 = 0; bit1 < 2; ++bit1) {
+				int p0 = bit0;
+				int p1 = bit1;
+				if (!allPBits) {
+					// the p-bit each end quantizes best with on its own
+					p0 = QuantizationError(lo, 1) < QuantizationError(lo, 0) ? 1 : 0;
+					p1 = QuantizationError(hi, 1) < QuantizationError(hi, 0) ? 1 : 0;
+				}
+
+				Mode6Endpoints e;
+				e.p[0] = p0;
+				e.p[1] = p1;
+				Quantize7(lo, p0, e.c[0]);
+				Quantize7(hi, p1, e.c[1]);
+
+				uchar candidate[16];
+				const float error = SelectBC7(b, e, candidate);
+				if (error < bestError) {
+					bestError = error;
+					best = e;
+					std::memcpy(indices, candidate, 16);
+				}
+
+				if (!allPBits) return bestError;
+			}
+		}
+		return bestError;
+	}
+
+	struct BitWriter {
+		uchar* out;
+		int pos = 0;
+
+		void Put(uint32 value, int bits) {
+			for (int i = 0; i < bits; ++i, ++pos) {
+				if ((value >> i) & 1) out[pos >> 3] |= (uchar)(1 << (pos & 7));
+			}
+		}
+	};
+
+	struct BitReader {
+		const uchar* in;
+		int pos = 0;
+
+		uint32 Get(int bits) {
+			uint32 value = 0;
+			for (int i = 0; i < bits; ++i, ++pos) {
+				value |= (uint32)((in[pos >> 3] >> (pos & 7)) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	void EncodeBC7(const uchar* block, uchar* out, BCQuality quality) {
+		const Block b = LoadBlock(block);
+
+		float lo[4];
+		float hi[4];
+		FitLine(b, 4, quality, lo, hi);
+
+		Mode6Endpoints e;
+		uchar indices[16];
+		const bool high = quality == BCQuality::High;
+		float error = EncodeMode6(b, lo, hi, high, e, indices);
+
+		if (high) {
+			float weights[16];
+			for (int k = 0; k < 16; ++k) weights[k] = bc7Weights[k] / 64.0f;
+			for (int it = 0; it < 2 && error > 0.0f; ++it) {
+				float e0[4];
+				float e1[4];
+				if (!RefineEndpoints(b, 4, indices, weights, e0, e1)) break;
+
+				Mode6Endpoints candidate;
+				uchar candidateIndices[16];
+				const float ce = EncodeMode6(b, e0, e1, true, candidate, candidateIndices);
+				if (ce >= error) break;
+
+				e = candidate;
+				error = ce;
+				std::memcpy(indices, candidateIndices, 16);
+			}
+		}
+
+		// the first index is stored without its top bit, swapping the ends mirrors every index
+		if (indices[0] & 8) {
+			std::swap(e.c[0], e.c[1]);
+			std::swap(e.p[0], e.p[1]);
+			for (int i = 0; i < 16; ++i) indices[i] = (uchar)(15 - indices[i]);
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter w{ out };
+		w.Put(1 << 6, 7);
+		for (int ch = 0; ch < 4; ++ch) {
+			w.Put(e.c[0][ch], 7);
+			w.Put(e.c[1][ch], 7);
+		}
+		w.Put(e.p[0], 1);
+		w.Put(e.p[1], 1);
+		w.Put(indices[0], 3);
+		for (int i = 1; i < 16; ++i) w.Put(indices[i], 4);
+	}
+
+	//------------------------------------------------------------------------------
+	// decoding, RGBA8 4x4 block out
+
+	static void DecodeBC1(const uchar* in, uchar* rgba, bool fourColor) {
+		uint16 c0, c1;
+		uint32 bits;
+		std::memcpy(&c0, in, 2);
+		std::memcpy(&c1, in + 2, 2);
+		std::memcpy(&bits, in + 4, 4);
+
+		int palette[4][4];
+		PaletteBC1(c0, c1, palette);
+		for (int k = 0; k < 4; ++k) palette[k][3] = 255;
+		if (!fourColor && c0 <= c1) {
+			for (int ch = 0; ch < 3; ++ch) palette[2][ch] = (palette[0][ch] + palette[1][ch]) / 2;
+			palette[3][0] = palette[3][1] = palette[3][2] = palette[3][3] = 0;
+		}
+
+		for (int i = 0; i < 16; ++i) {
+			const int k = (bits >> (i * 2)) & 3;
+			for (int ch = 0; ch < 4; ++ch) rgba[i * 4 + ch] = (uchar)palette[k][ch];
+		}
+	}
+
+	static void DecodeBC4(const uchar* in, uchar* rgba, int channel) {
+		int palette[8];
+		PaletteBC4(in[0], in[1], palette);
+		uint64 bits = 0;
+		for (int i = 0; i < 6; ++i) bits |= (uint64)in[2 + i] << (i * 8);
+		for (int i = 0; i < 16; ++i) rgba[i * 4 + channel] = (uchar)palette[(bits >> (i * 3)) & 7];
+	}
+
+	static void DecodeBC7(const uchar* in, uchar* rgba) {
+		// only mode 6 is decoded, the one this encoder writes
+		if ((in[0] & 0x7F) != 0x40) {
+			std::memset(rgba, 0, 64);
+			return;
+		}
+
+		BitReader r{ in };
+		r.Get(7);
+		Mode6Endpoints e;
+		for (int ch = 0; ch < 4; ++ch) {
+			e.c[0][ch] = (int)r.Get(7);
+			e.c[1][ch] = (int)r.Get(7);
+		}
+		e.p[0] = (int)r.Get(1);
+		e.p[1] = (int)r.Get(1);
+
+		int palette[16][4];
+		PaletteBC7(e, palette);
+		for (int i = 0; i < 16; ++i) {
+			const int k = (int)r.Get(i == 0 ? 3 : 4);
+			for (int ch = 0; ch < 4; ++ch) rgba[i * 4 + ch] = (uchar)palette[k][ch];
+		}
+	}
+
+	static void DecodeBlock(PixelFormat format, const uchar* in, uchar* rgba) {
+		switch (format) {
+		case PixelFormat::BC1:
+			DecodeBC1(in, rgba, false);
+			break;
+		case PixelFormat::BC3:
+			DecodeBC1(in + 8, rgba, true);
+			DecodeBC4(in, rgba, 3);
+			break;
+		case PixelFormat::BC4:
+			// sampled as (r, 0, 0, 1)
+			std::memset(rgba, 0, 64);
+			for (int i = 0; i < 16; ++i) rgba[i * 4 + 3] = 255;
+			DecodeBC4(in, rgba, 0);
+			break;
+		case PixelFormat::BC5:
+			std::memset(rgba, 0, 64);
+			for (int i = 0; i < 16; ++i) rgba[i * 4 + 3] = 255;
+			DecodeBC4(in, rgba, 0);
+			DecodeBC4(in + 8, rgba, 1);
+			break;
+		case PixelFormat::BC7:
+			DecodeBC7(in, rgba);
+			break;
+		case PixelFormat::RGBA8:
+			break;
+		}
+	}
+
+	//------------------------------------------------------------------------------
+
+	static std::size_t BlockBytes(PixelFormat format) {
+		return format == PixelFormat::BC1 || format == PixelFormat::BC4 ? 8 : 16;
+	}
+
+	PixelFormat ChooseFormat(const ImageData& rgba, BCQuality quality) {
+		const uchar* pixels = rgba.LevelData(0);
+		const std::size_t count = (std::size_t)rgba.levels[0].width * rgba.levels[0].height;
+		bool opaque = true;
+		bool gray = true;
+		bool noBlue = true;
+		for (std::size_t i = 0; i < count; ++i) {
+			const uchar* p = pixels + i * 4;
+			opaque = opaque && p[3] == 255;
+			gray = gray && p[0] == p[1] && p[1] == p[2];
+			noBlue = noBlue && p[2] == 0;
+		}
+
+		// one or two channel data decodes exactly as it was stored, at half the size of BC7 or BC3 for BC4
+		if (opaque && gray) return PixelFormat::BC4;
+		if (opaque && noBlue) return PixelFormat::BC5;
+		if (quality == BCQuality::High) return PixelFormat::BC7;
+		return opaque ? PixelFormat::BC1 : PixelFormat::BC3;
+	}
+
+	ImageData Compress(const ImageData& rgba, PixelFormat format, BCQuality quality, Utils::ThreadPool* pool) {
+		if (!rgba.IsValid() || rgba.format != PixelFormat::RGBA8 || format == PixelFormat::RGBA8) {
+			std::cerr << "[ERROR] block compression needs RGBA8 input and a BC target format\n";
+			return {};
+		}
+
+		void (*encode)(const uchar*, uchar*, BCQuality) = nullptr;
+		switch (format) {
+		case PixelFormat::BC1: encode = EncodeBC1; break;
+		case PixelFormat::BC3: encode = EncodeBC3; break;
+		case PixelFormat::BC4: encode = [](const uchar* b, uchar* o, BCQuality q) { EncodeBC4(b, o, q); }; break;
+		case PixelFormat::BC5: encode = EncodeBC5; break;
+		case PixelFormat::BC7: encode = EncodeBC7; break;
+		case PixelFormat::RGBA8: break;
+		}
+
+		const ImageData source = rgba.levels.size() > 1 ? rgba : Mips::Generate(rgba, {}, pool);
+
+		ImageData out;
+		out.width = source.width;
+		out.height = source.height;
+		out.format = format;
+
+		// rows of blocks over the whole chain are the unit of work
+		struct Row {
+			std::size_t level;
+			int y;
+		};
+		std::vector<Row> rows;
+		for (std::size_t i = 0; i < source.levels.size(); ++i) {
+			const auto& level = source.levels[i];
+			const auto size = TextureContainer::LevelSize(format, level.width, level.height);
+			out.levels.push_back({ level.width, level.height, out.pixels.size(), size });
+			out.pixels.resize(out.pixels.size() + size);
+			for (int y = 0; y < (level.height + 3) / 4; ++y) rows.push_back({ i, y });
+		}
+
+		const std::size_t blockBytes = BlockBytes(format);
+		auto encodeRow = [&](std::size_t r) {
+			const auto& level = source.levels[rows[r].level];
+			const uchar* src = source.LevelData(rows[r].level);
+			uchar* dst = out.pixels.data() + out.levels[rows[r].level].offset;
+			const int blocksWide = (level.width + 3) / 4;
+
+			uchar block[64];
+			for (int bx = 0; bx < blocksWide; ++bx) {
+				// blocks hanging over the edge repeat the last row and column
+				for (int y = 0; y < 4; ++y) {
+					const int sy = std::min(rows[r].y * 4 + y, level.height - 1);
+					for (int x = 0; x < 4; ++x) {
+						const int sx = std::min(bx * 4 + x, level.width - 1);
+						std::memcpy(block + (y * 4 + x) * 4, src + ((std::size_t)sy * level.width + sx) * 4, 4);
+					}
+				}
+				encode(block, dst + ((std::size_t)rows[r].y * blocksWide + bx) * blockBytes, quality);
+			}
+		};
+
+		if (pool != nullptr) {
+			pool->ParallelFor(rows.size(), encodeRow);
+		}
+		else {
+			for (std::size_t r = 0; r < rows.size(); ++r) encodeRow(r);
+		}
+		return out;
+	}
+
+	ImageData Decompress(const ImageData& compressed) {
+		if (!compressed.IsCompressed()) return compressed;
+
+		ImageData out;
+		out.width = compressed.width;
+		out.height = compressed.height;
+		out.format = PixelFormat::RGBA8;
+
+		const std::size_t blockBytes = BlockBytes(compressed.format);
+		for (std::size_t i = 0; i < compressed.levels.size(); ++i) {
+			const auto& level = compressed.levels[i];
+			const std::size_t offset = out.pixels.size();
+			const std::size_t size = (std::size_t)level.width * level.height * 4;
+			out.levels.push_back({ level.width, level.height, offset, size });
+			out.pixels.resize(offset + size);
+
+			const uchar* src = compressed.LevelData(i);
+			uchar* dst = out.pixels.data() + offset;
+			const int blocksWide = (level.width + 3) / 4;
+			const int blocksHigh = (level.height + 3) / 4;
+			uchar block[64];
+			for (int by = 0; by < blocksHigh; ++by) {
+				for (int bx = 0; bx < blocksWide; ++bx) {
+					DecodeBlock(compressed.format, src + ((std::size_t)by * blocksWide + bx) * blockBytes, block);
+					for (int y = 0; y < 4 && by * 4 + y < level.height; ++y) {
+						for (int x = 0; x < 4 && bx * 4 + x < level.width; ++x) {
+							std::memcpy(dst + ((std::size_t)(by * 4 + y) * level.width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+						}
+					}
+				}
+			}
+		}
+		return out;
+	}
+
+	float64 PSNR(const ImageData& reference, const ImageData& compressed) {
+		if (!reference.IsValid() || !compressed.IsValid()
+			|| reference.width != compressed.width || reference.height != compressed.height) {
+			return 0.0;
+		}
+
+		int channels = 4;
+		switch (compressed.format) {
+		case PixelFormat::BC1: channels = 3; break;
+		case PixelFormat::BC4: channels = 1; break;
+		case PixelFormat::BC5: channels = 2; break;
+		default: break;
+		}
+
+		const ImageData decoded = Decompress(compressed);
+		const uchar* a = reference.LevelData(0);
+		const uchar* b = decoded.LevelData(0);
+		const std::size_t count = (std::size_t)reference.width * reference.height;
+
+		float64 sum = 0.0;
+		for (std::size_t i = 0; i < count; ++i) {
+			for (int ch = 0; ch < channels; ++ch) {
+				const float64 d = (float64)a[i * 4 + ch] - b[i * 4 + ch];
+				sum += d * d;
+			}
+		}
+
+		const float64 mse = sum / (float64)(count * channels);
+		if (mse == 0.0) return std::numeric_limits<float64>::infinity();
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+} // Resource::BCn
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "render/texture.h"
+#include "util/threadPool.h"
+
+namespace Resource {
+
+	// CPU block compression for the asset pipeline. Blocks are independent, so rows of blocks
+	// are spread over the pool; the per-block palette search is vectorised with SSE when available.
+	namespace BCn {
+
+		// opaque gray images go to BC4 and opaque ones without blue to BC5, whatever the quality;
+		// otherwise opaque images go to BC1 and images with alpha to BC3, BCQuality::High uses BC7 for both
+		PixelFormat ChooseFormat(const ImageData& rgba, BCQuality quality);
+
+		// compresses every level of an RGBA8 image, an image with a single level gets a mip chain first
+		ImageData Compress(const ImageData& rgba, PixelFormat format, BCQuality quality, Utils::ThreadPool* pool = nullptr);
+		// back to RGBA8, for measuring quality
+		ImageData Decompress(const ImageData& compressed);
+
+		// peak signal to noise ratio over the channels the format stores, level 0 only
+		float64 PSNR(const ImageData& reference, const ImageData& compressed);
+
+		// RGBA8 4x4 block (64 bytes, row major) in, one encoded block out
+		void EncodeBC1(const uchar* block, uchar* out, BCQuality quality);
+		void EncodeBC3(const uchar* block, uchar* out, BCQuality quality);
+		void EncodeBC4(const uchar* block, uchar* out, BCQuality quality, int channel = 0);
+		void EncodeBC5(const uchar* block, uchar* out, BCQuality quality);
+		// mode 6 only: one subset, RGBA endpoints with p-bits and 4 bit indices
+		void EncodeBC7(const uchar* block, uchar* out, BCQuality quality);
+
+	} // BCn
+
+} // Resource
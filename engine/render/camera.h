@@ -20,6 +20,9 @@ namespace Render {
         float speed;
         float sens;
 
+        float nearPlane;
+        float farPlane;
+
     public:
         Camera(float fovy, float aspect, float near, float far);
         ~Camera() = default;
@@ -38,6 +41,8 @@ namespace Render {
 
         inline Math::mat4 GetPerspective() const { return perspective; }
         inline Math::mat4 GetView() const { return view; }
+        inline float GetNear() const { return nearPlane; }
+        inline float GetFar() const { return farPlane; }
 
     private:
         void UpdateView();
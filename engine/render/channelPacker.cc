@@ -0,0 +1,94 @@
+#include "config.h"
+#include "channelPacker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Resource {
+
+	namespace Channels {
+
+		ImageData Resize(const ImageData& rgba, int width, int height) {
+			ImageData out;
+			out.width = width;
+			out.height = height;
+			out.pixels.resize((std::size_t)width * height * 4);
+			out.levels.push_back({ width, height, 0, out.pixels.size() });
+
+			const auto& level = rgba.levels[0];
+			const uchar* src = rgba.LevelData(0);
+			const float sx = (float)level.width / width;
+			const float sy = (float)level.height / height;
+			for (int y = 0; y < height; ++y) {
+				const float fy = std::clamp((y + 0.5f) * sy - 0.5f, 0.0f, (float)(level.height - 1));
+				const int y0 = (int)fy;
+				const int y1 = std::min(y0 + 1, level.height - 1);
+				const float ty = fy - y0;
+				for (int x = 0; x < width; ++x) {
+					const float fx = std::clamp((x + 0.5f) * sx - 0.5f, 0.0f, (float)(level.width - 1));
+					const int x0 = (int)fx;
+					const int x1 = std::min(x0 + 1, level.width - 1);
+					const float tx = fx - x0;
+					for (int c = 0; c < 4; ++c) {
+						const float top = src[(y0 * level.width + x0) * 4 + c] * (1.0f - tx) + src[(y0 * level.width + x1) * 4 + c] * tx;
+						const float bottom = src[(y1 * level.width + x0) * 4 + c] * (1.0f - tx) + src[(y1 * level.width + x1) * 4 + c] * tx;
+						out.pixels[((std::size_t)y * width + x) * 4 + c] = (uchar)std::lround(top * (1.0f - ty) + bottom * ty);
+					}
+				}
+			}
+			return out;
+		}
+
+		ImageData PackSurface(const ImageData* normal, const ImageData* metallicRoughness) {
+			int width = 1;
+			int height = 1;
+			for (const auto* input : { normal, metallicRoughness }) {
+				if (input == nullptr) continue;
+				width = std::max(width, input->levels[0].width);
+				height = std::max(height, input->levels[0].height);
+			}
+
+			ImageData scaled[2];
+			const auto fit = [&](const ImageData* input, ImageData& storage) {
+				if (input == nullptr || (input->levels[0].width == width && input->levels[0].height == height)) {
+					return input;
+				}
+				storage = Resize(*input, width, height);
+				return (const ImageData*)&storage;
+			};
+			const ImageData* n = fit(normal, scaled[0]);
+			const ImageData* mr = fit(metallicRoughness, scaled[1]);
+
+			ImageData out;
+			out.width = width;
+			out.height = height;
+			out.pixels.resize((std::size_t)width * height * 4);
+			out.levels.push_back({ width, height, 0, out.pixels.size() });
+
+			const std::size_t texels = (std::size_t)width * height;
+			for (std::size_t i = 0; i < texels; ++i) {
+				uchar* dst = &out.pixels[i * 4];
+				dst[SurfaceNormalX] = n ? n->pixels[i * 4 + 0] : 128;
+				dst[SurfaceNormalY] = n ? n->pixels[i * 4 + 1] : 128;
+				// glTF keeps roughness in green and metalness in blue
+				dst[SurfaceRoughness] = mr ? mr->pixels[i * 4 + 1] : 255;
+				dst[SurfaceMetalness] = mr ? mr->pixels[i * 4 + 2] : 255;
+			}
+			return out;
+		}
+
+		uint64 SurfaceHash(uint64 normalHash, uint64 metallicRoughnessHash) {
+			// FNV-1a over both hashes, seeded with the layout version
+			uint64 hash = 14695981039346656037ull ^ 0x5355524631ull;
+			for (const uint64 v : { normalHash, metallicRoughnessHash }) {
+				for (int b = 0; b < 8; ++b) {
+					hash ^= (v >> (b * 8)) & 0xFF;
+					hash *= 1099511628211ull;
+				}
+			}
+			return hash;
+		}
+
+	} // Channels
+
+} // Resource
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "render/texture.h"
+
+namespace Resource {
+
+	// Import time repacking of material textures. The normal map and the glTF metallicRoughness map
+	// of a material become one RGBA8 surface texture laid out for BC3: the normal's X goes to the
+	// 8 bit alpha block and Y to the 6 bit green channel, roughness and metalness take red and blue.
+	// The shaders rebuild the normal's Z. Only looks at pixels, safe to call from any thread.
+	namespace Channels {
+
+		// R roughness, G normal Y, B metalness, A normal X
+		enum SurfaceChannel {
+			SurfaceRoughness = 0,
+			SurfaceNormalY = 1,
+			SurfaceMetalness = 2,
+			SurfaceNormalX = 3,
+		};
+
+		// either input may be missing: a flat normal, and roughness and metalness of 1 as glTF
+		// assumes without a texture; level 0 of inputs of different sizes is scaled to the larger one
+		ImageData PackSurface(const ImageData* normal, const ImageData* metallicRoughness);
+
+		// content hash of a surface built from inputs with these hashes, changes with the layout
+		uint64 SurfaceHash(uint64 normalHash, uint64 metallicRoughnessHash);
+
+		// bilinear, RGBA8 level 0 only
+		ImageData Resize(const ImageData& rgba, int width, int height);
+
+	} // Channels
+
+} // Resource
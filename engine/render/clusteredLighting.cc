@@ -0,0 +1,163 @@
+#include "config.h"
+#include "clusteredLighting.h"
+
+#include <algorithm>
+#include <iomanip>
+
+#include "glState.h"
+#include "math/math.h"
+
+namespace Render {
+
+	ClusteredLighting::~ClusteredLighting() {
+		if (countBuffer != 0) {
+			glDeleteBuffers(1, &countBuffer);
+		}
+		if (indexBuffer != 0) {
+			glDeleteBuffers(1, &indexBuffer);
+		}
+		if (queries[0] != 0) {
+			glDeleteQueries(queryCount, queries);
+		}
+	}
+
+	void ClusteredLighting::Init(int w, int h) {
+		width = w;
+		height = h;
+		tilesX = (w + settings.tileSize - 1) / settings.tileSize;
+		tilesY = (h + settings.tileSize - 1) / settings.tileSize;
+
+		if (countBuffer == 0) {
+			glCreateBuffers(1, &countBuffer);
+			glCreateBuffers(1, &indexBuffer);
+			glCreateQueries(GL_TIME_ELAPSED, queryCount, queries);
+		}
+		const auto clusters = (GLsizeiptr)GetClusterCount();
+		glNamedBufferData(countBuffer, clusters * sizeof(uint32), nullptr, GL_DYNAMIC_COPY);
+		glNamedBufferData(indexBuffer, clusters * settings.maxLightsPerCluster * sizeof(uint32), nullptr, GL_DYNAMIC_COPY);
+	}
+
+	void ClusteredLighting::SetShaders(const std::weak_ptr<Resource::Shader>& cull, const std::weak_ptr<Resource::Shader>& shade) {
+		cullShader = cull;
+		shadeShader = shade;
+	}
+
+	void ClusteredLighting::ReadQueries() {
+		for (int i = 0; i < queryCount; ++i) {
+			if (!queryIssued[i]) continue;
+
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint64 ns = 0;
+				glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+				stats.gpuMs += ns / 1e6;
+				stats.timedFrames++;
+				queryIssued[i] = false;
+			}
+		}
+	}
+
+	static const Resource::UniformHandle<GLint> screenWidthUniform("screenWidth");
+	static const Resource::UniformHandle<GLint> screenHeightUniform("screenHeight");
+	static const Resource::UniformHandle<GLint> tileSizeUniform("tileSize");
+	static const Resource::UniformHandle<GLint> tilesXUniform("tilesX");
+	static const Resource::UniformHandle<GLint> tilesYUniform("tilesY");
+	static const Resource::UniformHandle<GLint> depthSlicesUniform("depthSlices");
+	static const Resource::UniformHandle<float32> zNearUniform("zNear");
+	static const Resource::UniformHandle<float32> zFarUniform("zFar");
+	static const Resource::UniformHandle<GLint> maxLightsUniform("maxLightsPerCluster");
+	static const Resource::UniformHandle<GLint> lightCountUniform("lightCount");
+	static const Resource::UniformHandle<GLint> gPosUniform("gPos");
+	static const Resource::UniformHandle<GLint> gColUniform("gCol");
+	static const Resource::UniformHandle<GLint> gNormUniform("gNorm");
+	static const Resource::UniformHandle<Math::vec3> dlightDirUniform("dlight.dir");
+	static const Resource::UniformHandle<Math::vec3> dlightAmbientUniform("dlight.ambient");
+	static const Resource::UniformHandle<Math::vec3> dlightDiffuseUniform("dlight.diffuse");
+	static const Resource::UniformHandle<Math::vec3> dlightSpecularUniform("dlight.specular");
+
+	void ClusteredLighting::UploadGrid(Resource::Shader& s, const Camera& cam) const {
+		s.Upload(screenWidthUniform, width);
+		s.Upload(screenHeightUniform, height);
+		s.Upload(tileSizeUniform, settings.tileSize);
+		s.Upload(tilesXUniform, tilesX);
+		s.Upload(tilesYUniform, tilesY);
+		s.Upload(depthSlicesUniform, settings.depthSlices);
+		s.Upload(zNearUniform, cam.GetNear());
+		s.Upload(zFarUniform, cam.GetFar());
+		s.Upload(maxLightsUniform, settings.maxLightsPerCluster);
+	}
+
+	void ClusteredLighting::Dispatch(const GBuffer& gbuf, const Camera& cam, const LightManager& lights) {
+		const auto cull = cullShader.lock();
+		const auto shade = shadeShader.lock();
+		if (!cull || !shade || countBuffer == 0) {
+			return;
+		}
+
+		ReadQueries();
+
+		// a query still waiting for its result is not reused, that frame is just not timed
+		const int query = (int)(stats.frames % queryCount);
+		const bool timed = !queryIssued[query];
+		if (timed) {
+			glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+		}
+
+		const auto lightCount = (GLint)lights.GetPointLights().size();
+		lights.BindLights();
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, countBinding, countBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indexBinding, indexBuffer);
+
+		cull->Use();
+		UploadGrid(*cull, cam);
+		cull->Upload(lightCountUniform, lightCount);
+		glDispatchCompute((GetClusterCount() + cullGroupSize - 1) / cullGroupSize, 1, 1);
+
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		shade->Use();
+		for (GLuint i = 0; i < GBuffer::GBUF_NUM_TEXTURES; ++i) {
+			GLState::Get().BindTexture(i, gbuf.GetTexture((GBuffer::GBUF_TEXTURE_TYPE)i));
+		}
+		shade->Upload(gPosUniform, (GLint)GBuffer::GBUF_POS);
+		shade->Upload(gColUniform, (GLint)GBuffer::GBUF_COL);
+		shade->Upload(gNormUniform, (GLint)GBuffer::GBUF_NORM);
+		glBindImageTexture(0, gbuf.GetFinal(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+		const auto& dl = lights.GetGlobalLight();
+		shade->Upload(dlightDirUniform, dl.GetDirection());
+		shade->Upload(dlightAmbientUniform, dl.GetAmbient());
+		shade->Upload(dlightDiffuseUniform, dl.GetDiffuse());
+		shade->Upload(dlightSpecularUniform, dl.GetSpecular());
+		UploadGrid(*shade, cam);
+		glDispatchCompute((width + shadeGroupSize - 1) / shadeGroupSize, (height + shadeGroupSize - 1) / shadeGroupSize, 1);
+
+		// the light sources are drawn into the image and it is blitted next
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		if (timed) {
+			glEndQuery(GL_TIME_ELAPSED);
+			queryIssued[query] = true;
+		}
+
+		stats.frames++;
+		stats.lights = lightCount;
+		stats.peakLights = std::max(stats.peakLights, stats.lights);
+	}
+
+	void ClusteredLighting::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		out << std::fixed << std::setprecision(3)
+			<< "  " << tilesX << 'x' << tilesY << 'x' << settings.depthSlices << " clusters, "
+			<< stats.lights << " point lights (peak " << stats.peakLights << ") over " << stats.frames << " frames\n"
+			<< "  cull + shade " << (stats.timedFrames > 0 ? stats.gpuMs / stats.timedFrames : 0.0)
+			<< " ms GPU per frame, 2 dispatches\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Render
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "render/camera.h"
+#include "render/gbuf.h"
+#include "render/light.h"
+#include "render/shader.h"
+
+namespace Render {
+
+	// Clustered deferred shading. The view frustum is cut into screen tiles times exponentially spaced
+	// depth slices; one compute pass bins the point lights into every cluster their sphere touches,
+	// a second one lights each G-buffer pixel with the global light and the lights of its cluster and
+	// writes the result straight into the final image. Two dispatches per frame whatever the light
+	// count. Render thread only, needs the GL context from Init to destruction.
+	class ClusteredLighting {
+	public:
+		// shader storage bindings, must match clusterCull.glsl and clusterShade.glsl; the lights are
+		// at LightManager::pointLightBinding
+		static constexpr GLuint countBinding = 2;
+		static constexpr GLuint indexBinding = 3;
+		static constexpr int cullGroupSize = 128;
+		static constexpr int shadeGroupSize = 8;
+
+		struct Settings {
+			// screen pixels per tile side
+			int tileSize = 64;
+			int depthSlices = 24;
+			// lights past this many in one cluster are left out of it
+			int maxLightsPerCluster = 256;
+		};
+
+		struct Stats {
+			std::size_t frames = 0;
+			std::size_t lights = 0;
+			std::size_t peakLights = 0;
+			// GPU time of both dispatches, from the timer queries that came back
+			float64 gpuMs = 0.0;
+			std::size_t timedFrames = 0;
+		};
+
+	private:
+		static constexpr int queryCount = 3;
+
+		Settings settings;
+		Stats stats;
+		int width = 0;
+		int height = 0;
+		int tilesX = 0;
+		int tilesY = 0;
+
+		GLuint countBuffer = 0;
+		GLuint indexBuffer = 0;
+
+		GLuint queries[queryCount] = {};
+		bool queryIssued[queryCount] = {};
+
+		std::weak_ptr<Resource::Shader> cullShader;
+		std::weak_ptr<Resource::Shader> shadeShader;
+
+	public:
+		ClusteredLighting() = default;
+		ClusteredLighting(const ClusteredLighting&) = delete;
+		ClusteredLighting(ClusteredLighting&&) = delete;
+		~ClusteredLighting();
+
+		ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+		ClusteredLighting& operator=(ClusteredLighting&&) = delete;
+
+		// before Init, the buffers are sized from it
+		void SetSettings(const Settings& s) { settings = s; }
+		// sizes the cluster grid for a width x height G-buffer
+		void Init(int w, int h);
+		void SetShaders(const std::weak_ptr<Resource::Shader>& cull, const std::weak_ptr<Resource::Shader>& shade);
+
+		// lights the whole G-buffer into its final image, which it overwrites; the point lights must
+		// have been uploaded this frame
+		void Dispatch(const GBuffer& gbuf, const Camera& cam, const LightManager& lights);
+
+		int GetClusterCount() const { return tilesX * tilesY * settings.depthSlices; }
+		const Stats& GetStats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		void ReadQueries();
+		// the cluster grid uniforms both passes share
+		void UploadGrid(Resource::Shader& s, const Camera& cam) const;
+	};
+
+} // Render
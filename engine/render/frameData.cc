@@ -0,0 +1,35 @@
+#include "config.h"
+#include "frameData.h"
+
+namespace Render {
+
+	FrameUniforms::FrameUniforms() : buffer(0), data() {
+	}
+
+	FrameUniforms::~FrameUniforms() {
+		if (buffer != 0) {
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+
+	void FrameUniforms::Update(const Camera& cam, int width, int height) {
+		if (buffer == 0) {
+			glCreateBuffers(1, &buffer);
+			glNamedBufferStorage(buffer, sizeof(GpuFrameData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+
+		const auto& pos = cam.GetCameraPos();
+		data.view = cam.GetView();
+		data.projection = cam.GetPerspective();
+		data.viewProjection = data.projection * data.view;
+		data.inverseView = Math::inverse(data.view);
+		data.inverseProjection = Math::inverse(data.projection);
+		data.inverseViewProjection = Math::inverse(data.viewProjection);
+		data.cameraPos = Math::vec4{ pos.x, pos.y, pos.z, 1.0f };
+		data.screenSize = Math::vec4{ (float32)width, (float32)height, 1.0f / width, 1.0f / height };
+
+		glNamedBufferSubData(buffer, 0, sizeof(GpuFrameData), &data);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+	}
+
+} // Render
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "math/mat4.h"
+#include "math/vec4.h"
+#include "render/camera.h"
+
+namespace Render {
+
+	// the camera as every shader reads it from the FrameData uniform block, std140; the matrices
+	// are laid out as Shader::Upload sends them
+	struct GpuFrameData {
+		Math::mat4 view;
+		Math::mat4 projection;
+		Math::mat4 viewProjection;
+		Math::mat4 inverseView;
+		Math::mat4 inverseProjection;
+		Math::mat4 inverseViewProjection;
+		Math::vec4 cameraPos;
+		// width, height and their reciprocals
+		Math::vec4 screenSize;
+	};
+	static_assert(sizeof(GpuFrameData) == 6 * 64 + 2 * 16);
+
+	// The per frame uniform buffer behind FrameData. Written once a frame before the first pass and
+	// left bound at its binding, so no program uploads the camera itself. Render thread only, needs
+	// the GL context from the first Update to destruction.
+	class FrameUniforms {
+	public:
+		// uniform buffer binding, must match the FrameData block in the shaders
+		static constexpr GLuint binding = 0;
+
+	private:
+		GLuint buffer;
+		GpuFrameData data;
+
+	public:
+		FrameUniforms();
+		~FrameUniforms();
+
+		FrameUniforms(const FrameUniforms&) = delete;
+		FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+		// fills the block from the camera and the screen size in pixels and binds it
+		void Update(const Camera& cam, int width, int height);
+
+		const GpuFrameData& GetData() const { return data; }
+		GLuint GetBuffer() const { return buffer; }
+	};
+
+} // Render
@@ -26,10 +26,13 @@ namespace Render {
 		void Init(unsigned int w, unsigned int h);
 		void StartFrame() const;
 		void BindForGeometryPass() const;
-		void BindForStencilPass() const;
 		void BindForLightingPass() const;
 		void BindForDebugPass() const;
 		void BindForFinalPass() const;
+
+		GLuint GetTexture(GBUF_TEXTURE_TYPE type) const { return textures[type]; }
+		// the lit image, RGBA8 so compute passes can write it as an image
+		GLuint GetFinal() const { return final; }
 	};
 
 } // Render
\ No newline at end of file
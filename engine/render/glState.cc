@@ -0,0 +1,214 @@
+#include "config.h"
+#include "glState.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace Render {
+
+	GLState::GLState() {
+		Invalidate();
+	}
+
+	GLState& GLState::Get() {
+		static GLState state;
+		return state;
+	}
+
+	bool GLState::Changed(GLuint& shadow, GLuint value) {
+		if (shadow == value) {
+			frame.skipped++;
+			return false;
+		}
+		shadow = value;
+		frame.issued++;
+		return true;
+	}
+
+	template<typename T>
+	bool GLState::Changed(T& shadow, T value, bool known) {
+		if (known && shadow == value) {
+			frame.skipped++;
+			return false;
+		}
+		shadow = value;
+		frame.issued++;
+		return true;
+	}
+
+	void GLState::SetCapability(GLenum cap, bool& shadow, bool value, bool known) {
+		if (Changed(shadow, value, known)) {
+			if (value) {
+				glEnable(cap);
+			} else {
+				glDisable(cap);
+			}
+		}
+	}
+
+	void GLState::UseProgram(GLuint handle) {
+		if (Changed(program, handle)) {
+			glUseProgram(handle);
+		}
+	}
+
+	void GLState::BindVertexArray(GLuint handle) {
+		if (Changed(vertexArray, handle)) {
+			glBindVertexArray(handle);
+		}
+	}
+
+	void GLState::BindTexture(GLuint unit, GLuint handle) {
+		if (unit >= (GLuint)textureUnits) {
+			frame.issued++;
+			glBindTextureUnit(unit, handle);
+			return;
+		}
+		if (Changed(textures[unit], handle)) {
+			glBindTextureUnit(unit, handle);
+		}
+	}
+
+	void GLState::BindSampler(GLuint unit, GLuint handle) {
+		if (unit >= (GLuint)textureUnits) {
+			frame.issued++;
+			glBindSampler(unit, handle);
+			return;
+		}
+		if (Changed(samplers[unit], handle)) {
+			glBindSampler(unit, handle);
+		}
+	}
+
+	void GLState::BindFramebuffer(GLenum target, GLuint handle) {
+		if (target == GL_FRAMEBUFFER) {
+			if (drawFramebuffer == handle && readFramebuffer == handle) {
+				frame.skipped++;
+				return;
+			}
+			drawFramebuffer = handle;
+			readFramebuffer = handle;
+			frame.issued++;
+			glBindFramebuffer(GL_FRAMEBUFFER, handle);
+			return;
+		}
+		if (Changed(target == GL_DRAW_FRAMEBUFFER ? drawFramebuffer : readFramebuffer, handle)) {
+			glBindFramebuffer(target, handle);
+		}
+	}
+
+	void GLState::Apply(const PipelineState& state) {
+		const auto& d = state.GetDesc();
+		if (pipelineKnown && state.GetHash() == pipelineHash && d == pipeline) {
+			frame.skipped += pipelineCalls;
+			return;
+		}
+
+		const bool known = pipelineKnown;
+		auto& p = pipeline;
+
+		SetCapability(GL_DEPTH_TEST, p.depthTest, d.depthTest, known);
+		if (Changed(p.depthWrite, d.depthWrite, known)) {
+			glDepthMask(d.depthWrite ? GL_TRUE : GL_FALSE);
+		}
+		SetCapability(GL_DEPTH_CLAMP, p.depthClamp, d.depthClamp, known);
+		if (Changed(p.depthFunc, d.depthFunc, known)) {
+			glDepthFunc(d.depthFunc);
+		}
+
+		SetCapability(GL_BLEND, p.blend, d.blend, known);
+		if (Changed(p.blendEquation, d.blendEquation, known)) {
+			glBlendEquation(d.blendEquation);
+		}
+		if (!known || p.blendSrc != d.blendSrc || p.blendDst != d.blendDst) {
+			p.blendSrc = d.blendSrc;
+			p.blendDst = d.blendDst;
+			frame.issued++;
+			glBlendFunc(d.blendSrc, d.blendDst);
+		} else {
+			frame.skipped++;
+		}
+
+		SetCapability(GL_CULL_FACE, p.cull, d.cull, known);
+		if (Changed(p.cullFace, d.cullFace, known)) {
+			glCullFace(d.cullFace);
+		}
+
+		SetCapability(GL_STENCIL_TEST, p.stencilTest, d.stencilTest, known);
+		if (!known || p.stencilFunc != d.stencilFunc || p.stencilRef != d.stencilRef || p.stencilMask != d.stencilMask) {
+			p.stencilFunc = d.stencilFunc;
+			p.stencilRef = d.stencilRef;
+			p.stencilMask = d.stencilMask;
+			frame.issued++;
+			glStencilFunc(d.stencilFunc, d.stencilRef, d.stencilMask);
+		} else {
+			frame.skipped++;
+		}
+		if (!known || p.stencilFail != d.stencilFail || p.stencilDepthFail != d.stencilDepthFail || p.stencilPass != d.stencilPass) {
+			p.stencilFail = d.stencilFail;
+			p.stencilDepthFail = d.stencilDepthFail;
+			p.stencilPass = d.stencilPass;
+			frame.issued++;
+			glStencilOp(d.stencilFail, d.stencilDepthFail, d.stencilPass);
+		} else {
+			frame.skipped++;
+		}
+
+		pipelineHash = state.GetHash();
+		pipelineKnown = true;
+	}
+
+	void GLState::Invalidate() {
+		program = unknown;
+		vertexArray = unknown;
+		drawFramebuffer = unknown;
+		readFramebuffer = unknown;
+		std::fill(std::begin(textures), std::end(textures), unknown);
+		std::fill(std::begin(samplers), std::end(samplers), unknown);
+		pipelineKnown = false;
+	}
+
+	// a deleted object is unbound by GL and its name can come back from the next create call
+	void GLState::ForgetProgram(GLuint handle) {
+		if (program == handle) program = unknown;
+	}
+
+	void GLState::ForgetVertexArray(GLuint handle) {
+		if (vertexArray == handle) vertexArray = unknown;
+	}
+
+	void GLState::ForgetTexture(GLuint handle) {
+		for (auto& bound : textures) {
+			if (bound == handle) bound = unknown;
+		}
+	}
+
+	void GLState::ForgetFramebuffer(GLuint handle) {
+		if (drawFramebuffer == handle) drawFramebuffer = unknown;
+		if (readFramebuffer == handle) readFramebuffer = unknown;
+	}
+
+	void GLState::EndFrame() {
+		lastFrame = frame;
+		total.issued += frame.issued;
+		total.skipped += frame.skipped;
+		frames++;
+		frame = {};
+	}
+
+	void GLState::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		const float64 perFrame = frames > 0 ? 1.0 / frames : 0.0;
+		const std::size_t calls = total.issued + total.skipped;
+		out << std::fixed << std::setprecision(1)
+			<< "  " << total.issued * perFrame << " state calls issued, " << total.skipped * perFrame
+			<< " redundant ones skipped per frame over " << frames << " frames ("
+			<< (calls > 0 ? 100.0 * total.skipped / calls : 0.0) << "% skipped)\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Render
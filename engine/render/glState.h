@@ -0,0 +1,138 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <ostream>
+
+namespace Render {
+
+	// fixed function state a pass draws with, everything GLState::Apply sets
+	struct PipelineDesc {
+		bool depthTest = true;
+		bool depthWrite = true;
+		bool depthClamp = false;
+		GLenum depthFunc = GL_LESS;
+
+		bool blend = false;
+		GLenum blendEquation = GL_FUNC_ADD;
+		GLenum blendSrc = GL_ONE;
+		GLenum blendDst = GL_ZERO;
+
+		bool cull = true;
+		GLenum cullFace = GL_BACK;
+
+		bool stencilTest = false;
+		GLenum stencilFunc = GL_ALWAYS;
+		GLint stencilRef = 0;
+		GLuint stencilMask = 0xFF;
+		GLenum stencilFail = GL_KEEP;
+		GLenum stencilDepthFail = GL_KEEP;
+		GLenum stencilPass = GL_KEEP;
+
+		constexpr bool operator==(const PipelineDesc&) const = default;
+	};
+
+	// An immutable PipelineDesc with its hash worked out up front, at compile time when it is a
+	// constexpr or static. Applying the block that is already applied costs one compare.
+	class PipelineState {
+		PipelineDesc desc;
+		uint64 hash;
+
+	public:
+		constexpr explicit PipelineState(const PipelineDesc& d) : desc(d), hash(Hash(d)) {}
+
+		constexpr const PipelineDesc& GetDesc() const { return desc; }
+		constexpr uint64 GetHash() const { return hash; }
+
+	private:
+		static constexpr uint64 Hash(const PipelineDesc& d) {
+			// FNV-1a over the fields, not the bytes, the padding is undefined
+			const uint64 fields[] = {
+				d.depthTest, d.depthWrite, d.depthClamp, d.depthFunc,
+				d.blend, d.blendEquation, d.blendSrc, d.blendDst,
+				d.cull, d.cullFace,
+				d.stencilTest, d.stencilFunc, (uint64)(uint32)d.stencilRef, d.stencilMask,
+				d.stencilFail, d.stencilDepthFail, d.stencilPass
+			};
+			uint64 h = 14695981039346656037ull;
+			for (const uint64 v : fields) {
+				h ^= v;
+				h *= 1099511628211ull;
+			}
+			return h;
+		}
+	};
+
+	// Shadows the GL state the renderer changes: program, vertex array, texture and sampler units,
+	// framebuffers and the pipeline blocks, and only passes changes on to GL. Render thread only.
+	// Code that changes this state behind its back (ImGui, raw setup calls) must be followed by
+	// Invalidate, and deleted objects must be forgotten before their names can be reused.
+	class GLState {
+	public:
+		static constexpr int textureUnits = 32;
+		// GL calls a full pipeline block stands for
+		static constexpr std::size_t pipelineCalls = 12;
+
+		struct Stats {
+			std::size_t issued = 0;
+			std::size_t skipped = 0;
+		};
+
+	private:
+		static constexpr GLuint unknown = UINT32_MAX;
+
+		GLuint program = unknown;
+		GLuint vertexArray = unknown;
+		GLuint drawFramebuffer = unknown;
+		GLuint readFramebuffer = unknown;
+		GLuint textures[textureUnits];
+		GLuint samplers[textureUnits];
+
+		PipelineDesc pipeline;
+		uint64 pipelineHash = 0;
+		bool pipelineKnown = false;
+
+		Stats frame;
+		Stats lastFrame;
+		Stats total;
+		std::size_t frames = 0;
+
+		GLState();
+
+	public:
+		GLState(const GLState&) = delete;
+		GLState& operator=(const GLState&) = delete;
+
+		static GLState& Get();
+
+		void UseProgram(GLuint handle);
+		void BindVertexArray(GLuint handle);
+		// DSA binds, the active texture unit is never changed
+		void BindTexture(GLuint unit, GLuint handle);
+		void BindSampler(GLuint unit, GLuint handle);
+		// GL_FRAMEBUFFER binds both targets
+		void BindFramebuffer(GLenum target, GLuint handle);
+		void Apply(const PipelineState& state);
+
+		// forgets everything, the next call of each kind goes to GL
+		void Invalidate();
+		void ForgetProgram(GLuint handle);
+		void ForgetVertexArray(GLuint handle);
+		void ForgetTexture(GLuint handle);
+		void ForgetFramebuffer(GLuint handle);
+
+		// closes the frame's counts, GetLastFrame returns them until the next EndFrame
+		void EndFrame();
+		const Stats& GetLastFrame() const { return lastFrame; }
+		const Stats& GetTotal() const { return total; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		// true when GL has to be called, counts the call either way
+		bool Changed(GLuint& shadow, GLuint value);
+		template<typename T>
+		bool Changed(T& shadow, T value, bool known);
+		void SetCapability(GLenum cap, bool& shadow, bool value, bool known);
+	};
+
+} // Render
@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "config.h"
 #include "grid.h"
+#include "glState.h"
 #include <array>
 
 namespace Render
@@ -104,10 +105,10 @@ Grid::Grid() : lineBuffer(0)
 	glBufferData(GL_ARRAY_BUFFER, buf.size() * sizeof(float32), buf.data(), GL_STATIC_DRAW);
 	
 	glGenVertexArrays(1, &this->vao);
-	glBindVertexArray(this->vao);
+	GLState::Get().BindVertexArray(this->vao);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(float32) * 4, NULL);
-	glBindVertexArray(0);
+	GLState::Get().BindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	
 }
@@ -117,6 +118,7 @@ Grid::Grid() : lineBuffer(0)
 */
 Grid::~Grid()
 {
+	GLState::Get().ForgetProgram(this->program);
 	glDeleteProgram(this->program);
 	glDeleteBuffers(1, &this->lineBuffer);
 }
@@ -127,13 +129,12 @@ Grid::~Grid()
 void
 Grid::Draw(float const* const t, float const* const view, float const* const perspective)
 {
-	glUseProgram(this->program);
-	glBindVertexArray(this->vao);
+	GLState::Get().UseProgram(this->program);
+	GLState::Get().BindVertexArray(this->vao);
 	glUniformMatrix4fv(0, 1, false, t);
 	glUniformMatrix4fv(1, 1, false, view);
 	glUniformMatrix4fv(2, 1, false, perspective);
 	glDrawArrays(GL_LINES, 0, gridSize * 2 * 2);
-	glBindVertexArray(0);
 
 }
 
@@ -3,7 +3,18 @@
 
 #include "math/math.h"
 
-#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "util/threadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIGHTS_SSE 1
+#endif
 
 namespace Render {
 
@@ -34,135 +45,428 @@ namespace Render {
 
 	PointLight::PointLight(const Math::vec3& pos, const Math::vec3& a,
 		const Math::vec3& d, const Math::vec3& s, float r, float falloff)
-		: Light(a, d, s), pos(pos), r(r), falloff(falloff), vel({}) {
+		: Light(a, d, s), pos(pos), r(r), falloff(falloff) {
 	}
 
 	PointLight::PointLight(const PointLight& other)
 		: Light(other.GetAmbient(), other.GetDiffuse(), other.GetSpecular()),
-		pos(other.pos), r(other.r), falloff(other.falloff), vel(other.vel) {
+		pos(other.pos), r(other.r), falloff(other.falloff) {
 	}
 
 	SpotLight::SpotLight()
-		: Light(), pos(0.0f), dir({0.0f, -1.0f, 0.0f}), cutoff(Math::toRad(20.0f)), outerCutoff(Math::toRad(35.0f)),
+		: Light(), pos(0.0f), r(1.0f), dir({0.0f, -1.0f, 0.0f}), cutoff(Math::toRad(20.0f)), outerCutoff(Math::toRad(35.0f)),
 		attenuation({ 1.0f, 0.0f, 0.0f }) {
 	}
 
 	SpotLight::SpotLight(const Math::vec3& pos, const Math::vec3& dir, float32 cutoff, float32 ocutoff,
 		const Math::vec3& a, const Math::vec3& d, const Math::vec3& s, const Math::vec3& attenuation)
-		: Light(a, d, s), pos(pos), dir(dir), cutoff(cutoff), outerCutoff(ocutoff), attenuation(attenuation) {
+		: Light(a, d, s), pos(pos), r(1.0f), dir(dir), cutoff(cutoff), outerCutoff(ocutoff), attenuation(attenuation) {
 	}
 
 	LightManager::LightManager()
-	: globalLight(), pointLights(), pointLightsCount(0), spotLights(), spotLightsCount(0) {
+	: globalLight(), pointLights(), spotLights(), ringBuffer(0), ringMapped(nullptr), pointCapacity(0), spotCapacity(0),
+		spotOffset(0), regionSize(0), current(0) {
 	}
 
-	void LightManager::PushPointLight(const PointLight& pl) {
-		if (pointLightsCount >= MAX_NUM_LIGHT_SOURCES) return;
+	LightManager::~LightManager() {
+		for (auto& region : regions) {
+			if (region.fence != nullptr) {
+				glDeleteSync(region.fence);
+			}
+		}
+		if (ringBuffer != 0) {
+			glUnmapNamedBuffer(ringBuffer);
+			glDeleteBuffers(1, &ringBuffer);
+		}
+	}
 
-		pointLights.push_back(pl);
-		pointLightsCount++;
+	LightHandle LightManager::PushPointLight(const PointLight& pl, const Math::vec3& velocity) {
+		uint32 slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			slot = (uint32)slotIndex.size();
+			slotIndex.push_back(invalidIndex);
+			slotGeneration.push_back(0);
+		}
+		slotIndex[slot] = (uint32)pointLights.size();
+		indexSlot.push_back(slot);
+
+		auto& l = pointLights;
+		l.x.push_back(pl.GetPos().x);
+		l.y.push_back(pl.GetPos().y);
+		l.z.push_back(pl.GetPos().z);
+		l.vx.push_back(velocity.x);
+		l.vy.push_back(velocity.y);
+		l.vz.push_back(velocity.z);
+		l.radius.push_back(pl.GetRadius());
+		l.falloff.push_back(pl.GetFalloff());
+		l.ambient.push_back(pl.GetAmbient());
+		l.diffuse.push_back(pl.GetDiffuse());
+		l.specular.push_back(pl.GetSpecular());
+		// pulses start spread out so the lights do not dim in step
+		l.phase.push_back((float32)(slot % 64) / 64.0f);
+		l.intensity.push_back(1.0f);
+
+		return { slot, slotGeneration[slot] };
 	}
 
-	void LightManager::PushSpotLight(const SpotLight& sl) {
-		if (spotLightsCount >= MAX_NUM_LIGHT_SOURCES) return;
+	void LightManager::RemovePointLight(LightHandle h) {
+		if (!IsAlive(h)) {
+			return;
+		}
+
+		// the last light moves into the hole so the arrays stay dense
+		const uint32 index = slotIndex[h.slot];
+		const uint32 last = (uint32)pointLights.size() - 1;
+		const auto move = [index, last](auto& v) {
+			v[index] = v[last];
+			v.pop_back();
+		};
+		auto& l = pointLights;
+		move(l.x);
+		move(l.y);
+		move(l.z);
+		move(l.vx);
+		move(l.vy);
+		move(l.vz);
+		move(l.radius);
+		move(l.falloff);
+		move(l.ambient);
+		move(l.diffuse);
+		move(l.specular);
+		move(l.phase);
+		move(l.intensity);
+
+		slotIndex[indexSlot[last]] = index;
+		move(indexSlot);
+
+		slotIndex[h.slot] = invalidIndex;
+		slotGeneration[h.slot]++;
+		freeSlots.push_back(h.slot);
+	}
+
+	bool LightManager::IsAlive(LightHandle h) const {
+		return h.slot < slotIndex.size() && slotIndex[h.slot] != invalidIndex && slotGeneration[h.slot] == h.generation;
+	}
+
+	PointLight LightManager::GetPointLight(LightHandle h) const {
+		if (!IsAlive(h)) {
+			return PointLight();
+		}
+
+		const auto i = IndexOf(h);
+		const auto& l = pointLights;
+		return PointLight({ l.x[i], l.y[i], l.z[i] }, l.ambient[i], l.diffuse[i], l.specular[i], l.radius[i], l.falloff[i]);
+	}
+
+	void LightManager::SetPointLight(LightHandle h, const PointLight& pl) {
+		if (!IsAlive(h)) {
+			return;
+		}
+
+		const auto i = IndexOf(h);
+		auto& l = pointLights;
+		l.x[i] = pl.GetPos().x;
+		l.y[i] = pl.GetPos().y;
+		l.z[i] = pl.GetPos().z;
+		l.radius[i] = pl.GetRadius();
+		l.falloff[i] = pl.GetFalloff();
+		l.ambient[i] = pl.GetAmbient();
+		l.diffuse[i] = pl.GetDiffuse();
+		l.specular[i] = pl.GetSpecular();
+	}
+
+	void LightManager::SetPointLightVelocity(LightHandle h, const Math::vec3& velocity) {
+		if (!IsAlive(h)) {
+			return;
+		}
+
+		const auto i = IndexOf(h);
+		pointLights.vx[i] = velocity.x;
+		pointLights.vy[i] = velocity.y;
+		pointLights.vz[i] = velocity.z;
+	}
+
+	void LightManager::AnimateRange(const PointLightAnimation& anim, std::size_t begin, std::size_t end) {
+		auto& l = pointLights;
+		std::size_t i = begin;
+#ifdef LIGHTS_SSE
+		const __m128 dt = _mm_set1_ps(anim.dt);
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const __m128 step = _mm_set1_ps(anim.pulseRate * anim.dt);
+		const __m128 depth = _mm_set1_ps(anim.pulseDepth);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+
+		// p += v dt, then lanes past a face are clamped onto it with their speed pointed back inside
+		const auto axis = [&](float32* p, float32* v, float32 lo, float32 hi) {
+			const __m128 low = _mm_set1_ps(lo);
+			const __m128 high = _mm_set1_ps(hi);
+			__m128 pos = _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(_mm_loadu_ps(v), dt));
+			__m128 vel = _mm_loadu_ps(v);
+			const __m128 speed = _mm_andnot_ps(sign, vel);
+			const __m128 below = _mm_cmplt_ps(pos, low);
+			const __m128 above = _mm_cmpgt_ps(pos, high);
+			vel = _mm_or_ps(_mm_and_ps(below, speed), _mm_andnot_ps(below, vel));
+			vel = _mm_or_ps(_mm_and_ps(above, _mm_or_ps(speed, sign)), _mm_andnot_ps(above, vel));
+			pos = _mm_min_ps(_mm_max_ps(pos, low), high);
+			_mm_storeu_ps(p, pos);
+			_mm_storeu_ps(v, vel);
+		};
+
+		for (; i + 4 <= end; i += 4) {
+			axis(&l.x[i], &l.vx[i], anim.boundsMin.x, anim.boundsMax.x);
+			axis(&l.y[i], &l.vy[i], anim.boundsMin.y, anim.boundsMax.y);
+			axis(&l.z[i], &l.vz[i], anim.boundsMin.z, anim.boundsMax.z);
+
+			// phase wraps in [0, 1), the pulse is a triangle wave through it
+			__m128 phase = _mm_add_ps(_mm_loadu_ps(&l.phase[i]), step);
+			phase = _mm_sub_ps(phase, _mm_cvtepi32_ps(_mm_cvttps_epi32(phase)));
+			const __m128 wave = _mm_andnot_ps(sign, _mm_sub_ps(_mm_mul_ps(phase, two), one));
+			_mm_storeu_ps(&l.phase[i], phase);
+			_mm_storeu_ps(&l.intensity[i], _mm_sub_ps(one, _mm_mul_ps(depth, _mm_sub_ps(one, wave))));
+		}
+#endif
+		const auto axis1 = [&](float32& p, float32& v, float32 lo, float32 hi) {
+			p += v * anim.dt;
+			if (p < lo) v = std::abs(v);
+			if (p > hi) v = -std::abs(v);
+			p = std::min(std::max(p, lo), hi);
+		};
+		for (; i < end; ++i) {
+			axis1(l.x[i], l.vx[i], anim.boundsMin.x, anim.boundsMax.x);
+			axis1(l.y[i], l.vy[i], anim.boundsMin.y, anim.boundsMax.y);
+			axis1(l.z[i], l.vz[i], anim.boundsMin.z, anim.boundsMax.z);
+
+			float32 phase = l.phase[i] + anim.pulseRate * anim.dt;
+			phase -= (float32)(int32)phase;
+			l.phase[i] = phase;
+			l.intensity[i] = 1.0f - anim.pulseDepth * (1.0f - std::abs(phase * 2.0f - 1.0f));
+		}
+	}
+
+	void LightManager::AnimatePointLights(const PointLightAnimation& anim, Utils::ThreadPool* pool) {
+		const auto start = std::chrono::steady_clock::now();
+
+		const std::size_t count = pointLights.size();
+		const std::size_t batches = (count + animateBatch - 1) / animateBatch;
+		if (pool && batches > 1) {
+			pool->ParallelFor(batches, [&](std::size_t b) {
+				AnimateRange(anim, b * animateBatch, std::min(count, (b + 1) * animateBatch));
+			});
+		}
+		else {
+			AnimateRange(anim, 0, count);
+		}
 
+		const std::chrono::duration<float64, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		animationStats.steps++;
+		animationStats.lastMs = elapsed.count();
+		animationStats.totalMs += animationStats.lastMs;
+	}
+
+	void LightManager::PushSpotLight(const SpotLight& sl) {
 		spotLights.push_back(sl);
-		spotLightsCount++;
-	}
-
-	void LightManager::SetLightUniforms() {
-		for (const auto& shader : lightingShaders) {
-			auto s = shader.lock();
-			s->Use();
-
-			// set uniforms for the global light source (a.k.a directional light source)
-			s->UploadUniform3fv("dlight.dir", globalLight.GetDirection());
-			s->UploadUniform3fv("dlight.ambient", globalLight.GetAmbient());
-			s->UploadUniform3fv("dlight.diffuse", globalLight.GetDiffuse());
-			s->UploadUniform3fv("dlight.specular", globalLight.GetSpecular());
-
-			std::string uniNameLeft = "plights[";
-			for (std::size_t i = 0; i < pointLightsCount; ++i) {
-				auto temp = uniNameLeft + std::to_string(i);
-				s->UploadUniform3fv(temp + "].pos", pointLights[i].GetPos());
-				s->UploadUniform3fv(temp + "].ambient", pointLights[i].GetAmbient());
-				s->UploadUniform3fv(temp + "].diffuse", pointLights[i].GetDiffuse());
-				s->UploadUniform3fv(temp + "].specular", pointLights[i].GetSpecular());
-				s->UploadUniform1f(temp + "].radius", pointLights[i].GetRadius());
-				s->UploadUniform1f(temp + "].falloff", pointLights[i].GetFalloff());
+	}
+
+	void LightManager::MarkDirty(std::size_t begin, std::size_t end) {
+		for (auto& region : regions) {
+			if (region.dirtyBegin == region.dirtyEnd) {
+				region.dirtyBegin = begin;
+				region.dirtyEnd = end;
 			}
-			s->UploadUniform1i("plights_count", pointLightsCount);
-
-			uniNameLeft = "slights[";
-			for (std::size_t i = 0; i < spotLightsCount; ++i) {
-				auto temp = uniNameLeft + std::to_string(i);
-				s->UploadUniform3fv(temp + "].pos", spotLights[i].GetPos());
-				s->UploadUniform3fv(temp + "].dir", spotLights[i].GetDirection());
-				s->UploadUniform1f(temp + "].cutoff", spotLights[i].GetCutoffAngle());
-				s->UploadUniform1f(temp + "].outerCutoff", spotLights[i].GetOuterCutoffAngle());
-				s->UploadUniform3fv(temp + "].ambient", spotLights[i].GetAmbient());
-				s->UploadUniform3fv(temp + "].diffuse", spotLights[i].GetDiffuse());
-				s->UploadUniform3fv(temp + "].specular", spotLights[i].GetSpecular());
-				s->UploadUniform3fv(temp + "].attenuation", spotLights[i].GetAttenuation());
+			else {
+				region.dirtyBegin = std::min(region.dirtyBegin, begin);
+				region.dirtyEnd = std::max(region.dirtyEnd, end);
 			}
-			s->UploadUniform1i("slights_count", spotLightsCount);
+		}
+	}
+
+	void LightManager::Reserve(std::size_t points, std::size_t spots) {
+		// without lights a region still holds one of each so the bindings stay valid
+		points = std::max<std::size_t>(points, 1);
+		spots = std::max<std::size_t>(spots, 1);
+		if (ringBuffer != 0 && points <= pointCapacity && spots <= spotCapacity) {
+			return;
+		}
 
-			s->UnUse();
+		GLint alignment = 16;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		const auto align = [alignment](std::size_t bytes) {
+			return (bytes + alignment - 1) / alignment * alignment;
+		};
+
+		const std::size_t newPointCapacity = std::max(points, pointCapacity * 2);
+		const std::size_t newSpotCapacity = std::max(spots, spotCapacity * 2);
+		const std::size_t newSpotOffset = align(newPointCapacity * sizeof(GpuPointLight));
+		const std::size_t newRegionSize = align(newSpotOffset + newSpotCapacity * sizeof(GpuSpotLight));
+
+		// the packed lights keep their place relative to the start of their part
+		std::vector<uchar> grown(newRegionSize, 0);
+		if (!staged.empty()) {
+			std::copy_n(staged.begin(), pointCapacity * sizeof(GpuPointLight), grown.begin());
+			std::copy_n(staged.begin() + spotOffset, spotCapacity * sizeof(GpuSpotLight), grown.begin() + newSpotOffset);
 		}
+		staged.swap(grown);
+		pointCapacity = newPointCapacity;
+		spotCapacity = newSpotCapacity;
+		spotOffset = newSpotOffset;
+		regionSize = newRegionSize;
+
+		// the old buffer lives on in the driver until the commands reading it are done
+		for (auto& region : regions) {
+			if (region.fence != nullptr) {
+				glDeleteSync(region.fence);
+			}
+			region = {};
+		}
+		if (ringBuffer != 0) {
+			glUnmapNamedBuffer(ringBuffer);
+			glDeleteBuffers(1, &ringBuffer);
+		}
+
+		constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		const auto bytes = (GLsizeiptr)(regionSize * ringFrames);
+		glCreateBuffers(1, &ringBuffer);
+		glNamedBufferStorage(ringBuffer, bytes, nullptr, flags);
+		ringMapped = static_cast<uchar*>(glMapNamedBufferRange(ringBuffer, 0, bytes, flags));
+		if (ringMapped == nullptr) {
+			std::cerr << "[ERROR] failed to map light buffer\n";
+		}
+		current = 0;
+		MarkDirty(0, regionSize);
 	}
 
-	void LightManager:: DrawLightSources(const Render::Camera& cam) const {
-		auto s = lightSourceShader.lock();
-		s->Use();
+	void LightManager::UploadLights() {
+		stats.frames++;
+		Reserve(pointLights.size(), spotLights.size());
+		if (ringMapped == nullptr) {
+			return;
+		}
 
-		s->UploadUniformMat4fv("view", cam.GetView());
-		s->UploadUniformMat4fv("perspective", cam.GetPerspective());
+		// repack every light and keep the span of those that differ from what was staged
+		std::size_t begin = regionSize;
+		std::size_t end = 0;
+		const auto stage = [&](std::size_t offset, const void* packed, std::size_t bytes) {
+			uchar* dst = staged.data() + offset;
+			if (std::memcmp(dst, packed, bytes) != 0) {
+				std::memcpy(dst, packed, bytes);
+				begin = std::min(begin, offset);
+				end = std::max(end, offset + bytes);
+				stats.dirtyLights++;
+			}
+		};
+
+		const auto& l = pointLights;
+		for (std::size_t i = 0; i < l.size(); ++i) {
+			const float32 intensity = l.intensity[i];
+			GpuPointLight gpu{};
+			gpu.pos[0] = l.x[i];
+			gpu.pos[1] = l.y[i];
+			gpu.pos[2] = l.z[i];
+			gpu.radius = l.radius[i];
+			gpu.falloff = l.falloff[i];
+			for (int c = 0; c < 3; ++c) {
+				gpu.ambient[c] = l.ambient[i][c] * intensity;
+				gpu.diffuse[c] = l.diffuse[i][c] * intensity;
+				gpu.specular[c] = l.specular[i][c] * intensity;
+			}
+			stage(i * sizeof(GpuPointLight), &gpu, sizeof(gpu));
+		}
+
+		for (std::size_t i = 0; i < spotLights.size(); ++i) {
+			const auto& sl = spotLights[i];
+			GpuSpotLight gpu{};
+			std::copy_n(&sl.GetPos().x, 3, gpu.pos);
+			gpu.range = sl.GetRadius();
+			std::copy_n(&sl.GetDirection().x, 3, gpu.dir);
+			gpu.cosCutoff = std::cos(sl.GetCutoffAngle());
+			std::copy_n(&sl.GetAmbient().x, 3, gpu.ambient);
+			gpu.cosOuterCutoff = std::cos(sl.GetOuterCutoffAngle());
+			std::copy_n(&sl.GetDiffuse().x, 3, gpu.diffuse);
+			std::copy_n(&sl.GetSpecular().x, 3, gpu.specular);
+			std::copy_n(&sl.GetAttenuation().x, 3, gpu.attenuation);
+			stage(spotOffset + i * sizeof(GpuSpotLight), &gpu, sizeof(gpu));
+		}
 
-		for (std::size_t i = 0; i < pointLightsCount; ++i) {
-			auto transform = Math::translate(pointLights[i].GetPos()) * Math::scale(0.1f);
-			s->UploadUniformMat4fv("transform", transform);
-			s->UploadUniform3fv("light.ambient", pointLights[i].GetAmbient());
-			s->UploadUniform3fv("light.diffuse", pointLights[i].GetDiffuse());
-			s->UploadUniform3fv("light.specular", pointLights[i].GetSpecular());
+		if (begin < end) {
+			MarkDirty(begin, end);
+		}
 
-			mesh->Draw();
+		// the commands issued so far are the last to read the current region
+		auto& previous = regions[current];
+		if (previous.fence != nullptr) {
+			glDeleteSync(previous.fence);
 		}
+		previous.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-		for (std::size_t i = 0; i < spotLightsCount; ++i) {
-			auto transform = Math::translate(spotLights[i].GetPos()) * Math::scale(0.1f);
-			s->UploadUniformMat4fv("transform", transform);
-			s->UploadUniform3fv("light.ambient", spotLights[i].GetAmbient());
-			s->UploadUniform3fv("light.diffuse", spotLights[i].GetDiffuse());
-			s->UploadUniform3fv("light.specular", spotLights[i].GetSpecular());
+		if (previous.dirtyBegin == previous.dirtyEnd) {
+			return;
+		}
 
-			mesh->Draw();
+		current = (current + 1) % ringFrames;
+		auto& region = regions[current];
+		if (region.fence != nullptr) {
+			GLenum status = glClientWaitSync(region.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+				stats.waits++;
+				glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+			}
+			glDeleteSync(region.fence);
+			region.fence = nullptr;
 		}
 
-		s->UnUse();
+		const std::size_t bytes = region.dirtyEnd - region.dirtyBegin;
+		std::memcpy(ringMapped + current * regionSize + region.dirtyBegin, staged.data() + region.dirtyBegin, bytes);
+		region.dirtyBegin = 0;
+		region.dirtyEnd = 0;
+		stats.uploads++;
+		stats.bytes += bytes;
 	}
 
-	void LightManager::DrawLightSourcesForStencil(const Render::Camera& cam, const std::shared_ptr<Resource::Shader>& s) const {
-		s->UploadUniformMat4fv("view", cam.GetView());
-		s->UploadUniformMat4fv("perspective", cam.GetPerspective());
+	void LightManager::BindLights() const {
+		const auto base = (GLintptr)(current * regionSize);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, pointLightBinding, ringBuffer, base,
+			(GLsizeiptr)(pointCapacity * sizeof(GpuPointLight)));
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, spotLightBinding, ringBuffer, base + (GLintptr)spotOffset,
+			(GLsizeiptr)(spotCapacity * sizeof(GpuSpotLight)));
+	}
+
+	void LightManager::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
 
-		for (std::size_t i = 0; i < pointLightsCount; ++i) {
-			auto transform = Math::translate(pointLights[i].GetPos()) * Math::scale(pointLights[i].GetRadius());
-			s->UploadUniformMat4fv("transform", transform);
-			s->UploadUniform3fv("light.ambient", pointLights[i].GetAmbient());
-			s->UploadUniform3fv("light.diffuse", pointLights[i].GetDiffuse());
-			s->UploadUniform3fv("light.specular", pointLights[i].GetSpecular());
+		out << std::fixed << std::setprecision(1)
+			<< "  " << pointLights.size() << " point and " << spotLights.size() << " spot lights, "
+			<< stats.uploads << " of " << stats.frames << " frames uploaded " << stats.bytes / 1024.0 << " KB\n"
+			<< "  " << stats.dirtyLights << " lights repacked, " << stats.waits << " waits on the ring\n"
+			<< std::setprecision(3)
+			<< "  " << animationStats.steps << " animation steps, last " << animationStats.lastMs << " ms, average "
+			<< (animationStats.steps > 0 ? animationStats.totalMs / animationStats.steps : 0.0) << " ms\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
 
-			mesh->Draw();
+	void LightManager::DrawLightSources() const {
+		const std::size_t count = pointLights.size() + spotLights.size();
+		auto s = lightSourceShader.lock();
+		if (!s || !mesh || count == 0) {
+			return;
 		}
 
-		//for (std::size_t i = 0; i < spotLightsCount; ++i) {
-		//	auto transform = Math::translate(spotLights[i].GetPos()) * Math::scale(0.1f);
-		//	s->UploadUniformMat4fv("transform", transform);
-		//	s->UploadUniform3fv("light.ambient", spotLights[i].GetAmbient());
-		//	s->UploadUniform3fv("light.diffuse", spotLights[i].GetDiffuse());
-		//	s->UploadUniform3fv("light.specular", spotLights[i].GetSpecular());
-		//
-		//	mesh->Draw();
-		//}
+		static const Resource::UniformHandle<GLint> pointCountUniform("pointCount");
+		static const Resource::UniformHandle<float32> gizmoScaleUniform("gizmoScale");
+
+		// the gizmos read position and colour from the uploaded lights, one instanced draw for all
+		BindLights();
+		s->Use();
+		s->Upload(pointCountUniform, (GLint)pointLights.size());
+		s->Upload(gizmoScaleUniform, 0.1f);
+		mesh->DrawInstanced((GLsizei)count);
 	}
+
 } // Render
\ No newline at end of file
@@ -5,10 +5,14 @@
 #include "render/mesh.h"
 #include "render/camera.h"
 
-#include <vector>
+#include <limits>
 #include <memory>
+#include <ostream>
+#include <vector>
 
-
+namespace Utils {
+	class ThreadPool;
+}
 
 namespace Render {
 
@@ -68,12 +72,8 @@ namespace Render {
 		Math::vec3& GetPos() { return pos; }
 		float GetRadius() const { return r; }
 		float GetFalloff() const { return falloff; }
-
-		// For Presentation
-		Math::vec3 vel;
 	};
 
-	// TODO add support for spot lights for deferred shading pipeline
 	class SpotLight : public Light {
 		Math::vec3 pos;
 		float r;
@@ -108,43 +108,203 @@ namespace Render {
 		Math::vec3& GetAttenuation() { return attenuation; }
 	};
 
-	constexpr int MAX_NUM_LIGHT_SOURCES = 128;
+	// a point light as the lighting shaders read it from shader storage, std430
+	struct GpuPointLight {
+		float32 pos[3];
+		float32 radius;
+		float32 ambient[3];
+		float32 falloff;
+		float32 diffuse[4];
+		float32 specular[4];
+	};
+
+	// a spot light as the lighting shaders read it from shader storage, std430; the cutoffs are
+	// cosines so shaders compare them with a dot product
+	struct GpuSpotLight {
+		float32 pos[3];
+		float32 range;
+		float32 dir[3];
+		float32 cosCutoff;
+		float32 ambient[3];
+		float32 cosOuterCutoff;
+		float32 diffuse[4];
+		float32 specular[4];
+		float32 attenuation[4];
+	};
+
+	// names a point light in a LightManager for as long as it lives, whatever is added or removed
+	// around it; a removed light's handle goes stale instead of naming whichever light took its place
+	struct LightHandle {
+		uint32 slot = 0xFFFFFFFF;
+		uint32 generation = 0;
+	};
+
+	// The point lights as structure of arrays. Index i of every array is the same light, in the
+	// order they are uploaded; removing a light moves the last one into its place.
+	struct PointLightArrays {
+		std::vector<float32> x;
+		std::vector<float32> y;
+		std::vector<float32> z;
+		std::vector<float32> vx;
+		std::vector<float32> vy;
+		std::vector<float32> vz;
+		std::vector<float32> radius;
+		std::vector<float32> falloff;
+		std::vector<Math::vec3> ambient;
+		std::vector<Math::vec3> diffuse;
+		std::vector<Math::vec3> specular;
+		// where each light is in its colour pulse, in [0, 1), and the scale that puts on its colours
+		std::vector<float32> phase;
+		std::vector<float32> intensity;
+
+		std::size_t size() const { return x.size(); }
+	};
+
+	// one step of LightManager::AnimatePointLights
+	struct PointLightAnimation {
+		float32 dt = 0.0f;
+		// lights moving out of this box are put back on its face and turned around
+		Math::vec3 boundsMin{ -std::numeric_limits<float32>::infinity() };
+		Math::vec3 boundsMax{ std::numeric_limits<float32>::infinity() };
+		// pulses per second, and how far the intensity dips below 1 at the bottom of a pulse
+		float32 pulseRate = 0.0f;
+		float32 pulseDepth = 0.0f;
+	};
 
 	class LightManager {
+	public:
+		struct UploadStats {
+			std::size_t frames = 0;
+			// frames that wrote into the ring, the rest found nothing changed
+			std::size_t uploads = 0;
+			std::size_t bytes = 0;
+			// lights repacked because they changed
+			std::size_t dirtyLights = 0;
+			// uploads that had to wait for the GPU to let go of the ring region
+			std::size_t waits = 0;
+		};
+
+		struct AnimationStats {
+			std::size_t steps = 0;
+			float64 totalMs = 0.0;
+			float64 lastMs = 0.0;
+		};
+
+	private:
+		// the ring is one persistently mapped buffer of ringFrames regions, each holding all point
+		// lights followed by all spot lights; a region is written only after its fence passed
+		static constexpr int ringFrames = 3;
+
+		struct RingRegion {
+			GLsync fence = nullptr;
+			// bytes of this region older than the packed lights
+			std::size_t dirtyBegin = 0;
+			std::size_t dirtyEnd = 0;
+		};
+
+		// lights per job of a threaded animation step
+		static constexpr std::size_t animateBatch = 8192;
+
 		DirectionalLight globalLight;
-		std::vector<PointLight> pointLights;
-		std::size_t pointLightsCount;
+		PointLightArrays pointLights;
 		std::vector<SpotLight> spotLights;
-		std::size_t spotLightsCount;
 
-		std::vector<std::weak_ptr<Resource::Shader>> lightingShaders;
+		// handle slots: the index of the slot's light and the generation it is on, and back from
+		// light index to slot; freed slots are reused with the next generation
+		std::vector<uint32> slotIndex;
+		std::vector<uint32> slotGeneration;
+		std::vector<uint32> indexSlot;
+		std::vector<uint32> freeSlots;
+
+		// the lights in GPU layout as last packed, laid out like a ring region; dirty tracking
+		// compares against it and regions are copied from it
+		std::vector<uchar> staged;
+
+		GLuint ringBuffer;
+		uchar* ringMapped;
+		std::size_t pointCapacity;
+		std::size_t spotCapacity;
+		// offset of the spot lights inside a region and the distance between regions
+		std::size_t spotOffset;
+		std::size_t regionSize;
+		RingRegion regions[ringFrames];
+		int current;
+
+		UploadStats stats;
+		AnimationStats animationStats;
+
 		std::weak_ptr<Resource::Shader> lightSourceShader;
 		std::shared_ptr<Resource::Mesh> mesh;
+		// unit cone the spot light volumes are drawn with, see Resource::ConeMeshBuilder
+		std::shared_ptr<Resource::Mesh> spotMesh;
 
 	public:
+		// shader storage bindings of the lights; 0 is the virtual texture feedback buffer, 2 and 3
+		// belong to ClusteredLighting
+		static constexpr GLuint pointLightBinding = 1;
+		static constexpr GLuint spotLightBinding = 4;
+		// what IndexOf returns for a removed light
+		static constexpr uint32 invalidIndex = 0xFFFFFFFF;
+
 		LightManager();
+		LightManager(const LightManager&) = delete;
+		LightManager(LightManager&&) = delete;
+		~LightManager();
+
+		LightManager& operator=(const LightManager&) = delete;
+		LightManager& operator=(LightManager&&) = delete;
 
-		void PushLightingShader(const std::weak_ptr<Resource::Shader>& s) { this->lightingShaders.push_back(s); }
 		void SetLightSourceShader(const std::weak_ptr<Resource::Shader>& s) { this->lightSourceShader = s; }
 		void SetMesh(const std::shared_ptr<Resource::Mesh>& m) { this->mesh = m; }
+		void SetSpotMesh(const std::shared_ptr<Resource::Mesh>& m) { this->spotMesh = m; }
 
 		DirectionalLight& GetGlobalLight() { return globalLight; }
 		const DirectionalLight& GetGlobalLight() const { return globalLight; }
-		std::vector<PointLight>& GetPointLights() { return pointLights; }
-		const std::vector<PointLight>& GetPointLights() const { return pointLights; }
+		const PointLightArrays& GetPointLights() const { return pointLights; }
+		std::size_t GetPointLightCount() const { return pointLights.size(); }
 		std::vector<SpotLight>& GetSpotLights() { return spotLights; }
 		const std::vector<SpotLight>& GetSpotLights() const { return spotLights; }
 		const std::shared_ptr<Resource::Mesh>& GetMesh() const { return mesh; }
 		std::shared_ptr<Resource::Mesh>& GetMesh() { return mesh; }
+		const std::shared_ptr<Resource::Mesh>& GetSpotMesh() const { return spotMesh; }
 
 		void SetGlobalLight(const DirectionalLight& dl) { globalLight = dl; }
-		void PushPointLight(const PointLight& pl);
+		LightHandle PushPointLight(const PointLight& pl, const Math::vec3& velocity = Math::vec3(0.0f));
+		void RemovePointLight(LightHandle h);
+		bool IsAlive(LightHandle h) const;
+		// index of the light in GetPointLights and the uploaded buffer, until a light is removed;
+		// getting or setting a removed light does nothing
+		std::size_t IndexOf(LightHandle h) const { return IsAlive(h) ? slotIndex[h.slot] : invalidIndex; }
+		PointLight GetPointLight(LightHandle h) const;
+		void SetPointLight(LightHandle h, const PointLight& pl);
+		void SetPointLightVelocity(LightHandle h, const Math::vec3& velocity);
 		void PushSpotLight(const SpotLight& sl);
 
-		void SetLightUniforms();
-
-		void DrawLightSources(const Render::Camera& cam) const;
-		void DrawLightSourcesForStencil(const Render::Camera& cam, const std::shared_ptr<Resource::Shader>& s) const;
+		// moves every point light by its velocity, bounces it off the bounds and advances its colour
+		// pulse, four lights at a time and with a pool in batches across its workers
+		void AnimatePointLights(const PointLightAnimation& anim, Utils::ThreadPool* pool = nullptr);
+
+		// packs the lights and copies the ones that changed into the next ring region with one
+		// memcpy, once a frame after they moved and before any pass reads them; when nothing
+		// changed the region of the last frame stays bound and nothing is written
+		void UploadLights();
+		// binds the point and spot lights of the current ring region
+		void BindLights() const;
+
+		const UploadStats& GetUploadStats() const { return stats; }
+		const AnimationStats& GetAnimationStats() const { return animationStats; }
+		void PrintStats(std::ostream& out) const;
+
+		// a small sphere on every light in one instanced draw, from the lights uploaded this frame
+		void DrawLightSources() const;
+
+	private:
+		// grows the ring so each region holds at least this many lights
+		void Reserve(std::size_t points, std::size_t spots);
+		// marks bytes [begin, end) of every region as older than the packed lights
+		void MarkDirty(std::size_t begin, std::size_t end);
+		// animates lights [begin, end)
+		void AnimateRange(const PointLightAnimation& anim, std::size_t begin, std::size_t end);
 	};
 
 } // Render
\ No newline at end of file
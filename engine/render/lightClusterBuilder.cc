@@ -0,0 +1,350 @@
+#include "config.h"
+#include "lightClusterBuilder.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+#include "util/threadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CLUSTERS_SSE 1
+#endif
+
+namespace Render {
+
+	// padding spheres fail every test, n·p + w + r never reaches 0
+	static constexpr float32 noRadius = -1e30f;
+
+	void LightClusterBuilder::Spheres::Clear() {
+		x.clear();
+		y.clear();
+		z.clear();
+		r.clear();
+		index.clear();
+		count = 0;
+	}
+
+	void LightClusterBuilder::Spheres::Push(float32 px, float32 py, float32 pz, float32 pr, uint32 i) {
+		x.push_back(px);
+		y.push_back(py);
+		z.push_back(pz);
+		r.push_back(pr);
+		index.push_back(i);
+		count++;
+	}
+
+	void LightClusterBuilder::Spheres::Pad() {
+		while (x.size() % 4 != 0) {
+			x.push_back(0.0f);
+			y.push_back(0.0f);
+			z.push_back(0.0f);
+			r.push_back(noRadius);
+			index.push_back(0);
+		}
+	}
+
+	// bit k set when sphere i + k reaches into the positive side of both planes
+	static int PlanesMask(const float32* x, const float32* y, const float32* z, const float32* r,
+		const float32 a[4], const float32 b[4]) {
+#ifdef CLUSTERS_SSE
+		const __m128 px = _mm_loadu_ps(x);
+		const __m128 py = _mm_loadu_ps(y);
+		const __m128 pz = _mm_loadu_ps(z);
+		const __m128 pr = _mm_loadu_ps(r);
+		const __m128 da = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(a[0])), _mm_mul_ps(py, _mm_set1_ps(a[1]))),
+			_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(a[2])), _mm_set1_ps(a[3])));
+		const __m128 db = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(b[0])), _mm_mul_ps(py, _mm_set1_ps(b[1]))),
+			_mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(b[2])), _mm_set1_ps(b[3])));
+		const __m128 zero = _mm_setzero_ps();
+		return _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(da, pr), zero), _mm_cmpge_ps(_mm_add_ps(db, pr), zero)));
+#else
+		int mask = 0;
+		for (int k = 0; k < 4; ++k) {
+			const float32 da = x[k] * a[0] + y[k] * a[1] + z[k] * a[2] + a[3];
+			const float32 db = x[k] * b[0] + y[k] * b[1] + z[k] * b[2] + b[3];
+			if (da + r[k] >= 0.0f && db + r[k] >= 0.0f) mask |= 1 << k;
+		}
+		return mask;
+#endif
+	}
+
+	// calls emit with every sphere of the arrays that reaches between both planes
+	template<typename Emit>
+	static void Filter(const std::vector<float32>& x, const std::vector<float32>& y, const std::vector<float32>& z,
+		const std::vector<float32>& r, const float32 a[4], const float32 b[4], Emit&& emit) {
+		for (std::size_t i = 0; i < x.size(); i += 4) {
+			int mask = PlanesMask(&x[i], &y[i], &z[i], &r[i], a, b);
+			while (mask != 0) {
+				const int k = std::countr_zero((unsigned)mask);
+				emit(i + k);
+				mask &= mask - 1;
+			}
+		}
+	}
+
+	// bit k set when cone k can touch the sphere at c with radius radius, after Wronski's cone culling
+	static int ConesMask(const float32 cx[4], const float32 cy[4], const float32 cz[4], const float32 dx[4],
+		const float32 dy[4], const float32 dz[4], const float32 cosA[4], const float32 sinA[4], const float32 range[4],
+		const Math::vec3& c, float32 radius) {
+#ifdef CLUSTERS_SSE
+		const __m128 vx = _mm_sub_ps(_mm_set1_ps(c.x), _mm_loadu_ps(cx));
+		const __m128 vy = _mm_sub_ps(_mm_set1_ps(c.y), _mm_loadu_ps(cy));
+		const __m128 vz = _mm_sub_ps(_mm_set1_ps(c.z), _mm_loadu_ps(cz));
+		const __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+		const __m128 v1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(dx)), _mm_mul_ps(vy, _mm_loadu_ps(dy))),
+			_mm_mul_ps(vz, _mm_loadu_ps(dz)));
+		const __m128 side = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lenSq, _mm_mul_ps(v1, v1)), _mm_setzero_ps()));
+		const __m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(cosA), side), _mm_mul_ps(v1, _mm_loadu_ps(sinA)));
+		const __m128 R = _mm_set1_ps(radius);
+		const __m128 keep = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(closest, R),
+			_mm_cmple_ps(v1, _mm_add_ps(R, _mm_loadu_ps(range)))), _mm_cmpge_ps(v1, _mm_sub_ps(_mm_setzero_ps(), R)));
+		return _mm_movemask_ps(keep);
+#else
+		int mask = 0;
+		for (int k = 0; k < 4; ++k) {
+			const float32 vx = c.x - cx[k];
+			const float32 vy = c.y - cy[k];
+			const float32 vz = c.z - cz[k];
+			const float32 lenSq = vx * vx + vy * vy + vz * vz;
+			const float32 v1 = vx * dx[k] + vy * dy[k] + vz * dz[k];
+			const float32 closest = cosA[k] * std::sqrt(std::max(lenSq - v1 * v1, 0.0f)) - v1 * sinA[k];
+			if (closest <= radius && v1 <= radius + range[k] && v1 >= -radius) mask |= 1 << k;
+		}
+		return mask;
+#endif
+	}
+
+	float32 LightClusterBuilder::TileEdge(int tile, int tiles) const {
+		return (float32)tile / (float32)tiles * 2.0f - 1.0f;
+	}
+
+	float32 LightClusterBuilder::SliceDepth(int slice) const {
+		return zNear * std::pow(zFar / zNear, (float32)slice / (float32)settings.depthSlices);
+	}
+
+	void LightClusterBuilder::Build(const LightManager& lights, const Camera& cam, Utils::ThreadPool* pool) {
+		const auto start = std::chrono::steady_clock::now();
+
+		perspective = cam.GetPerspective();
+		zNear = cam.GetNear();
+		zFar = cam.GetFar();
+		const auto view = cam.GetView();
+
+		// a tile edge at NDC a is the plane through the eye with P00 x + (P20 + a) z = 0, the same in y;
+		// view space looks down -z so -z is the positive w
+		const auto normalized = [](float32 nx, float32 ny, float32 nz) {
+			const float32 length = std::sqrt(nx * nx + ny * ny + nz * nz);
+			return Plane{ nx / length, ny / length, nz / length, 0.0f };
+		};
+		columnPlanes.resize(settings.tilesX * 2);
+		for (int x = 0; x < settings.tilesX; ++x) {
+			const float32 left = TileEdge(x, settings.tilesX);
+			const float32 right = TileEdge(x + 1, settings.tilesX);
+			columnPlanes[x * 2] = normalized(perspective[0][0], 0.0f, perspective[2][0] + left);
+			columnPlanes[x * 2 + 1] = normalized(-perspective[0][0], 0.0f, -(perspective[2][0] + right));
+		}
+		rowPlanes.resize(settings.tilesY * 2);
+		for (int y = 0; y < settings.tilesY; ++y) {
+			const float32 bottom = TileEdge(y, settings.tilesY);
+			const float32 top = TileEdge(y + 1, settings.tilesY);
+			rowPlanes[y * 2] = normalized(0.0f, perspective[1][1], perspective[2][1] + bottom);
+			rowPlanes[y * 2 + 1] = normalized(0.0f, -perspective[1][1], -(perspective[2][1] + top));
+		}
+
+		points.Clear();
+		const auto& pointLights = lights.GetPointLights();
+		for (std::size_t i = 0; i < pointLights.size(); ++i) {
+			const auto p = view * Math::vec4{ pointLights.x[i], pointLights.y[i], pointLights.z[i], 1.0f };
+			points.Push(p.x, p.y, p.z, pointLights.radius[i], (uint32)i);
+		}
+		points.Pad();
+
+		// a cone is binned by the sphere bounding it: around the cap for wide cones, through apex and
+		// rim for narrow ones
+		spots.Clear();
+		cones.clear();
+		const auto& spotLights = lights.GetSpotLights();
+		for (std::size_t i = 0; i < spotLights.size(); ++i) {
+			const auto& sl = spotLights[i];
+			const auto p = view * Math::vec4{ sl.GetPos().x, sl.GetPos().y, sl.GetPos().z, 1.0f };
+			auto d = view * Math::vec4{ sl.GetDirection().x, sl.GetDirection().y, sl.GetDirection().z, 0.0f };
+			const float32 length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+			d = d * (1.0f / std::max(length, 1e-6f));
+
+			const float32 angle = std::min(sl.GetOuterCutoffAngle(), 3.14159265f * 0.5f);
+			const float32 range = sl.GetRadius();
+			const float32 cosA = std::cos(angle);
+			const float32 sinA = std::sin(angle);
+			cones.push_back({ p.x, p.y, p.z, d.x, d.y, d.z, cosA, sinA, range });
+
+			float32 offset, radius;
+			if (angle > 3.14159265f * 0.25f) {
+				offset = cosA * range;
+				radius = sinA * range;
+			}
+			else {
+				offset = range / (2.0f * cosA);
+				radius = offset;
+			}
+			spots.Push(p.x + d.x * offset, p.y + d.y * offset, p.z + d.z * offset, radius, (uint32)i);
+		}
+		spots.Pad();
+
+		slices.resize(settings.depthSlices);
+		if (pool) {
+			pool->ParallelFor(slices.size(), [this](std::size_t s) { BuildSlice((int)s); });
+		}
+		else {
+			for (int s = 0; s < settings.depthSlices; ++s) BuildSlice(s);
+		}
+
+		// slices were filled with offsets of their own, they are placed one after the other
+		std::size_t total = 0;
+		for (const auto& work : slices) total += work.indices.size();
+		clusters.resize(GetClusterCount());
+		indices.resize(total);
+
+		std::size_t base = 0;
+		std::size_t maxPerCluster = 0;
+		const std::size_t perSlice = (std::size_t)settings.tilesX * settings.tilesY;
+		for (std::size_t s = 0; s < slices.size(); ++s) {
+			const auto& work = slices[s];
+			for (std::size_t c = 0; c < perSlice; ++c) {
+				auto cluster = work.clusters[c];
+				cluster.offset += (uint32)base;
+				clusters[s * perSlice + c] = cluster;
+				maxPerCluster = std::max<std::size_t>(maxPerCluster, cluster.PointCount() + cluster.SpotCount());
+			}
+			std::copy(work.indices.begin(), work.indices.end(), indices.begin() + base);
+			base += work.indices.size();
+		}
+
+		const std::chrono::duration<float64, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		stats.builds++;
+		stats.lastMs = elapsed.count();
+		stats.totalMs += stats.lastMs;
+		stats.references = total;
+		stats.maxPerCluster = maxPerCluster;
+	}
+
+	void LightClusterBuilder::BuildSlice(int slice) {
+		auto& work = slices[slice];
+		const float32 sliceNear = SliceDepth(slice);
+		const float32 sliceFar = SliceDepth(slice + 1);
+
+		// the slab sliceNear <= -z <= sliceFar
+		const float32 nearPlane[4] = { 0.0f, 0.0f, -1.0f, -sliceNear };
+		const float32 farPlane[4] = { 0.0f, 0.0f, 1.0f, sliceFar };
+		const auto narrow = [](const Spheres& in, Spheres& out, const float32 a[4], const float32 b[4]) {
+			out.Clear();
+			Filter(in.x, in.y, in.z, in.r, a, b, [&](std::size_t i) { out.Push(in.x[i], in.y[i], in.z[i], in.r[i], in.index[i]); });
+			out.Pad();
+		};
+		narrow(points, work.points, nearPlane, farPlane);
+		narrow(spots, work.spots, nearPlane, farPlane);
+
+		work.clusters.assign((std::size_t)settings.tilesX * settings.tilesY, {});
+		work.indices.clear();
+		for (int y = 0; y < settings.tilesY; ++y) {
+			const auto& bottom = rowPlanes[y * 2];
+			const auto& top = rowPlanes[y * 2 + 1];
+			narrow(work.points, work.rowPoints, &bottom.nx, &top.nx);
+			narrow(work.spots, work.rowSpots, &bottom.nx, &top.nx);
+
+			for (int x = 0; x < settings.tilesX; ++x) {
+				auto& cluster = work.clusters[(std::size_t)y * settings.tilesX + x];
+				cluster.offset = (uint32)work.indices.size();
+
+				const auto& left = columnPlanes[x * 2];
+				const auto& right = columnPlanes[x * 2 + 1];
+				uint32 pointCount = 0;
+				const auto& rp = work.rowPoints;
+				Filter(rp.x, rp.y, rp.z, rp.r, &left.nx, &right.nx, [&](std::size_t i) {
+					work.indices.push_back(rp.index[i]);
+					pointCount++;
+				});
+
+				work.candidates.clear();
+				const auto& rs = work.rowSpots;
+				Filter(rs.x, rs.y, rs.z, rs.r, &left.nx, &right.nx, [&](std::size_t i) { work.candidates.push_back(rs.index[i]); });
+
+				uint32 spotCount = 0;
+				if (!work.candidates.empty()) {
+					// bounding sphere of the cell from its eight corners
+					Math::vec3 corners[8];
+					const float32 ndcX[2] = { TileEdge(x, settings.tilesX), TileEdge(x + 1, settings.tilesX) };
+					const float32 ndcY[2] = { TileEdge(y, settings.tilesY), TileEdge(y + 1, settings.tilesY) };
+					const float32 depth[2] = { sliceNear, sliceFar };
+					Math::vec3 center{ 0.0f, 0.0f, 0.0f };
+					for (int c = 0; c < 8; ++c) {
+						const float32 d = depth[c >> 2];
+						corners[c] = Math::vec3{ d * (ndcX[c & 1] + perspective[2][0]) / perspective[0][0],
+							d * (ndcY[(c >> 1) & 1] + perspective[2][1]) / perspective[1][1], -d };
+						center += corners[c] * 0.125f;
+					}
+					float32 radius = 0.0f;
+					for (const auto& corner : corners) radius = std::max(radius, Math::length(corner - center));
+
+					for (std::size_t i = 0; i < work.candidates.size(); i += 4) {
+						float32 lanes[9][4];
+						for (int k = 0; k < 4; ++k) {
+							// the last group repeats its first cone, only real lanes are read from the mask
+							const std::size_t lane = i + k < work.candidates.size() ? i + k : i;
+							const auto& c = cones[work.candidates[lane]];
+							lanes[0][k] = c.x; lanes[1][k] = c.y; lanes[2][k] = c.z;
+							lanes[3][k] = c.dx; lanes[4][k] = c.dy; lanes[5][k] = c.dz;
+							lanes[6][k] = c.cosAngle; lanes[7][k] = c.sinAngle; lanes[8][k] = c.range;
+						}
+						const int mask = ConesMask(lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5],
+							lanes[6], lanes[7], lanes[8], center, radius);
+						for (std::size_t k = 0; k < 4 && i + k < work.candidates.size(); ++k) {
+							if (mask & (1 << k)) {
+								work.indices.push_back(work.candidates[i + k]);
+								spotCount++;
+							}
+						}
+					}
+				}
+
+				cluster.counts = std::min<uint32>(pointCount, 0xFFFF) | (std::min<uint32>(spotCount, 0xFFFF) << 16);
+			}
+		}
+	}
+
+	int LightClusterBuilder::ClusterOf(const Math::vec3& viewPos) const {
+		const float32 depth = -viewPos.z;
+		if (depth < zNear || depth > zFar) {
+			return -1;
+		}
+
+		const float32 ndcX = (perspective[0][0] * viewPos.x + perspective[2][0] * viewPos.z) / depth;
+		const float32 ndcY = (perspective[1][1] * viewPos.y + perspective[2][1] * viewPos.z) / depth;
+		if (std::abs(ndcX) > 1.0f || std::abs(ndcY) > 1.0f) {
+			return -1;
+		}
+		const int x = std::clamp((int)std::floor((ndcX + 1.0f) * 0.5f * settings.tilesX), 0, settings.tilesX - 1);
+		const int y = std::clamp((int)std::floor((ndcY + 1.0f) * 0.5f * settings.tilesY), 0, settings.tilesY - 1);
+		const int slice = std::clamp((int)std::floor(std::log(depth / zNear) / std::log(zFar / zNear) * settings.depthSlices),
+			0, settings.depthSlices - 1);
+		return (slice * settings.tilesY + y) * settings.tilesX + x;
+	}
+
+	void LightClusterBuilder::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		out << std::fixed << std::setprecision(3)
+			<< "  " << settings.tilesX << 'x' << settings.tilesY << 'x' << settings.depthSlices << " clusters, "
+			<< stats.references << " light references, at most " << stats.maxPerCluster << " in one cluster\n"
+			<< "  " << stats.builds << " builds, last " << stats.lastMs << " ms, average "
+			<< (stats.builds > 0 ? stats.totalMs / stats.builds : 0.0) << " ms\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Render
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include "render/camera.h"
+#include "render/light.h"
+
+namespace Utils {
+	class ThreadPool;
+}
+
+namespace Render {
+
+	// Bins the point and spot lights of a LightManager into froxels on the CPU: the view frustum cut
+	// into tilesX x tilesY screen tiles times exponentially spaced depth slices, the same way
+	// ClusteredLighting cuts it. Each slice is refined on its own, lights are first tested against the
+	// slice's depth range, the survivors against each row of tiles and those against each tile, four
+	// lights at a time with SSE. Spot lights are binned by the sphere bounding their cone and then
+	// tested against the bounding sphere of every tile they reach. No GL calls, the output is plain
+	// arrays laid out for shader storage so deferred and forward passes alike can upload and read them.
+	class LightClusterBuilder {
+	public:
+		struct Settings {
+			int tilesX = 16;
+			int tilesY = 9;
+			int depthSlices = 24;
+		};
+
+		// std430 uvec2: where the cluster's lights start in the index list, then its point lights
+		// in the low and spot lights in the high 16 bits
+		struct Cluster {
+			uint32 offset = 0;
+			uint32 counts = 0;
+
+			uint32 PointCount() const { return counts & 0xFFFF; }
+			uint32 SpotCount() const { return counts >> 16; }
+		};
+
+		struct Stats {
+			std::size_t builds = 0;
+			float64 totalMs = 0.0;
+			float64 lastMs = 0.0;
+			// light references in the last build, and the most one cluster held
+			std::size_t references = 0;
+			std::size_t maxPerCluster = 0;
+		};
+
+	private:
+		// view space spheres as structure of arrays, padded to a multiple of four with spheres that
+		// can not pass any test
+		struct Spheres {
+			std::vector<float32> x;
+			std::vector<float32> y;
+			std::vector<float32> z;
+			std::vector<float32> r;
+			std::vector<uint32> index;
+
+			void Clear();
+			void Push(float32 px, float32 py, float32 pz, float32 pr, uint32 i);
+			void Pad();
+			// lights before the padding
+			std::size_t count = 0;
+		};
+
+		// a plane n·p + w = 0, spheres reaching into n·p + w >= 0 pass
+		struct Plane {
+			float32 nx;
+			float32 ny;
+			float32 nz;
+			float32 w;
+		};
+
+		struct Cone {
+			float32 x, y, z;
+			float32 dx, dy, dz;
+			float32 cosAngle;
+			float32 sinAngle;
+			float32 range;
+		};
+
+		// one per depth slice so slices can be built in parallel and reuse their memory
+		struct SliceWork {
+			Spheres points;
+			Spheres spots;
+			Spheres rowPoints;
+			Spheres rowSpots;
+			std::vector<uint32> candidates;
+			std::vector<Cluster> clusters;
+			std::vector<uint32> indices;
+		};
+
+		Settings settings;
+		Stats stats;
+
+		Math::mat4 perspective;
+		float32 zNear = 0.1f;
+		float32 zFar = 100.0f;
+		// the two side planes of every column and row of tiles
+		std::vector<Plane> columnPlanes;
+		std::vector<Plane> rowPlanes;
+		Spheres points;
+		Spheres spots;
+		std::vector<Cone> cones;
+		std::vector<SliceWork> slices;
+
+		std::vector<Cluster> clusters;
+		std::vector<uint32> indices;
+
+	public:
+		LightClusterBuilder() = default;
+
+		void SetSettings(const Settings& s) { settings = s; }
+		const Settings& GetSettings() const { return settings; }
+
+		// with a pool the depth slices are binned across its workers
+		void Build(const LightManager& lights, const Camera& cam, Utils::ThreadPool* pool = nullptr);
+
+		// tilesX * tilesY * depthSlices entries, x fastest, then y, then the slice
+		const std::vector<Cluster>& GetClusters() const { return clusters; }
+		// per cluster its point light indices followed by its spot light indices, into the
+		// LightManager's vectors
+		const std::vector<uint32>& GetIndices() const { return indices; }
+
+		int GetClusterCount() const { return settings.tilesX * settings.tilesY * settings.depthSlices; }
+		// the cluster a view space position of the last build falls into, -1 outside the frustum
+		int ClusterOf(const Math::vec3& viewPos) const;
+
+		const Stats& GetStats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		void BuildSlice(int slice);
+		// NDC x or y of a tile edge, and the view space depth of a slice edge
+		float32 TileEdge(int tile, int tiles) const;
+		float32 SliceDepth(int slice) const;
+	};
+
+} // Render
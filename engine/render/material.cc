@@ -1,51 +1,87 @@
 #include "config.h"
 #include "material.h"
 
+#include "textureArray.h"
+#include "virtualTexture.h"
+
 namespace Resource {
 
+	// texture units, fixed by the binding layouts of the geometry pass fragment shaders
+	static constexpr GLint diffuseUnit = 0;
+	static constexpr GLint surfaceUnit = 1;
+	// each virtual texture takes two, its indirection table and its atlas
+	static constexpr GLint virtualDiffuseUnit = 3;
+	static constexpr GLint virtualSurfaceUnit = 5;
+	static constexpr GLint arrayDiffuseUnit = 10;
+	static constexpr GLint arraySurfaceUnit = 11;
+
 	Material::Material()
-		: shininess(8.0f) {
+		: shininess(8.0f), index(MaterialTable::Get().Allocate(this)) {
 	}
 
 	Material::Material(const std::weak_ptr<Resource::Texture>& diff,
-		const std::weak_ptr<Resource::Texture>& spec, float32 shin,
+		const std::weak_ptr<Resource::Texture>& surf, float32 shin,
 		const std::weak_ptr<Shader>& s)
-		: diffuse(diff), specular(spec), shininess(shin), shader(s) {
+		: diffuse(diff), surface(surf), shininess(shin), shader(s), index(MaterialTable::Get().Allocate(this)) {
 	}
 
-	void Material::Use() {
-		const auto& s = shader.lock();
+	Material::~Material() {
+		MaterialTable::Get().Release(index);
+	}
 
-		s->UploadUniform1i("material.diffuse", 0);
-		diffuse.lock()->Bind(0);
+	static void PackSlot(const Texture* texture, int32& layer, int32& id, GpuVirtualSlot& slot) {
+		layer = texture != nullptr && texture->GetArray() ? texture->GetLayer() : -1;
 
-		s->UploadUniform1i("material.specular", 1);
-		specular.lock()->Bind(1);
+		const auto info = VirtualTextureSystem::Get().GetSlot(texture);
+		id = info.id;
+		slot.pages[0] = (float32)info.pagesX;
+		slot.pages[1] = (float32)info.pagesY;
+		slot.atlasPages = (float32)info.atlasPages;
+		slot.levels = info.levels;
+	}
 
-		s->UploadUniform4fv("material.ambient", ambient);
-		s->UploadUniform1f("material.roughness", roughness);
-		s->UploadUniform1f("material.shininess", shininess);
+	void Material::Pack(GpuMaterial& out) const {
+		out = {};
+		out.ambient[0] = ambient.x;
+		out.ambient[1] = ambient.y;
+		out.ambient[2] = ambient.z;
+		out.ambient[3] = ambient.w;
+		out.roughness = roughness;
+		out.shininess = shininess;
+		out.normalMapped = normalMapped;
+		PackSlot(diffuse.lock().get(), out.diffuseLayer, out.diffuseVirtual, out.virtualDiffuse);
+		PackSlot(surface.lock().get(), out.surfaceLayer, out.surfaceVirtual, out.virtualSurface);
 	}
 
-	NormalMapMaterial::NormalMapMaterial(const std::weak_ptr<Texture>& diff, const std::weak_ptr<Texture>& spec,
-		const std::weak_ptr<Texture>& norm, float32 shin, const std::weak_ptr<Shader>& s)
-		: Material(diff, spec, shin, s), normal(norm) {
+	void Material::Use() {
+		diffuse.lock()->Bind(diffuseUnit);
+		surface.lock()->Bind(surfaceUnit);
 	}
 
-	void NormalMapMaterial::Use() {
-		const auto& s = shader.lock();
+	void VirtualMaterial::Use() {
+		Material::Use();
 
-		s->UploadUniform1i("material.diffuse", 0);
-		diffuse.lock()->Bind(0);
+		const auto& s = shader.lock();
+		const auto& vt = VirtualTextureSystem::Get();
+		vt.Bind(diffuse.lock().get(), virtualDiffuseUnit);
+		vt.Bind(surface.lock().get(), virtualSurfaceUnit);
 
-		s->UploadUniform1i("material.specular", 1);
-		specular.lock()->Bind(1);
+		// one of the two slots writes feedback each frame, in turn
+		vt.BindFeedback(*s, (int)(vt.GetFrame() % 2));
+	}
 
-		s->UploadUniform1i("material.normal", 2);
-		normal.lock()->Bind(2);
+	// textures that are not packed (yet) are bound as plain 2D textures
+	static void BindArraySlot(const Texture& texture, GLint plainUnit, GLint arrayUnit) {
+		if (const auto& array = texture.GetArray()) {
+			array->Bind(arrayUnit);
+		}
+		else {
+			texture.Bind(plainUnit);
+		}
+	}
 
-		s->UploadUniform4fv("material.ambient", ambient);
-		s->UploadUniform1f("material.roughness", roughness);
-		s->UploadUniform1f("material.shininess", shininess);
+	void ArrayMaterial::Use() {
+		BindArraySlot(*diffuse.lock(), diffuseUnit, arrayDiffuseUnit);
+		BindArraySlot(*surface.lock(), surfaceUnit, arraySurfaceUnit);
 	}
-} // Resource
\ No newline at end of file
+} // Resource
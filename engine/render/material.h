@@ -3,52 +3,74 @@
 #include "config.h"
 #include "render/texture.h"
 #include "render/shader.h"
+#include "render/materialTable.h"
 
 #include <memory>
 
 
 namespace Resource {
 
+	// Textures come channel packed from the import (see Channels::PackSurface): diffuse holds
+	// albedo and alpha, surface roughness, metalness and the tangent space normal's X and Y.
+	// The parameters live in the MaterialTable under the material's index, Use only binds textures.
 	class Material {
 	protected:
 		Math::vec4 ambient = { 1.0f };
 		float32 roughness = 1.0f;
 		std::weak_ptr<Texture> diffuse;
-		std::weak_ptr<Texture> specular;
+		std::weak_ptr<Texture> surface;
 		float32 shininess = 1.0f;
+		// without a normal map the interpolated vertex normal is written
+		bool normalMapped = false;
 
 		std::weak_ptr<Shader> shader;
 
+	private:
+		// into the MaterialTable, also orders draws in the RenderQueue
+		uint32 index;
+
 	public:
 		Material();
 		Material(const std::weak_ptr<Texture>& diff,
-		         const std::weak_ptr<Texture>& spec, float32 shin,
+		         const std::weak_ptr<Texture>& surf, float32 shin,
 		         const std::weak_ptr<Shader>& s);
+		Material(const Material&) = delete;
+		Material& operator=(const Material&) = delete;
+		virtual ~Material();
 
 		virtual void Use();
+		// the parameters as the shaders read them, render thread only
+		void Pack(GpuMaterial& out) const;
 
 		void SetAmbient(const Math::vec4& v) { ambient = v; }
 		void SetDiffuseTex(const std::weak_ptr<Texture>& tex) { diffuse = tex; }
 		void SetRoughness(float v) { roughness = v; }
-		void SetSpecTex(const std::weak_ptr<Texture>& tex) { specular = tex; }
+		void SetSurfaceTex(const std::weak_ptr<Texture>& tex) { surface = tex; }
 		void SetShininess(float32 shin) { this->shininess = shin; }
 		void SetShader(const std::weak_ptr<Shader>& s) { this->shader = s; }
+		void SetNormalMapped(bool v) { normalMapped = v; }
 
 		float32 GetShininess() const { return shininess; }
+		uint32 GetIndex() const { return index; }
 		const std::weak_ptr<Shader>& GetShader() const { return shader; }
 	};
 
-	class NormalMapMaterial : public Material {
-		std::weak_ptr<Texture> normal;
-
+	// samples every slot whose texture is paged by the VirtualTextureSystem through its indirection
+	// table and records the pages it needs, the rest as a Material; for gVirtualFrag.glsl
+	class VirtualMaterial : public Material {
 	public:
-		NormalMapMaterial() = default;
-		NormalMapMaterial(const std::weak_ptr<Texture>& diff, const std::weak_ptr<Texture>& spec,
-			const std::weak_ptr<Texture>& norm, float32 shin, const std::weak_ptr<Shader>& s);
+		VirtualMaterial() = default;
 
 		void Use() override;
+	};
 
-		void SetNormTex(const std::weak_ptr<Texture>& tex) { normal = tex; }
+	// samples every slot whose texture the TextureArrayPacker moved into an array from that array,
+	// bound to a unit of its own so consecutive draws from the same arrays rebind nothing; for gArrayFrag.glsl
+	class ArrayMaterial : public Material {
+	public:
+		ArrayMaterial() = default;
+
+		void Use() override;
 	};
 
 } // Resource
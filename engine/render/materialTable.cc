@@ -0,0 +1,99 @@
+#include "config.h"
+#include "materialTable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+#include "material.h"
+
+namespace Resource {
+
+	MaterialTable& MaterialTable::Get() {
+		static MaterialTable table;
+		return table;
+	}
+
+	uint32 MaterialTable::Allocate(const Material* material) {
+		std::lock_guard lock(mutex);
+		if (!freeIndices.empty()) {
+			const uint32 index = freeIndices.back();
+			freeIndices.pop_back();
+			materials[index] = material;
+			return index;
+		}
+		materials.push_back(material);
+		return (uint32)materials.size() - 1;
+	}
+
+	void MaterialTable::Release(uint32 index) {
+		std::lock_guard lock(mutex);
+		materials[index] = nullptr;
+		freeIndices.push_back(index);
+	}
+
+	void MaterialTable::Update() {
+		std::lock_guard lock(mutex);
+
+		// the packed structs have no implicit padding, so comparing bytes compares the values
+		std::size_t first = materials.size();
+		std::size_t last = 0;
+		entries.resize(materials.size());
+		for (std::size_t i = 0; i < materials.size(); ++i) {
+			if (materials[i] == nullptr) {
+				continue;
+			}
+			GpuMaterial packed;
+			materials[i]->Pack(packed);
+			if (std::memcmp(&packed, &entries[i], sizeof(GpuMaterial)) != 0) {
+				entries[i] = packed;
+				first = std::min(first, i);
+				last = i + 1;
+			}
+		}
+
+		if (buffer == 0 || capacity < entries.size()) {
+			if (buffer != 0) {
+				glDeleteBuffers(1, &buffer);
+			}
+			capacity = std::max<std::size_t>(std::max<std::size_t>(capacity * 2, 64), entries.size());
+			glCreateBuffers(1, &buffer);
+			glNamedBufferStorage(buffer, capacity * sizeof(GpuMaterial), nullptr, GL_DYNAMIC_STORAGE_BIT);
+			first = 0;
+			last = entries.size();
+		}
+
+		if (first < last) {
+			glNamedBufferSubData(buffer, first * sizeof(GpuMaterial), (last - first) * sizeof(GpuMaterial), entries.data() + first);
+			stats.uploads += last - first;
+			stats.bytes += (last - first) * sizeof(GpuMaterial);
+		}
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+
+		stats.frames++;
+		stats.materials = materials.size() - freeIndices.size();
+	}
+
+	void MaterialTable::ReleaseBuffer() {
+		std::lock_guard lock(mutex);
+		if (buffer != 0) {
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+		}
+		capacity = 0;
+		entries.clear();
+	}
+
+	void MaterialTable::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		out << std::fixed << std::setprecision(1)
+			<< "  " << stats.materials << " materials, " << stats.uploads << " entries (" << stats.bytes / 1024.0
+			<< " KiB) uploaded over " << stats.frames << " frames\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Resource
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace Resource {
+
+	class Material;
+
+	// where a texture of a material lives in the VirtualTextureSystem, std430
+	struct GpuVirtualSlot {
+		float32 pages[2];
+		float32 atlasPages;
+		int32 levels;
+	};
+
+	// a material as the geometry pass shaders read it from shader storage, std430; must match the
+	// Material struct of gArrayFrag.glsl and gVirtualFrag.glsl
+	struct GpuMaterial {
+		float32 ambient[4];
+		float32 roughness;
+		float32 shininess;
+		uint32 normalMapped;
+		// TextureArray layers, -1 for textures not packed into one
+		int32 diffuseLayer;
+		int32 surfaceLayer;
+		// VirtualTextureSystem ids, -1 for textures that are not virtual
+		int32 diffuseVirtual;
+		int32 surfaceVirtual;
+		uint32 padding;
+		GpuVirtualSlot virtualDiffuse;
+		GpuVirtualSlot virtualSurface;
+	};
+	static_assert(sizeof(GpuMaterial) == 80);
+
+	// The parameters of every live material in one shader storage buffer. A material takes an index
+	// when it is created and keeps it for life; the RenderQueue hands that index to the shaders in
+	// each draw's record, so switching materials uploads no uniforms. Update repacks the materials once a frame
+	// and uploads only the entries that changed, which after loading is none, except when a texture
+	// was moved into an array or registered as virtual. Indices are handed out from any thread,
+	// Update and ReleaseBuffer are render thread only.
+	class MaterialTable {
+	public:
+		// shader storage binding, must match gArrayFrag.glsl and gVirtualFrag.glsl
+		static constexpr GLuint binding = 5;
+
+		struct Stats {
+			std::size_t frames = 0;
+			std::size_t materials = 0;
+			// entries and bytes written to the buffer, over all frames
+			std::size_t uploads = 0;
+			std::size_t bytes = 0;
+		};
+
+	private:
+		std::mutex mutex;
+		// by index, null where the index is free
+		std::vector<const Material*> materials;
+		std::vector<uint32> freeIndices;
+		// what the buffer holds
+		std::vector<GpuMaterial> entries;
+
+		GLuint buffer = 0;
+		std::size_t capacity = 0;
+		Stats stats;
+
+		MaterialTable() = default;
+
+	public:
+		MaterialTable(const MaterialTable&) = delete;
+		MaterialTable& operator=(const MaterialTable&) = delete;
+
+		static MaterialTable& Get();
+
+		uint32 Allocate(const Material* material);
+		void Release(uint32 index);
+
+		// repacks every material, uploads the changed entries and binds the buffer
+		void Update();
+		// frees the buffer, needs the context; the next Update makes a new one
+		void ReleaseBuffer();
+
+		const Stats& GetStats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+	};
+
+} // Resource
@@ -1,9 +1,14 @@
 #include "config.h"
 #include "mesh.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 
+#include "glState.h"
+#include "math/math.h"
+
 #include "util/meshDataParser.h"
 
 #include "fx/gltf.h"
@@ -34,7 +39,7 @@ namespace Resource {
 		const std::size_t* offsets, std::size_t count) {
 		// TODO maybe split the vertex data buffer into separate buffers (e.g pos, norm and uv buffers)
 		glGenVertexArrays(1, &this->vao);
-		glBindVertexArray(this->vao);
+		Render::GLState::Get().BindVertexArray(this->vao);
 
 		std::size_t stride{ 0 };
 		for (std::size_t i = 0; i < count; ++i) stride += sizes[i];
@@ -92,12 +97,17 @@ namespace Resource {
 			ib.data(), 
 			GL_STATIC_DRAW);
 
+		for (GLuint i = 0; i < 3; ++i) {
+			glEnableVertexAttribArray(i);
+		}
+
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		Render::GLState::Get().BindVertexArray(0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
 
 	void Mesh::DeInit() {
+		Render::GLState::Get().ForgetVertexArray(vao);
 		glDeleteVertexArrays(1, &vao);
 		glDeleteBuffers(3, vbos);
 		glDeleteBuffers(1, &ebo);
@@ -111,7 +121,6 @@ namespace Resource {
 			}
 			glDrawElements(GL_TRIANGLES, el.indices, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * el.offset));
 		}
-		UnBind();
 	}
 
 	void Mesh::DrawGroup(std::size_t i) const {
@@ -125,7 +134,13 @@ namespace Resource {
 			groups[i].mat.lock()->Use();
 		}
 		glDrawElements(GL_TRIANGLES, groups[i].indices, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * groups[i].offset));
-		UnBind();
+	}
+
+	void Mesh::DrawInstanced(GLsizei count) const {
+		Bind();
+		for (const auto& el : groups) {
+			glDrawElementsInstanced(GL_TRIANGLES, el.indices, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * el.offset), count);
+		}
 	}
 
 	void Mesh::PushPrimitive(PrimitiveGroup group) {
@@ -133,14 +148,11 @@ namespace Resource {
 	}
 
 	void Mesh::Bind() const {
-		glBindVertexArray(this->vao);
-		for (std::size_t i = 0; i < 3; ++i) {
-			glEnableVertexAttribArray(i);
-		}
+		Render::GLState::Get().BindVertexArray(this->vao);
 	}
 
 	void Mesh::UnBind() const {
-		glBindVertexArray(0);
+		Render::GLState::Get().BindVertexArray(0);
 	}
 
 	void VertexData::clear() {
@@ -181,6 +193,38 @@ namespace Resource {
 		return mesh;
 	}
 
+	ConeMeshBuilder::ConeMeshBuilder(int segments) {
+		segments = std::max(segments, 3);
+		const float step = 2.0f * Math::PI / (float)segments;
+		// the polygon's edges touch the unit circle instead of its corners
+		const float radius = 1.0f / std::cos(step * 0.5f);
+
+		vertexes.push_back({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f });
+		vertexes.push_back({ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f });
+		for (int i = 0; i < segments; ++i) {
+			const float c = std::cos(step * i);
+			const float s = std::sin(step * i);
+			vertexes.push_back({ radius * c, radius * s, 1.0f }, Math::normalize(Math::vec3{ c, s, -radius }), { 0.0f, 0.0f });
+		}
+
+		// counter-clockwise seen from outside, side then base
+		for (int i = 0; i < segments; ++i) {
+			const GLuint a = 2 + i;
+			const GLuint b = 2 + (i + 1) % segments;
+			indices.insert(indices.end(), { 0, b, a });
+			indices.insert(indices.end(), { 1, a, b });
+		}
+	}
+
+	Mesh ConeMeshBuilder::CreateMesh() const {
+		Mesh mesh{};
+		std::size_t sizes[] = { 3, 3, 2 };
+		std::size_t offsets[] = { 0, 3, 6 };
+		mesh.Init(vertexes, indices, sizes, offsets, 3);
+		mesh.PushPrimitive({ indices.size(), 0, {} });
+		return mesh;
+	}
+
 	GLTFMeshBuilder::GLTFMeshBuilder(const std::filesystem::path& path) {
 		//auto path = std::filesystem::path(path_str);
 		if (!is_regular_file(path)) {
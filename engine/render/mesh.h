@@ -39,6 +39,8 @@ namespace Resource {
 
 		void Draw() const;
 		void DrawGroup(std::size_t i) const;
+		// every group count times, materials are not used; instances tell themselves apart by gl_InstanceID
+		void DrawInstanced(GLsizei count) const;
 
 		void PushPrimitive(PrimitiveGroup group);
 
@@ -89,6 +91,19 @@ namespace Resource {
 		Mesh CreateMesh() const override;
 	};
 
+	// A closed cone generated on the spot: apex at the origin, opening along +z to a flat base at
+	// z = 1 whose polygon circumscribes the unit circle, so scaling it by a spot light's range and
+	// base radius bounds the light exactly. Used as a light volume, normals and uvs are not meaningful.
+	class ConeMeshBuilder final : public MeshBuilder {
+	public:
+		explicit ConeMeshBuilder(int segments = 24);
+		~ConeMeshBuilder() override = default;
+
+		// nothing to read, the cone is built in the constructor
+		void ReadMeshData(const std::filesystem::path&) override {}
+		Mesh CreateMesh() const override;
+	};
+
 	class GLTFMeshBuilder final : public MeshBuilder {
 		explicit GLTFMeshBuilder(const std::filesystem::path& path);
 		~GLTFMeshBuilder() override = default;
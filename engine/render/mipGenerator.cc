@@ -0,0 +1,266 @@
+#include "config.h"
+#include "mipGenerator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MIPS_SSE 1
+#endif
+
+namespace Resource::Mips {
+
+	static constexpr float pi = 3.14159265358979f;
+
+	static float Sinc(float x) {
+		if (std::abs(x) < 1e-5f) return 1.0f;
+		return std::sin(pi * x) / (pi * x);
+	}
+
+	// zeroth order modified Bessel function of the first kind
+	static float BesselI0(float x) {
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 20; ++k) {
+			term *= (x / (2.0f * k)) * (x / (2.0f * k));
+			sum += term;
+			if (term < sum * 1e-7f) break;
+		}
+		return sum;
+	}
+
+	static float Radius(MipFilter filter) {
+		return filter == MipFilter::Box ? 0.5f : 3.0f;
+	}
+
+	// x in destination texels
+	static float Kernel(MipFilter filter, float x) {
+		const float r = Radius(filter);
+		if (std::abs(x) >= r) return 0.0f;
+		switch (filter) {
+		case MipFilter::Box:
+			return 1.0f;
+		case MipFilter::Kaiser: {
+			constexpr float alpha = 4.0f;
+			const float t = x / r;
+			return Sinc(x) * BesselI0(alpha * std::sqrt(1.0f - t * t)) / BesselI0(alpha);
+		}
+		case MipFilter::Lanczos:
+			return Sinc(x) * Sinc(x / r);
+		}
+		return 0.0f;
+	}
+
+	// source indices and normalised weights of every destination texel along one axis, width taps each
+	struct Taps {
+		int width = 0;
+		std::vector<int> index;
+		std::vector<float> weight;
+	};
+
+	static Taps BuildTaps(int srcSize, int dstSize, const MipSettings& settings) {
+		const float scale = (float)srcSize / dstSize;
+		const float radius = Radius(settings.filter) * scale;
+
+		Taps taps;
+		taps.width = (int)std::ceil(2.0f * radius) + 2;
+		taps.index.resize((std::size_t)dstSize * taps.width);
+		taps.weight.resize((std::size_t)dstSize * taps.width);
+
+		for (int i = 0; i < dstSize; ++i) {
+			const float center = (i + 0.5f) * scale;
+			const int first = (int)std::floor(center - radius);
+			float sum = 0.0f;
+			for (int k = 0; k < taps.width; ++k) {
+				const int j = first + k;
+				const float w = Kernel(settings.filter, (j + 0.5f - center) / scale);
+				taps.index[i * taps.width + k] = settings.wrap
+					? ((j % srcSize) + srcSize) % srcSize
+					: std::clamp(j, 0, srcSize - 1);
+				taps.weight[i * taps.width + k] = w;
+				sum += w;
+			}
+			for (int k = 0; k < taps.width; ++k) taps.weight[i * taps.width + k] /= sum;
+		}
+		return taps;
+	}
+
+	// acc += w * px over the four channels of one texel
+	static inline void MulAdd(float* acc, const float* px, float w) {
+#ifdef MIPS_SSE
+		_mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(_mm_set1_ps(w), _mm_loadu_ps(px))));
+#else
+		for (int ch = 0; ch < 4; ++ch) acc[ch] += w * px[ch];
+#endif
+	}
+
+	struct SrgbTables {
+		std::array<float, 256> toLinear;
+		std::array<uchar, 16384> fromLinear;
+
+		SrgbTables() {
+			for (int i = 0; i < 256; ++i) {
+				const float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (std::size_t i = 0; i < fromLinear.size(); ++i) {
+				const float l = (float)i / (fromLinear.size() - 1);
+				const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = (uchar)std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f);
+			}
+		}
+
+		static const SrgbTables& Get() {
+			static const SrgbTables tables;
+			return tables;
+		}
+	};
+
+	static void ForEachRow(Utils::ThreadPool* pool, int rows, const std::function<void(std::size_t)>& fn) {
+		if (pool != nullptr) {
+			pool->ParallelFor(rows, fn);
+		}
+		else {
+			for (int r = 0; r < rows; ++r) fn(r);
+		}
+	}
+
+	static float Coverage(const std::vector<float>& level, float cutoff, float scale) {
+		const std::size_t count = level.size() / 4;
+		std::size_t passing = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			// measured on the byte the level stores, which is what gets alpha tested
+			const float alpha = std::lround(std::min(level[i * 4 + 3] * scale, 1.0f) * 255.0f) / 255.0f;
+			if (alpha >= cutoff) passing++;
+		}
+		return (float)passing / count;
+	}
+
+	// alpha scale that brings the level's coverage back to the target, coverage only grows with the scale
+	static float FitCoverage(const std::vector<float>& level, float cutoff, float target) {
+		const float current = Coverage(level, cutoff, 1.0f);
+		if (current == target) return 1.0f;
+
+		float lo = current < target ? 1.0f : 0.0f;
+		float hi = current < target ? 4.0f : 1.0f;
+		for (int it = 0; it < 16; ++it) {
+			const float mid = 0.5f * (lo + hi);
+			if (Coverage(level, cutoff, mid) < target) lo = mid;
+			else hi = mid;
+		}
+		// coverage moves in steps, on small levels the scale just short of the target can land closer
+		return target - Coverage(level, cutoff, lo) < Coverage(level, cutoff, hi) - target ? lo : hi;
+	}
+
+	float AlphaCoverage(const ImageData& rgba, std::size_t level, float cutoff) {
+		const uchar* pixels = rgba.LevelData(level);
+		const std::size_t count = (std::size_t)rgba.levels[level].width * rgba.levels[level].height;
+		std::size_t passing = 0;
+		for (std::size_t i = 0; i < count; ++i) {
+			if (pixels[i * 4 + 3] / 255.0f >= cutoff) passing++;
+		}
+		return (float)passing / count;
+	}
+
+	ImageData Generate(const ImageData& rgba, const MipSettings& settings, Utils::ThreadPool* pool) {
+		if (!rgba.IsValid() || rgba.format != PixelFormat::RGBA8) {
+			std::cerr << "[ERROR] mip generation needs an RGBA8 image\n";
+			return rgba;
+		}
+
+		const auto& tables = SrgbTables::Get();
+		const bool alphaTested = settings.alphaCutoff >= 0.0f;
+		const float targetCoverage = alphaTested ? AlphaCoverage(rgba, 0, settings.alphaCutoff) : 0.0f;
+
+		ImageData chain;
+		chain.width = rgba.width;
+		chain.height = rgba.height;
+		chain.format = PixelFormat::RGBA8;
+		chain.pixels.assign(rgba.LevelData(0), rgba.LevelData(0) + rgba.levels[0].size);
+		chain.levels.push_back({ rgba.width, rgba.height, 0, rgba.levels[0].size });
+
+		// level 0 is read straight from the bytes, every later level from the float level above it
+		std::vector<float> above;
+		auto loadRow = [&](int y, int w, std::vector<float>& row) -> const float* {
+			if (!above.empty()) return above.data() + (std::size_t)y * w * 4;
+
+			row.resize((std::size_t)w * 4);
+			const uchar* src = chain.pixels.data() + (std::size_t)y * w * 4;
+			for (int x = 0; x < w; ++x) {
+				for (int ch = 0; ch < 3; ++ch) {
+					row[x * 4 + ch] = settings.srgb ? tables.toLinear[src[x * 4 + ch]] : src[x * 4 + ch] / 255.0f;
+				}
+				row[x * 4 + 3] = src[x * 4 + 3] / 255.0f;
+			}
+			return row.data();
+		};
+
+		int w = rgba.width;
+		int h = rgba.height;
+		while (w > 1 || h > 1) {
+			const int nw = std::max(w / 2, 1);
+			const int nh = std::max(h / 2, 1);
+			const Taps horizontal = BuildTaps(w, nw, settings);
+			const Taps vertical = BuildTaps(h, nh, settings);
+
+			// horizontal pass: w x h -> nw x h
+			std::vector<float> wide((std::size_t)nw * h * 4);
+			ForEachRow(pool, h, [&](std::size_t y) {
+				thread_local std::vector<float> scratch;
+				const float* src = loadRow((int)y, w, scratch);
+				float* dst = wide.data() + y * nw * 4;
+				for (int x = 0; x < nw; ++x) {
+					alignas(16) float acc[4] = {};
+					for (int k = 0; k < horizontal.width; ++k) {
+						const std::size_t t = (std::size_t)x * horizontal.width + k;
+						MulAdd(acc, src + (std::size_t)horizontal.index[t] * 4, horizontal.weight[t]);
+					}
+					std::copy(acc, acc + 4, dst + x * 4);
+				}
+			});
+
+			// vertical pass: nw x h -> nw x nh
+			std::vector<float> level((std::size_t)nw * nh * 4);
+			ForEachRow(pool, nh, [&](std::size_t y) {
+				float* dst = level.data() + y * nw * 4;
+				for (int k = 0; k < vertical.width; ++k) {
+					const std::size_t t = y * vertical.width + k;
+					const float* src = wide.data() + (std::size_t)vertical.index[t] * nw * 4;
+					for (int x = 0; x < nw; ++x) {
+						MulAdd(dst + x * 4, src + x * 4, vertical.weight[t]);
+					}
+				}
+			});
+
+			// the sinc lobes overshoot, clamp before the level feeds the next one
+			for (auto& v : level) v = std::clamp(v, 0.0f, 1.0f);
+
+			// alpha tested texels thin out as alpha averages down, scaling alpha keeps the coverage of level 0
+			const float alphaScale = alphaTested ? FitCoverage(level, settings.alphaCutoff, targetCoverage) : 1.0f;
+
+			const std::size_t offset = chain.pixels.size();
+			const std::size_t size = (std::size_t)nw * nh * 4;
+			chain.pixels.resize(offset + size);
+			uchar* dst = chain.pixels.data() + offset;
+			for (std::size_t i = 0; i < (std::size_t)nw * nh; ++i) {
+				for (int ch = 0; ch < 3; ++ch) {
+					const float v = level[i * 4 + ch];
+					dst[i * 4 + ch] = settings.srgb
+						? tables.fromLinear[(std::size_t)std::lround(v * (tables.fromLinear.size() - 1))]
+						: (uchar)std::lround(v * 255.0f);
+				}
+				dst[i * 4 + 3] = (uchar)std::lround(std::min(level[i * 4 + 3] * alphaScale, 1.0f) * 255.0f);
+			}
+			chain.levels.push_back({ nw, nh, offset, size });
+
+			above = std::move(level);
+			w = nw;
+			h = nh;
+		}
+		return chain;
+	}
+
+} // Resource::Mips
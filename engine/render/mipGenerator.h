@@ -0,0 +1,20 @@
+#pragma once
+
+#include "render/texture.h"
+#include "util/threadPool.h"
+
+namespace Resource {
+
+	// CPU mip chains for RGBA8 images. Every level is filtered from the one above it in float with a
+	// separable windowed sinc, rows of each pass are spread over the pool.
+	namespace Mips {
+
+		// full chain down to 1x1, level 0 is copied as is
+		ImageData Generate(const ImageData& rgba, const MipSettings& settings, Utils::ThreadPool* pool = nullptr);
+
+		// fraction of texels whose alpha passes the cutoff
+		float AlphaCoverage(const ImageData& rgba, std::size_t level, float cutoff);
+
+	} // Mips
+
+} // Resource
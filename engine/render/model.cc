@@ -1,51 +1,286 @@
 #include "config.h"
 #include "model.h"
 
+#include <cfloat>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <map>
+
+#include "bcEncoder.h"
+#include "channelPacker.h"
+#include "glState.h"
+#include "renderQueue.h"
+#include "textureArray.h"
+#include "textureContainer.h"
+#include "textureStreamer.h"
+#include "virtualTexture.h"
 
 #include "fx/gltf.h"
 
 namespace Resource {
 
-	void Model::Mesh::Primitive::Draw(const Render::Camera& cam, const Math::mat4& transform) const {
-		const auto& mat = material.lock();
-		const auto& s = mat->GetShader().lock();
+	using Clock = std::chrono::steady_clock;
+
+	static float64 MsSince(Clock::time_point start) {
+		return std::chrono::duration<float64, std::milli>(Clock::now() - start).count();
+	}
+
+	static const uchar* AccessorElement(const fx::gltf::Document& doc, const fx::gltf::Accessor& accessor,
+		std::size_t elementSize, std::size_t i) {
+		const auto& view = doc.bufferViews[accessor.bufferView];
+		const std::size_t stride = view.byteStride != 0 ? view.byteStride : elementSize;
+		return doc.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset + i * stride;
+	}
+
+	static uint32 IndexElement(const fx::gltf::Document& doc, const fx::gltf::Accessor& accessor, std::size_t i) {
+		switch (accessor.componentType) {
+		case fx::gltf::Accessor::ComponentType::UnsignedByte:
+			return *AccessorElement(doc, accessor, 1, i);
+		case fx::gltf::Accessor::ComponentType::UnsignedShort: {
+			uint16 v;
+			std::memcpy(&v, AccessorElement(doc, accessor, 2, i), 2);
+			return v;
+		}
+		default: {
+			uint32 v;
+			std::memcpy(&v, AccessorElement(doc, accessor, 4, i), 4);
+			return v;
+		}
+		}
+	}
+
+	// bounds from the position accessor's min/max, UV density from the summed triangle areas in both spaces
+	static void MeasurePrimitive(const fx::gltf::Document& doc, const fx::gltf::Primitive& group, Model::Mesh::Primitive& p) {
+		const auto position = group.attributes.find("POSITION");
+		if (position == group.attributes.end()) {
+			return;
+		}
+
+		const auto& positions = doc.accessors[position->second];
+		if (positions.min.size() == 3 && positions.max.size() == 3) {
+			const Math::vec3 mn{ positions.min[0], positions.min[1], positions.min[2] };
+			const Math::vec3 mx{ positions.max[0], positions.max[1], positions.max[2] };
+			p.center = (mn + mx) * 0.5f;
+			p.radius = Math::length(mx - mn) * 0.5f;
+		}
+		// without UVs to measure, one UV unit spans the primitive
+		p.uvDensity = 1.0f / std::max(2.0f * p.radius, 1e-3f);
+
+		const auto texcoord = group.attributes.find("TEXCOORD_0");
+		if (texcoord == group.attributes.end() || group.indices < 0 || group.mode != fx::gltf::Primitive::Mode::Triangles) {
+			return;
+		}
+		const auto& uvs = doc.accessors[texcoord->second];
+		if (uvs.componentType != fx::gltf::Accessor::ComponentType::Float
+			|| positions.componentType != fx::gltf::Accessor::ComponentType::Float) {
+			return;
+		}
+
+		const auto& indices = doc.accessors[group.indices];
+		float64 worldArea = 0.0;
+		float64 uvArea = 0.0;
+		for (std::size_t t = 0; t + 2 < indices.count; t += 3) {
+			Math::vec3 v[3];
+			float uv[3][2];
+			for (int k = 0; k < 3; ++k) {
+				const auto index = IndexElement(doc, indices, t + k);
+				std::memcpy(&v[k].x, AccessorElement(doc, positions, 12, index), 12);
+				std::memcpy(uv[k], AccessorElement(doc, uvs, 8, index), 8);
+			}
+			worldArea += 0.5 * Math::length(Math::cross(v[1] - v[0], v[2] - v[0]));
+			uvArea += 0.5 * std::abs((uv[1][0] - uv[0][0]) * (uv[2][1] - uv[0][1]) - (uv[2][0] - uv[0][0]) * (uv[1][1] - uv[0][1]));
+		}
+		if (worldArea > 0.0 && uvArea > 0.0) {
+			p.uvDensity = (float)std::sqrt(uvArea / worldArea);
+		}
+	}
+
+	// paged when the image allows it, mip streamed or fully uploaded otherwise
+	static void PlaceTexture(const std::shared_ptr<Texture>& texture, std::shared_ptr<const ImageData> image, StagingRing* staging) {
+		if (VirtualTextureSystem::Get().Register(texture, image, staging)) return;
+		if (TextureStreamer::Get().Register(texture, image, staging)) return;
+		texture->Upload(*image, staging);
+	}
+
+	// what a pack input would take on the GPU uploaded on its own, in the format the compressed cache
+	// picks for opaque data
+	static std::size_t EstimateBytes(const ModelData::TextureSource& src) {
+		const auto compression = TextureCache::Get().GetCompression();
+		const auto format = !compression.enabled ? PixelFormat::RGBA8
+			: compression.quality == BCQuality::High ? PixelFormat::BC7 : PixelFormat::BC1;
 
-		s->Use();
+		if (src.width <= 0 || src.height <= 0) {
+			return 0;
+		}
+		std::size_t bytes = 0;
+		for (int w = src.width, h = src.height;; w = std::max(w >> 1, 1), h = std::max(h >> 1, 1)) {
+			bytes += TextureContainer::LevelSize(format, w, h);
+			if (w == 1 && h == 1) break;
+		}
+		return bytes;
+	}
 
-		glBindVertexArray(vao);
+	// level 0 as RGBA8, whatever the source is stored as
+	static ImageData DecodeInput(const ModelData& data, int i) {
+		if (i < 0) {
+			return {};
+		}
+		auto image = Texture::Decode(data.textures[i].encoded);
+		if (image.IsValid() && image.format != PixelFormat::RGBA8) {
+			image = BCn::Decompress(image);
+		}
+		return image;
+	}
 
-		auto normMat = dynamic_cast<NormalMapMaterial*>(mat.get());
-		if (normMat) {
-			normMat->Use();
+	// counted before any decode starts, the decodes of the pending textures run in parallel
+	static void CountInputReaders(ModelData& data, const std::vector<std::size_t>& pending) {
+		data.inputReaders = std::make_unique<std::atomic<int>[]>(data.textures.size());
+		for (const auto i : pending) {
+			const auto& src = data.textures[i];
+			for (const int input : { src.normalSource, src.metallicRoughnessSource }) {
+				if (src.packed && input >= 0) data.inputReaders[input]++;
+			}
+			if (src.packInput) data.inputReaders[i]++;
+		}
+		// inputs whose readers all came from the cache are done already
+		for (std::size_t i = 0; i < data.textures.size(); ++i) {
+			if (data.textures[i].packInput && data.inputReaders[i] == 0) data.textures[i].encoded = {};
+		}
+	}
+
+	// a pack input nothing samples would otherwise hold its file bytes as long as the data lives
+	static void ReleaseInput(ModelData& data, int i) {
+		if (i >= 0 && data.inputReaders && --data.inputReaders[i] == 0) {
+			data.textures[i].encoded = {};
+		}
+	}
+
+	// surfaces are built from their inputs only when the compressed cache has no copy
+	static ImageData DecodeSource(ModelData& data, std::size_t i, Model::TextureTiming& timing) {
+		auto& src = data.textures[i];
+		const auto t = Clock::now();
+
+		ImageData image;
+		if (src.packed) {
+			image = TextureCache::Get().Decode([&] {
+				const auto normal = DecodeInput(data, src.normalSource);
+				const auto metallicRoughness = DecodeInput(data, src.metallicRoughnessSource);
+				return Channels::PackSurface(normal.IsValid() ? &normal : nullptr,
+					metallicRoughness.IsValid() ? &metallicRoughness : nullptr);
+			}, src.contentHash, src.mips);
+			ReleaseInput(data, src.normalSource);
+			ReleaseInput(data, src.metallicRoughnessSource);
 		}
 		else {
-			mat->Use();
+			image = TextureCache::Get().Decode(src.encoded, src.contentHash, src.mips);
+			if (!src.packInput) src.encoded = {};
+			else ReleaseInput(data, (int)i);
 		}
 
-		const auto& mvp = cam.GetPerspective() * cam.GetView();
-		s->UploadUniformMat4fv("perspective", cam.GetPerspective());
-		s->UploadUniformMat4fv("view", cam.GetView());
-		s->UploadUniformMat4fv("transform", transform);
-		glDrawElements(mode, indices, indexType, (GLvoid*)offset);
+		timing.width = image.width;
+		timing.height = image.height;
+		if (!src.packInput) timing.bytes = image.pixels.size();
+		timing.decodeMs = MsSince(t);
+		return image;
+	}
 
-		
-		glBindVertexArray(0);
+	Model::Model(const std::filesystem::path& filepath, const ShaderManager& sm, Utils::ThreadPool* pool) {
+		ModelData data;
+		if (!ReadData(filepath, data)) {
+			return;
+		}
 
-		s->UnUse();
+		const auto pending = Upload(data, sm);
+		LoadTextures(data, pending, pool);
 	}
 
-	Model::Model(const std::filesystem::path& filepath, const ShaderManager& sm) {
+	bool Model::ReadData(const std::filesystem::path& filepath, ModelData& data) {
 		if (!std::filesystem::exists(filepath)) {
 			std::cerr << "[ERROR] trying to access non-existing file: " << filepath << '\n';
-			return;
+			return false;
 		}
 
-		auto doc = fx::gltf::LoadFromText(filepath);
+		data.path = filepath;
+		data.doc = fx::gltf::LoadFromText(filepath);
+
+		data.textures.resize(data.doc.textures.size());
+		for (std::size_t i = 0; i < data.textures.size(); ++i) {
+			auto& src = data.textures[i];
+			src.path = TextureCache::Canonical(Texture::PathFromGLTF(filepath.parent_path(), data.doc, i));
+			if (TextureCache::ReadFile(src.path, src.encoded)) {
+				src.contentHash = TextureCache::HashContents(src.encoded);
+				Texture::ReadSize(src.encoded, src.width, src.height);
+			}
+		}
+
+		// glTF color textures are sRGB encoded, the rest hold data; the G-buffer shaders discard below 0.5 alpha
+		for (const auto& mat : data.doc.materials) {
+			const auto baseColor = mat.pbrMetallicRoughness.baseColorTexture.index;
+			if (baseColor >= 0 && baseColor < (int32)data.textures.size()) {
+				auto& mips = data.textures[baseColor].mips;
+				mips.srgb = true;
+				mips.alphaCutoff = mat.alphaMode == fx::gltf::Material::AlphaMode::Mask ? mat.alphaCutoff : 0.5f;
+			}
+			const auto emissive = mat.emissiveTexture.index;
+			if (emissive >= 0 && emissive < (int32)data.textures.size()) {
+				data.textures[emissive].mips.srgb = true;
+			}
+		}
+
+		// the normal and metallicRoughness maps of a material become one surface texture, shared by
+		// every material with the same pair; inputs nothing samples directly are not uploaded
+		const auto count = (int32)data.textures.size();
+		const auto valid = [count](int32 index) { return index >= 0 && index < count ? index : -1; };
+		std::vector<bool> sampled(count, false);
+		std::map<std::pair<int, int>, int> surfaces;
+		data.surfaces.assign(data.doc.materials.size(), -1);
+		for (std::size_t m = 0; m < data.doc.materials.size(); ++m) {
+			const auto& mat = data.doc.materials[m];
+			for (const auto index : { mat.pbrMetallicRoughness.baseColorTexture.index, mat.emissiveTexture.index, mat.occlusionTexture.index }) {
+				if (valid(index) >= 0) sampled[index] = true;
+			}
+
+			const int normal = valid(mat.normalTexture.index);
+			const int metallicRoughness = valid(mat.pbrMetallicRoughness.metallicRoughnessTexture.index);
+			if (normal < 0 && metallicRoughness < 0) continue;
+
+			const auto [it, isNew] = surfaces.try_emplace({ normal, metallicRoughness }, (int)data.textures.size());
+			data.surfaces[m] = it->second;
+			if (!isNew) continue;
+
+			ModelData::TextureSource surface;
+			surface.packed = true;
+			surface.normalSource = normal;
+			surface.metallicRoughnessSource = metallicRoughness;
+			const auto name = [&](int i) { return i >= 0 ? data.textures[i].path.filename().string() : std::string("none"); };
+			surface.path = data.textures[normal >= 0 ? normal : metallicRoughness].path.parent_path()
+				/ (name(normal) + '+' + name(metallicRoughness) + ".surface");
+			surface.contentHash = Channels::SurfaceHash(normal >= 0 ? data.textures[normal].contentHash : 0,
+				metallicRoughness >= 0 ? data.textures[metallicRoughness].contentHash : 0);
+			for (const auto i : { normal, metallicRoughness }) {
+				if (i < 0) continue;
+				data.textures[i].packInput = true;
+				surface.width = std::max(surface.width, data.textures[i].width);
+				surface.height = std::max(surface.height, data.textures[i].height);
+			}
+			data.textures.push_back(std::move(surface));
+		}
+		for (int32 i = 0; i < count; ++i) {
+			data.textures[i].sampled = sampled[i] || !data.textures[i].packInput;
+		}
+		return true;
+	}
+
+	std::vector<std::size_t> Model::Upload(const ModelData& data, const ShaderManager& sm) {
+		const auto& doc = data.doc;
 		buffers.resize(doc.bufferViews.size());
 		for (std::size_t i = 0; i < buffers.size(); ++i)
 			glGenBuffers(1, &buffers[i].handle);
 
+		// binding the index buffers below would change whichever vertex array was drawn last
+		Render::GLState::Get().BindVertexArray(0);
+
 		std::size_t i = 0;
 		for (const auto& buf : doc.bufferViews) {
 			GLenum target;
@@ -67,65 +302,83 @@ namespace Resource {
 			
 			buffers[i].target = target;
 			glBindBuffer(target, buffers[i].handle);
-			const auto dataPtr = reinterpret_cast<GLbyte*>(doc.buffers[buf.buffer].data.data()) + buf.byteOffset;
+			const auto dataPtr = reinterpret_cast<const GLbyte*>(doc.buffers[buf.buffer].data.data()) + buf.byteOffset;
 			glBufferData(target, buf.byteLength, dataPtr, GL_STATIC_DRAW);
 			i++;
 		}
 
-		i = 0;
-		for (const auto& tex : doc.textures) {
-			textures.push_back(std::make_shared<Texture>(filepath.parent_path(), doc, i));
-			i++;
+		auto& cache = TextureCache::Get();
+		std::vector<std::size_t> pending;
+		textureTimings.resize(data.textures.size());
+		for (std::size_t t = 0; t < data.textures.size(); ++t) {
+			const auto& src = data.textures[t];
+			auto& timing = textureTimings[t];
+			timing.path = src.path;
+			timing.width = src.width;
+			timing.height = src.height;
+			timing.packInput = src.packInput;
+			timing.surface = src.packed;
+			if (src.packInput) {
+				timing.bytes = EstimateBytes(src);
+			}
+			if (!src.sampled) {
+				textures.push_back(nullptr);
+				continue;
+			}
+
+			// a surface samples like the normal map it carries
+			const int prototype = !src.packed ? (int)t : src.normalSource >= 0 ? src.normalSource : src.metallicRoughnessSource;
+			bool isNew;
+			textures.push_back(cache.Acquire(src.path, src.contentHash, Texture(doc, prototype), 0, src.mips, isNew));
+			timing.shared = !isNew;
+			if (isNew) {
+				pending.push_back(t);
+			}
 		}
-		dummyTexture = std::make_shared<Texture>(Texture::DummyTexture());
+		dummyTexture = cache.White();
 
-		for (const auto& mat : doc.materials) {
-			if (mat.normalTexture.empty()) {
-				Material m;
-				m.SetAmbient(mat.pbrMetallicRoughness.baseColorFactor);
-				m.SetRoughness(mat.pbrMetallicRoughness.roughnessFactor);
-				m.SetShininess(mat.pbrMetallicRoughness.metallicFactor);
-				if (mat.pbrMetallicRoughness.baseColorTexture.empty()) {
-					m.SetDiffuseTex(dummyTexture);
-				}
-				else {
-					m.SetDiffuseTex(textures[mat.pbrMetallicRoughness.baseColorTexture.index]);
-				}
-				if (mat.pbrMetallicRoughness.metallicRoughnessTexture.empty()) {
-					m.SetSpecTex(dummyTexture);
-				}
-				else {
-					m.SetSpecTex(textures[mat.pbrMetallicRoughness.metallicRoughnessTexture.index]);
-				}
-				m.SetShader(sm.Get("gPass"));
-				materials.push_back(std::make_shared<Material>(m));
+		for (std::size_t m = 0; m < doc.materials.size(); ++m) {
+			const auto& mat = doc.materials[m];
+			const bool normalMapped = !mat.normalTexture.empty();
+
+			std::shared_ptr<Material> material;
+			if (VirtualTextureSystem::Get().IsEnabled()) {
+				material = std::make_shared<VirtualMaterial>();
+				material->SetShader(sm.Get("gVirtualPass"));
+			}
+			else if (TextureArrayPacker::Get().IsEnabled()) {
+				material = std::make_shared<ArrayMaterial>();
+				material->SetShader(sm.Get("gArrayPass"));
 			}
 			else {
-				NormalMapMaterial m;
-				m.SetAmbient(mat.pbrMetallicRoughness.baseColorFactor);
-				m.SetRoughness(mat.pbrMetallicRoughness.roughnessFactor);
-				m.SetShininess(mat.pbrMetallicRoughness.metallicFactor);
-				if (mat.pbrMetallicRoughness.baseColorTexture.empty()) {
-					m.SetDiffuseTex(dummyTexture);
-				}
-				else {
-					m.SetDiffuseTex(textures[mat.pbrMetallicRoughness.baseColorTexture.index]);
-				}
-				if (mat.pbrMetallicRoughness.metallicRoughnessTexture.empty()) {
-					m.SetSpecTex(dummyTexture);
-				}
-				else {
-					m.SetSpecTex(textures[mat.pbrMetallicRoughness.metallicRoughnessTexture.index]);
-				}
-				if (mat.normalTexture.empty()) {
-					m.SetNormTex(dummyTexture);
-				}
-				else {
-					m.SetNormTex(textures[mat.normalTexture.index]);
-				}
-				m.SetShader(sm.Get("gNormPass"));
-				materials.push_back(std::make_shared<NormalMapMaterial>(m));
+				material = std::make_shared<Material>();
+				material->SetShader(normalMapped ? sm.Get("gNormPass") : sm.Get("gPass"));
+			}
+
+			material->SetNormalMapped(normalMapped);
+			material->SetAmbient(mat.pbrMetallicRoughness.baseColorFactor);
+			material->SetRoughness(mat.pbrMetallicRoughness.roughnessFactor);
+			material->SetShininess(mat.pbrMetallicRoughness.metallicFactor);
+			if (mat.pbrMetallicRoughness.baseColorTexture.empty()) {
+				material->SetDiffuseTex(dummyTexture);
+			}
+			else {
+				material->SetDiffuseTex(textures[mat.pbrMetallicRoughness.baseColorTexture.index]);
+			}
+			if (data.surfaces[m] < 0) {
+				material->SetSurfaceTex(dummyTexture);
+			}
+			else {
+				material->SetSurfaceTex(textures[data.surfaces[m]]);
 			}
+			materials.push_back(material);
+
+			// the G-buffer shaders used to fetch diffuse twice, metallicRoughness and the normal map
+			packing.materials++;
+			packing.fetchesBefore += normalMapped ? 4 : 3;
+			packing.fetchesAfter += 2;
+			packing.bindsBefore += normalMapped ? 3 : 2;
+			packing.bindsAfter += 2;
 		}
 
 		for (const auto& mesh : doc.meshes) {
@@ -133,7 +386,7 @@ namespace Resource {
 			for (const auto& group : mesh.primitives) {
 				Mesh::Primitive p;
 				glGenVertexArrays(1, &p.vao);
-				glBindVertexArray(p.vao);
+				Render::GLState::Get().BindVertexArray(p.vao);
 				for (const auto& [attribute, acc_idx] : group.attributes) {
 					const auto accessor = doc.accessors[acc_idx];
 					glBindBuffer(buffers[accessor.bufferView].target, buffers[accessor.bufferView].handle);
@@ -175,41 +428,166 @@ namespace Resource {
 				p.mode = (GLenum)group.mode;
 				p.indexType = (GLenum)accessor.componentType;
 				p.material = materials[group.material];
+
+				MeasurePrimitive(doc, group, p);
+				const auto& mat = doc.materials[group.material];
+				for (const auto index : { mat.pbrMetallicRoughness.baseColorTexture.index, data.surfaces[group.material] }) {
+					if (index >= 0) p.textureSlots.push_back(index);
+				}
 				m.groups.push_back(p);
 
 				glBindBuffer(buffers[bv].target, buffers[bv].handle);
 
-				glBindVertexArray(0);
+				Render::GLState::Get().BindVertexArray(0);
 			}
 			meshes.push_back(m);
 		}
+
+		return pending;
 	}
 
 	void Model::UnLoad() {
 		for (auto& mesh : meshes) {
 			for (auto& group : mesh.groups) {
+				Render::GLState::Get().ForgetVertexArray(group.vao);
 				glDeleteVertexArrays(1, &group.vao);
 			}
 		}
 
-		for (auto& tex : textures) {
-			tex->Unload();
-			tex.reset();
-		}
+		// textures are shared through the cache, it unloads the ones no other model still holds
+		textures.clear();
+		dummyTexture.reset();
+		TextureCache::Get().Collect();
 
 		for (auto& buf : buffers) {
 			glDeleteBuffers(1, &buf.handle);
 		}
 	}
 
-	void Model::Draw(const Render::Camera& cam, const Math::mat4& t) const {
+	void Model::Enqueue(Render::RenderQueue& queue, const Render::Camera& cam, std::span<const Math::mat4> transforms) const {
+		if (transforms.empty()) {
+			return;
+		}
+
+		const uint32 first = queue.PushInstances(transforms);
+		std::vector<Math::mat4> modelViews;
+		modelViews.reserve(transforms.size());
+		for (const auto& t : transforms) {
+			modelViews.push_back(cam.GetView() * t);
+		}
+
 		for (const auto& mesh : meshes) {
 			for (const auto& group : mesh.groups) {
-				group.Draw(cam, t);
+				const Math::vec4 center{ group.center.x, group.center.y, group.center.z, 1.0f };
+				// the camera looks down -z
+				float depth = FLT_MAX;
+				for (const auto& modelView : modelViews) {
+					depth = std::min(depth, -(modelView * center).z);
+				}
+				queue.Push(Render::RenderPass::Geometry, group, first, (uint32)transforms.size(), depth);
 			}
 		}
 	}
 
+	void Model::RequestMips(const Render::Camera& cam, std::span<const Math::mat4> transforms, float viewportHeight) const {
+		auto& streamer = TextureStreamer::Get();
+		if (!streamer.IsEnabled() || transforms.empty()) {
+			return;
+		}
+
+		// world units a pixel covers at distance 1, and the largest scale of each transform
+		const float pixelSpread = 2.0f / (cam.GetPerspective()[1][1] * viewportHeight);
+		std::vector<float> scales;
+		scales.reserve(transforms.size());
+		for (const auto& t : transforms) {
+			float scale = 0.0f;
+			for (std::size_t c = 0; c < 3; ++c) {
+				scale = std::max(scale, Math::length(Math::vec3{ t[c][0], t[c][1], t[c][2] }));
+			}
+			scales.push_back(scale);
+		}
+
+		for (const auto& mesh : meshes) {
+			for (const auto& group : mesh.groups) {
+				// the instance that needs the most detail decides, one request per texture for all of them
+				float nearest = FLT_MAX;
+				for (std::size_t i = 0; i < transforms.size(); ++i) {
+					const auto center = transforms[i] * Math::vec4{ group.center.x, group.center.y, group.center.z, 1.0f };
+					const float distance = std::max(
+						Math::length(Math::vec3{ center.x, center.y, center.z } - cam.GetCameraPos()) - group.radius * scales[i], 1e-3f);
+					nearest = std::min(nearest, distance / scales[i]);
+				}
+
+				// texels per pixel at the nearest point of the bounds, its log2 is the finest mip sampled there
+				const float uvPerPixel = group.uvDensity * nearest * pixelSpread;
+				for (const auto slot : group.textureSlots) {
+					const auto& texture = textures[slot];
+					const float texels = (float)std::max(texture->GetWidth(), texture->GetHeight());
+					streamer.Request(texture.get(), std::max(std::log2(texels * uvPerPixel), 0.0f));
+				}
+			}
+		}
+	}
+
+	void Model::PrintTextureTimings(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+		float64 decodeMs = 0.0;
+		float64 uploadMs = 0.0;
+		std::size_t inputBytes = 0;
+		std::size_t surfaceBytes = 0;
+		for (const auto& t : textureTimings) {
+			out << "  " << std::setw(40) << std::left << t.path.filename().string() << std::right
+				<< std::setw(6) << t.width << 'x' << std::setw(5) << std::left << t.height << std::right
+				<< " decode " << std::setw(8) << std::fixed << std::setprecision(2) << t.decodeMs << " ms"
+				<< "  upload " << std::setw(7) << t.uploadMs << " ms" << (t.shared ? "  (shared)" : "")
+				<< (t.packInput ? "  (packed)" : "") << '\n';
+			decodeMs += t.decodeMs;
+			uploadMs += t.uploadMs;
+			if (t.packInput) inputBytes += t.bytes;
+			if (t.surface) surfaceBytes += t.bytes;
+		}
+		out << "  " << textureTimings.size() << " textures, decode " << decodeMs << " ms, upload "
+			<< uploadMs << " ms, wall " << textureLoadMs << " ms\n";
+
+		constexpr float64 MiB = 1024.0 * 1024.0;
+		out << std::setprecision(1) << "  channel packing: " << packing.materials << " materials, fetches "
+			<< packing.fetchesBefore << " -> " << packing.fetchesAfter << ", binds " << packing.bindsBefore
+			<< " -> " << packing.bindsAfter << ", normal and metallicRoughness maps " << inputBytes / MiB
+			<< " MiB -> surfaces " << surfaceBytes / MiB << " MiB\n";
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	void Model::LoadTextures(ModelData& data, const std::vector<std::size_t>& pending, Utils::ThreadPool* pool) {
+		const auto start = Clock::now();
+
+		CountInputReaders(data, pending);
+		std::vector<ImageData> images(pending.size());
+		auto decode = [&](std::size_t p) {
+			const auto i = pending[p];
+			images[p] = DecodeSource(data, i, textureTimings[i]);
+		};
+
+		if (pool) {
+			pool->ParallelFor(images.size(), decode);
+		}
+		else {
+			for (std::size_t p = 0; p < images.size(); ++p) decode(p);
+		}
+
+		for (std::size_t p = 0; p < images.size(); ++p) {
+			const auto i = pending[p];
+			const auto t = Clock::now();
+			auto image = std::make_shared<const ImageData>(std::move(images[p]));
+			PlaceTexture(textures[i], std::move(image), nullptr);
+			textureTimings[i].uploadMs = MsSince(t);
+		}
+		TextureArrayPacker::Get().Pack(textures);
+
+		textureLoadMs = MsSince(start);
+	}
+
 	GLuint Model::SlotFromGLTF(const std::string& attribute) const {
 		if (attribute == "POSITION") return 0;
 		if (attribute == "NORMAL") return 1;
@@ -219,4 +597,50 @@ namespace Resource {
 		return -1;
 	}
 
+	Utils::Task<std::shared_ptr<Model>> AsyncLoadModel(std::filesystem::path filepath, const ShaderManager& sm,
+		Utils::ThreadPool& pool, UploadQueue& queue) {
+		auto data = std::make_shared<ModelData>();
+
+		co_await pool.Schedule();
+		const bool ok = Model::ReadData(filepath, *data);
+
+		co_await queue.Schedule();
+		if (!ok) {
+			co_return nullptr;
+		}
+
+		auto model = std::make_shared<Model>();
+		const auto pending = model->Upload(*data, sm);
+		if (pending.empty()) {
+			TextureArrayPacker::Get().Pack(model->textures);
+		}
+
+		// each job only writes its own timing slot, the last upload to land prints the report
+		const auto start = Clock::now();
+		CountInputReaders(*data, pending);
+		auto remaining = std::make_shared<std::atomic<std::size_t>>(pending.size());
+		for (const auto i : pending) {
+			pool.Submit([model, data, i, start, remaining, name = filepath.filename(), &queue] {
+				auto image = std::make_shared<ImageData>(DecodeSource(*data, i, model->textureTimings[i]));
+
+				const auto bytes = image->pixels.size();
+				queue.Push([model, i, start, remaining, name, image, &queue] {
+					auto t = Clock::now();
+					PlaceTexture(model->textures[i], image, &queue.Staging());
+					model->textureTimings[i].uploadMs = MsSince(t);
+
+					if (--(*remaining) == 0) {
+						// every texture of the model is in, those sharing format and size move into arrays
+						TextureArrayPacker::Get().Pack(model->textures);
+						model->textureLoadMs = MsSince(start);
+						std::cout << "[INFO] loaded textures for " << name << '\n';
+						model->PrintTextureTimings(std::cout);
+					}
+				}, bytes);
+			});
+		}
+
+		co_return model;
+	}
+
 } // Resource
\ No newline at end of file
@@ -1,17 +1,57 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <span>
 #include <vector>
 
 #include "camera.h"
 #include "material.h"
 #include "shader.h"
 #include "texture.h"
+#include "uploadQueue.h"
 
 #include "fx/gltf.h"
 #include "GL/glew.h"
+#include "util/task.h"
+#include "util/threadPool.h"
+
+namespace Render {
+	class RenderQueue;
+}
 
 namespace Resource {
 
+	// everything needed to build a Model that can be produced without a GL context
+	struct ModelData {
+		// the document's textures by index, followed by the surface textures packed from them
+		struct TextureSource {
+			std::filesystem::path path;
+			uint64 contentHash = 0;
+			std::vector<uchar> encoded;
+			MipSettings mips;
+			int width = 0;
+			int height = 0;
+			// a surface built by Channels::PackSurface from these sources, -1 when one is missing
+			bool packed = false;
+			int normalSource = -1;
+			int metallicRoughnessSource = -1;
+			// read by a surface, its encoded bytes stay until every surface reading it is built
+			bool packInput = false;
+			// a shader samples the texture itself, inputs only read for packing get no GL texture
+			bool sampled = true;
+		};
+
+		std::filesystem::path path;
+		fx::gltf::Document doc;
+		std::vector<TextureSource> textures;
+		// per material the texture index of its surface texture, -1 when it has neither input
+		std::vector<int> surfaces;
+		// per texture, the pending decodes still reading a pack input's encoded bytes; the last frees them
+		std::unique_ptr<std::atomic<int>[]> inputReaders;
+	};
+
 	struct Model {
 		struct Mesh {
 			struct Primitive {
@@ -21,8 +61,11 @@ namespace Resource {
 				GLenum indexType;
 				GLenum mode;
 				std::weak_ptr<Material> material;
-
-				void Draw(const Render::Camera& cam, const Math::mat4& transform) const;
+				// model space bounds and UV units per model unit, for the mips a draw needs
+				Math::vec3 center;
+				float radius = 0.0f;
+				float uvDensity = 0.0f;
+				std::vector<std::size_t> textureSlots;
 			};
 
 			std::vector<Primitive> groups;
@@ -33,21 +76,68 @@ namespace Resource {
 			GLuint handle;
 		};
 
+		struct TextureTiming {
+			std::filesystem::path path;
+			int width = 0;
+			int height = 0;
+			float64 decodeMs = 0.0;
+			float64 uploadMs = 0.0;
+			bool shared = false;
+			bool packInput = false;
+			bool surface = false;
+			// GPU bytes with the mip chain, estimated for pack inputs as if they were uploaded
+			std::size_t bytes = 0;
+		};
+
+		// texture fetches per pixel and binds per draw of all materials, as separate maps and channel packed
+		struct PackingCounts {
+			std::size_t materials = 0;
+			std::size_t fetchesBefore = 0;
+			std::size_t fetchesAfter = 0;
+			std::size_t bindsBefore = 0;
+			std::size_t bindsAfter = 0;
+		};
+
 		std::vector<Mesh> meshes;
 		std::shared_ptr<Texture> dummyTexture;
 		std::vector<std::shared_ptr<Texture>> textures;
 		std::vector<std::shared_ptr<Material>> materials;
 		std::vector<Buffer> buffers;
 
+		std::vector<TextureTiming> textureTimings;
+		PackingCounts packing;
+		float64 textureLoadMs = 0.0;
+
 		Model() = default;
-		Model(const std::filesystem::path& filepath, const ShaderManager& sm);
+		// with a pool every texture decodes in parallel before they are uploaded back to back
+		Model(const std::filesystem::path& filepath, const ShaderManager& sm, Utils::ThreadPool* pool = nullptr);
+
+		// parses the document and reads and hashes every referenced image
+		static bool ReadData(const std::filesystem::path& filepath, ModelData& data);
+		// creates buffers, vertex arrays and materials and takes textures from the TextureCache,
+		// returns the texture indices the cache did not have yet, their pixels are left for the caller;
+		// texture indices follow data.textures, unsampled pack inputs hold nullptr
+		std::vector<std::size_t> Upload(const ModelData& data, const ShaderManager& sm);
 
 		void UnLoad();
 
-		void Draw(const Render::Camera& cam, const Math::mat4& t) const;
+		void PrintTextureTimings(std::ostream& out) const;
+
+		// adds the instances and a geometry pass packet per primitive drawing all of them, keyed by
+		// the depth in view of the nearest one
+		void Enqueue(Render::RenderQueue& queue, const Render::Camera& cam, std::span<const Math::mat4> transforms) const;
+		// tells the TextureStreamer how much detail every texture of the model needs for the
+		// instance closest to the camera
+		void RequestMips(const Render::Camera& cam, std::span<const Math::mat4> transforms, float viewportHeight) const;
 
 	private:
+		void LoadTextures(ModelData& data, const std::vector<std::size_t>& pending, Utils::ThreadPool* pool);
 		GLuint SlotFromGLTF(const std::string& attribute) const;
 	};
 
+	// Parses the document on the pool, uploads the geometry on the render thread and returns;
+	// textures decode on the pool and stream in through the queue, binding a placeholder until then.
+	Utils::Task<std::shared_ptr<Model>> AsyncLoadModel(std::filesystem::path filepath, const ShaderManager& sm,
+		Utils::ThreadPool& pool, UploadQueue& queue);
+
 } // Resource
\ No newline at end of file
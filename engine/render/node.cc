@@ -7,8 +7,44 @@ namespace Resource {
 		: transform(Math::mat4::identity()), model(model) {
 	}
 
-	void GraphicsNode::Draw(const Render::Camera& cam) const {
-		model.lock()->Draw(cam, transform);
+	void GraphicsNode::Enqueue(Render::RenderQueue& queue, const Render::Camera& cam) const {
+		model.lock()->Enqueue(queue, cam, { &transform, 1 });
 	}
 
-} // Resource
\ No newline at end of file
+	void GraphicsNode::RequestMips(const Render::Camera& cam, float viewportHeight) const {
+		model.lock()->RequestMips(cam, { &transform, 1 }, viewportHeight);
+	}
+
+	void NodeBatches::Build(const std::vector<GraphicsNode>& nodes) {
+		Clear();
+		for (const auto& node : nodes) {
+			auto model = node.GetModel().lock();
+			if (!model) {
+				continue;
+			}
+			const auto [it, inserted] = byModel.try_emplace(model.get(), batches.size());
+			if (inserted) {
+				batches.push_back({ std::move(model), {} });
+			}
+			batches[it->second].transforms.push_back(node.transform);
+		}
+	}
+
+	void NodeBatches::Clear() {
+		batches.clear();
+		byModel.clear();
+	}
+
+	void NodeBatches::Enqueue(Render::RenderQueue& queue, const Render::Camera& cam) const {
+		for (const auto& batch : batches) {
+			batch.model->Enqueue(queue, cam, batch.transforms);
+		}
+	}
+
+	void NodeBatches::RequestMips(const Render::Camera& cam, float viewportHeight) const {
+		for (const auto& batch : batches) {
+			batch.model->RequestMips(cam, batch.transforms, viewportHeight);
+		}
+	}
+
+} // Resource
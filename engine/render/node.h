@@ -4,9 +4,15 @@
 #include "render/camera.h"
 
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "model.h"
 
+namespace Render {
+	class RenderQueue;
+}
+
 namespace Resource {
 
 	class GraphicsNode {
@@ -20,9 +26,35 @@ namespace Resource {
 		GraphicsNode() = default;
 		GraphicsNode(const std::shared_ptr<Model>& model);
 
-		void Draw(const Render::Camera& cam) const;
+		void Enqueue(Render::RenderQueue& queue, const Render::Camera& cam) const;
+		void RequestMips(const Render::Camera& cam, float viewportHeight) const;
+
+		const std::weak_ptr<Model>& GetModel() const { return model; }
+	};
+
+	// The nodes of a scene grouped by the model they draw, rebuilt every frame. Each model is
+	// enqueued once with the transforms of all its nodes, a draw per primitive whatever the node
+	// count, and asks for its mips once for the node closest to the camera.
+	class NodeBatches {
+		struct Batch {
+			// held until the next Build or Clear
+			std::shared_ptr<Model> model;
+			std::vector<Math::mat4> transforms;
+		};
+
+		std::vector<Batch> batches;
+		std::unordered_map<const Model*, std::size_t> byModel;
+
+	public:
+		void Build(const std::vector<GraphicsNode>& nodes);
+		void Clear();
+
+		void Enqueue(Render::RenderQueue& queue, const Render::Camera& cam) const;
+		void RequestMips(const Render::Camera& cam, float viewportHeight) const;
+
+		std::size_t GetBatchCount() const { return batches.size(); }
 	};
 
 	// TODO create a node manager
 
-} // Resource
\ No newline at end of file
+} // Resource
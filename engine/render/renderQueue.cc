@@ -0,0 +1,173 @@
+#include "config.h"
+#include "renderQueue.h"
+
+#include <bit>
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+
+#include "glState.h"
+
+namespace Render {
+
+	RenderQueue::~RenderQueue() {
+		if (instanceBuffer != 0) {
+			glDeleteBuffers(1, &instanceBuffer);
+			glDeleteBuffers(1, &drawBuffer);
+		}
+	}
+
+	void RenderQueue::Clear() {
+		keys.clear();
+		packets.clear();
+		instances.clear();
+	}
+
+	uint32 RenderQueue::PushInstances(std::span<const Math::mat4> transforms) {
+		const auto first = (uint32)instances.size();
+		instances.insert(instances.end(), transforms.begin(), transforms.end());
+		return first;
+	}
+
+	void RenderQueue::Push(RenderPass pass, const Resource::Model::Mesh::Primitive& primitive, uint32 firstInstance, uint32 instanceCount, float viewDepth) {
+		const auto material = primitive.material.lock();
+		const auto shader = material->GetShader().lock();
+		keys.push_back(MakeKey(pass, shader->GetHandle(), material->GetIndex(), primitive.vao, viewDepth));
+		packets.push_back({ &primitive, material.get(), shader.get(), firstInstance, instanceCount });
+	}
+
+	uint64 RenderQueue::MakeKey(RenderPass pass, uint32 shader, uint32 material, uint32 vertexArray, float viewDepth) {
+		// the bits of a positive float order like the float, the sign bit is always clear and dropped
+		const uint32 depth = std::bit_cast<uint32>(std::max(viewDepth, 0.0f)) >> (31 - depthBits);
+
+		uint64 key = (uint64)pass;
+		key = (key << shaderBits) | (shader & ((1u << shaderBits) - 1));
+		key = (key << materialBits) | (material & ((1u << materialBits) - 1));
+		key = (key << vertexArrayBits) | (vertexArray & ((1u << vertexArrayBits) - 1));
+		key = (key << depthBits) | (depth & ((1u << depthBits) - 1));
+		return key;
+	}
+
+	void RenderQueue::Sort() {
+		const auto start = std::chrono::steady_clock::now();
+
+		sortedKeys = keys;
+		RadixSort(sortedKeys, order, scratchKeys, scratchOrder);
+
+		const std::chrono::duration<float64, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		stats.sortMs = elapsed.count();
+		stats.totalSortMs += stats.sortMs;
+	}
+
+	void RenderQueue::RadixSort(std::vector<uint64>& keys, std::vector<uint32>& order, std::vector<uint64>& scratchKeys, std::vector<uint32>& scratchOrder) {
+		const std::size_t n = keys.size();
+		order.resize(n);
+		std::iota(order.begin(), order.end(), 0u);
+		scratchKeys.resize(n);
+		scratchOrder.resize(n);
+
+		// all eight histograms in one read of the keys
+		uint32 counts[8][256] = {};
+		for (const uint64 key : keys) {
+			for (int b = 0; b < 8; ++b) {
+				counts[b][(key >> (b * 8)) & 0xFF]++;
+			}
+		}
+
+		for (int b = 0; b < 8; ++b) {
+			const int shift = b * 8;
+			auto& count = counts[b];
+			// a byte every key shares moves nothing
+			if (n == 0 || count[(keys[0] >> shift) & 0xFF] == n) {
+				continue;
+			}
+
+			uint32 offset = 0;
+			for (auto& c : count) {
+				const uint32 size = c;
+				c = offset;
+				offset += size;
+			}
+			for (std::size_t i = 0; i < n; ++i) {
+				const uint32 dst = count[(keys[i] >> shift) & 0xFF]++;
+				scratchKeys[dst] = keys[i];
+				scratchOrder[dst] = order[i];
+			}
+			keys.swap(scratchKeys);
+			order.swap(scratchOrder);
+		}
+	}
+
+	void RenderQueue::Submit() {
+		if (instanceBuffer == 0) {
+			glCreateBuffers(1, &instanceBuffer);
+			glCreateBuffers(1, &drawBuffer);
+		}
+
+		// the draw records in submission order, so the i-th draw's base instance is i
+		draws.clear();
+		for (const uint32 index : order) {
+			const auto& packet = packets[index];
+			draws.push_back({ packet.firstInstance, packet.material->GetIndex() });
+		}
+		// orphaned every frame, the driver hands out fresh memory instead of waiting on last frame's draws
+		glNamedBufferData(instanceBuffer, instances.size() * sizeof(Math::mat4), instances.data(), GL_STREAM_DRAW);
+		glNamedBufferData(drawBuffer, draws.size() * sizeof(GpuDraw), draws.data(), GL_STREAM_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instanceBinding, instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, drawBinding, drawBuffer);
+
+		auto& state = GLState::Get();
+		const Resource::Shader* shader = nullptr;
+		const Resource::Material* material = nullptr;
+		GLuint vertexArray = 0;
+
+		stats.shaderChanges = 0;
+		stats.materialChanges = 0;
+		stats.vertexArrayChanges = 0;
+
+		for (uint32 draw = 0; draw < (uint32)order.size(); ++draw) {
+			const auto& packet = packets[order[draw]];
+			const auto& primitive = *packet.primitive;
+
+			// the material goes to each run of draws using it
+			if (packet.shader != shader) {
+				packet.shader->Use();
+				shader = packet.shader;
+				material = nullptr;
+				stats.shaderChanges++;
+			}
+			if (packet.material != material) {
+				packet.material->Use();
+				material = packet.material;
+				stats.materialChanges++;
+			}
+			if (primitive.vao != vertexArray) {
+				state.BindVertexArray(primitive.vao);
+				vertexArray = primitive.vao;
+				stats.vertexArrayChanges++;
+			}
+
+			glDrawElementsInstancedBaseInstance(primitive.mode, primitive.indices, primitive.indexType,
+				(GLvoid*)(uintptr_t)primitive.offset, packet.instanceCount, draw);
+		}
+
+		stats.frames++;
+		stats.packets = packets.size();
+		stats.instances = instances.size();
+	}
+
+	void RenderQueue::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		out << std::fixed << std::setprecision(3)
+			<< "  " << stats.packets << " draws of " << stats.instances << " instances, " << stats.shaderChanges << " shader, " << stats.materialChanges
+			<< " material and " << stats.vertexArrayChanges << " vertex array changes in the last frame\n"
+			<< "  radix sort " << (stats.frames > 0 ? stats.totalSortMs / stats.frames : 0.0)
+			<< " ms per frame over " << stats.frames << " frames\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Render
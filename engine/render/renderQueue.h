@@ -0,0 +1,113 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "render/model.h"
+
+namespace Render {
+
+	enum class RenderPass : uint8 {
+		Geometry = 0,
+	};
+
+	// Draw packets collected over a frame, sorted by a 64 bit key and submitted in one go. The key
+	// packs, from the top, the pass, the shader, the material, the vertex array and the view depth,
+	// so draws sharing state end up next to each other and each run of them is drawn front to back
+	// for early depth rejection. Keys only order; submission compares the actual shader, material and
+	// vertex array, so ids that collide in their bits cost a state change, never a wrong draw.
+	// A packet draws a run of instances: their transforms go to the GPU in one buffer a frame, and
+	// each draw finds its instances and material through a per draw record at its base instance.
+	class RenderQueue {
+	public:
+		// shader storage bindings, must match gVert.glsl and gNormVert.glsl
+		static constexpr GLuint instanceBinding = 6;
+		static constexpr GLuint drawBinding = 7;
+
+		static constexpr int passBits = 4;
+		static constexpr int shaderBits = 10;
+		static constexpr int materialBits = 16;
+		static constexpr int vertexArrayBits = 10;
+		static constexpr int depthBits = 24;
+		static_assert(passBits + shaderBits + materialBits + vertexArrayBits + depthBits == 64);
+
+		struct Packet {
+			const Resource::Model::Mesh::Primitive* primitive;
+			Resource::Material* material;
+			Resource::Shader* shader;
+			// a range of the queue's instances
+			uint32 firstInstance;
+			uint32 instanceCount;
+		};
+
+		// what a draw's base instance points the vertex shaders at, std430
+		struct GpuDraw {
+			uint32 firstInstance;
+			uint32 material;
+		};
+
+		struct Stats {
+			std::size_t frames = 0;
+			std::size_t packets = 0;
+			std::size_t instances = 0;
+			// in the last frame, how often submission had to switch
+			std::size_t shaderChanges = 0;
+			std::size_t materialChanges = 0;
+			std::size_t vertexArrayChanges = 0;
+			float64 sortMs = 0.0;
+			float64 totalSortMs = 0.0;
+		};
+
+	private:
+		std::vector<uint64> keys;
+		std::vector<Packet> packets;
+		std::vector<Math::mat4> instances;
+		std::vector<GpuDraw> draws;
+		// the keys in sorted order and the packet each belongs to, and the radix sort's scratch buffers
+		std::vector<uint64> sortedKeys;
+		std::vector<uint32> order;
+		std::vector<uint64> scratchKeys;
+		std::vector<uint32> scratchOrder;
+
+		GLuint instanceBuffer = 0;
+		GLuint drawBuffer = 0;
+
+		Stats stats;
+
+	public:
+		RenderQueue() = default;
+		~RenderQueue();
+
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+
+		void Clear();
+		// the transforms of a run of instances, returns the first one's index for Push
+		uint32 PushInstances(std::span<const Math::mat4> transforms);
+		// the primitive and its material must outlive Submit
+		void Push(RenderPass pass, const Resource::Model::Mesh::Primitive& primitive, uint32 firstInstance, uint32 instanceCount, float viewDepth);
+
+		// orders the packets by key, least significant byte first, skipping bytes all keys share
+		void Sort();
+		// uploads the instances and draws the packets in sorted order, one instanced draw each; the
+		// camera comes from the bound FrameUniforms
+		void Submit();
+
+		std::size_t GetSize() const { return packets.size(); }
+		// valid after Sort, the keys in submission order and the packet index of each
+		const std::vector<uint64>& GetSortedKeys() const { return sortedKeys; }
+		const std::vector<uint32>& GetOrder() const { return order; }
+
+		static uint64 MakeKey(RenderPass pass, uint32 shader, uint32 material, uint32 vertexArray, float viewDepth);
+		// stable sort of the keys in place, order gets each sorted key's original index; the scratch
+		// buffers are only kept to save reallocating them every frame
+		static void RadixSort(std::vector<uint64>& keys, std::vector<uint32>& order, std::vector<uint64>& scratchKeys, std::vector<uint32>& scratchOrder);
+
+		const Stats& GetStats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+	};
+
+} // Render
@@ -1,27 +1,74 @@
 #include "config.h"
 #include "shader.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <ranges>
+#include <mutex>
 
+#include "glState.h"
 #include "math/math.h"
 
 namespace Resource {
 
+	static constexpr GLint unresolvedLocation = -2;
+
+	// the names every UniformHandle was made from, shared by all shaders
+	struct UniformRegistry {
+		std::mutex mutex;
+		std::unordered_map<std::string, uint32> ids;
+		std::vector<std::string> names;
+	};
+
+	static UniformRegistry& Registry() {
+		static UniformRegistry registry;
+		return registry;
+	}
+
+	static bool IsOpaque(GLenum type) {
+		switch (type) {
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_CUBE_MAP_ARRAY: case GL_SAMPLER_2D_MULTISAMPLE:
+		case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_2D:
+		case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY: case GL_UNSIGNED_INT_SAMPLER_3D:
+		case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_2D_ARRAY: case GL_UNSIGNED_INT_IMAGE_2D:
+		case GL_INT_IMAGE_2D:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	template<typename T> static bool Matches(GLenum type);
+	template<> bool Matches<GLint>(GLenum type) { return type == GL_INT || type == GL_BOOL || IsOpaque(type); }
+	template<> bool Matches<float32>(GLenum type) { return type == GL_FLOAT; }
+	template<> bool Matches<Math::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+	template<> bool Matches<Math::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+	template<> bool Matches<Math::vec4>(GLenum type) { return type == GL_FLOAT_VEC4; }
+	template<> bool Matches<Math::mat4>(GLenum type) { return type == GL_FLOAT_MAT4; }
+
 	Shader::Shader(const std::filesystem::path& vsPath, const std::filesystem::path& fsPath)
-		: handle(0), vHandle(0), fHandle(0), vsSrcPath(vsPath), fsSrcPath(fsPath), used(false) {
+		: handle(0), vHandle(0), fHandle(0), cHandle(0), vsSrcPath(vsPath), fsSrcPath(fsPath) {
 		ReadSource(vsSrcPath.string(), vsSrc);
 		ReadSource(fsSrcPath.string(), fsSrc);
 
 		CompileAndLink();
 	}
 
+	Shader::Shader(const std::filesystem::path& csPath)
+		: handle(0), vHandle(0), fHandle(0), cHandle(0), csSrcPath(csPath) {
+		ReadSource(csSrcPath.string(), csSrc);
+
+		CompileAndLink();
+	}
+
 	Shader::~Shader() {
 	}
 
 	void Shader::Cleanup() {
 		if (handle) {
+			Render::GLState::Get().ForgetProgram(handle);
 			glDeleteProgram(handle);
 			handle = 0;
 		}
@@ -33,56 +80,122 @@ namespace Resource {
 			glDeleteShader(fHandle);
 			fHandle = 0;
 		}
-	}
-
-	void Shader::Use() {
-		if (!used) {
-			glUseProgram(handle);
-			used = true;
+		if (cHandle) {
+			glDeleteShader(cHandle);
+			cHandle = 0;
 		}
 	}
 
-	void Shader::UnUse() {
-		if (used) {
-			glUseProgram(0);
-			used = false;
-		}
+	void Shader::Use() {
+		Render::GLState::Get().UseProgram(handle);
 	}
 
 	void Shader::UploadUniform1i(const std::string& name, GLint v) {
-		GLuint loc = GetOrUpdateUniformLoc(name);
-		glUniform1i(loc, v);
+		glUniform1i(GetUniformLocation(name), v);
 	}
 
 	void Shader::UploadUniform1f(const std::string& name, float32 v) {
-		GLuint loc = GetOrUpdateUniformLoc(name);
-		glUniform1f(loc, v);
+		glUniform1f(GetUniformLocation(name), v);
 	}
 
 	void Shader::UploadUniform2fv(const std::string& name, const Math::vec2& v) {
-		GLuint loc = GetOrUpdateUniformLoc(name);
-		glUniform2fv(loc, 1, &v.x);
+		glUniform2fv(GetUniformLocation(name), 1, &v.x);
 	}
 
 	void Shader::UploadUniform3fv(const std::string& name, const Math::vec3& v) {
-		GLuint loc = GetOrUpdateUniformLoc(name);
-		glUniform3fv(loc, 1, &v.x);
+		glUniform3fv(GetUniformLocation(name), 1, &v.x);
 	}
 
 	void Shader::UploadUniform4fv(const std::string& name, const Math::vec4& v) {
-		GLuint loc = GetOrUpdateUniformLoc(name);
-		glUniform4fv(loc, 1, &v.x);
+		glUniform4fv(GetUniformLocation(name), 1, &v.x);
 	}
 
 	void Shader::UploadUniformMat4fv(const std::string& name, const Math::mat4& m) {
-		GLuint loc = GetOrUpdateUniformLoc(name);
-		glUniformMatrix4fv(loc, 1, GL_FALSE, &m[0].x);
+		glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &m[0].x);
+	}
+
+	uint32 Shader::RegisterUniform(std::string_view name) {
+		auto& registry = Registry();
+		std::lock_guard lock(registry.mutex);
+		const auto [it, inserted] = registry.ids.try_emplace(std::string(name), (uint32)registry.names.size());
+		if (inserted) {
+			registry.names.emplace_back(name);
+		}
+		return it->second;
+	}
+
+	GLint Shader::ResolveHandle(uint32 id, bool (*matches)(GLenum)) {
+		if (id >= handleLocations.size()) {
+			handleLocations.resize(id + 1, unresolvedLocation);
+		}
+
+		std::string name;
+		{
+			auto& registry = Registry();
+			std::lock_guard lock(registry.mutex);
+			name = registry.names[id];
+		}
+
+		// inactive uniforms resolve to -1, which GL ignores
+		GLint location = -1;
+		const auto it = uniforms.find(name);
+		if (it != uniforms.end()) {
+			location = it->second.location;
+			if (!matches(it->second.type)) {
+				std::cerr << "[WARNING] uniform " << name << " uploaded as the wrong type\n";
+			}
+		}
+		handleLocations[id] = location;
+		return location;
+	}
+
+	template<typename T>
+	GLint Shader::HandleLocation(UniformHandle<T> h) {
+		const uint32 id = h.GetId();
+		if (id < handleLocations.size() && handleLocations[id] != unresolvedLocation) {
+			return handleLocations[id];
+		}
+		return ResolveHandle(id, &Matches<T>);
+	}
+
+	void Shader::Upload(UniformHandle<GLint> h, GLint v) {
+		glUniform1i(HandleLocation(h), v);
+	}
+
+	void Shader::Upload(UniformHandle<float32> h, float32 v) {
+		glUniform1f(HandleLocation(h), v);
+	}
+
+	void Shader::Upload(UniformHandle<Math::vec2> h, const Math::vec2& v) {
+		glUniform2fv(HandleLocation(h), 1, &v.x);
+	}
+
+	void Shader::Upload(UniformHandle<Math::vec3> h, const Math::vec3& v) {
+		glUniform3fv(HandleLocation(h), 1, &v.x);
+	}
+
+	void Shader::Upload(UniformHandle<Math::vec4> h, const Math::vec4& v) {
+		glUniform4fv(HandleLocation(h), 1, &v.x);
+	}
+
+	void Shader::Upload(UniformHandle<Math::mat4> h, const Math::mat4& m) {
+		glUniformMatrix4fv(HandleLocation(h), 1, GL_FALSE, &m[0].x);
+	}
+
+	GLint Shader::GetUniformLocation(const std::string& name) const {
+		const auto it = uniforms.find(name);
+		return it != uniforms.end() ? it->second.location : -1;
 	}
 
 	void Shader::Recompile() {
 		Cleanup();
-		ReadSource(vsSrcPath.string(), vsSrc);
-		ReadSource(fsSrcPath.string(), fsSrc);
+		if (!csSrcPath.empty()) {
+			ReadSource(csSrcPath.string(), csSrc);
+		}
+		else {
+			ReadSource(vsSrcPath.string(), vsSrc);
+			ReadSource(fsSrcPath.string(), fsSrc);
+		}
 
 		CompileAndLink();
 	}
@@ -102,103 +215,154 @@ namespace Resource {
 		in.close();
 	}
 
-	void Shader::CompileAndLink() {
-		Cleanup();
-		std::string compilerLog{};
-
-		vHandle = glCreateShader(GL_VERTEX_SHADER);
-		const GLchar* vsrc = vsSrc.c_str();
-		GLint len = (GLint)vsSrc.size();
-		glShaderSource(vHandle, 1, &vsrc, &len);
-		glCompileShader(vHandle);
+	GLuint Shader::CompileStage(GLenum type, const std::string& src, const char* stageName) {
+		GLuint stage = glCreateShader(type);
+		const GLchar* csrc = src.c_str();
+		GLint len = (GLint)src.size();
+		glShaderSource(stage, 1, &csrc, &len);
+		glCompileShader(stage);
 
 		// get error log
 		GLint shaderLogSize{};
-		glGetShaderiv(vHandle, GL_INFO_LOG_LENGTH, &shaderLogSize);
+		glGetShaderiv(stage, GL_INFO_LOG_LENGTH, &shaderLogSize);
 		if (shaderLogSize > 0)
 		{
 			GLchar* buf = new GLchar[shaderLogSize];
-			glGetShaderInfoLog(vHandle, shaderLogSize, NULL, buf);
-			compilerLog.append(buf);
-			printf("[VERTEX SHADER COMPILE ERROR]: %s", buf);
+			glGetShaderInfoLog(stage, shaderLogSize, NULL, buf);
+			printf("[%s SHADER COMPILE ERROR]: %s", stageName, buf);
 			delete[] buf;
 		}
+		return stage;
+	}
 
-		fHandle = glCreateShader(GL_FRAGMENT_SHADER);
-		const GLchar* fsrc = fsSrc.c_str();
-		len = (GLint)fsSrc.size();
-		glShaderSource(fHandle, 1, &fsrc, &len);
-		glCompileShader(fHandle);
-
-		// get error log
-		shaderLogSize = 0;
-		glGetShaderiv(fHandle, GL_INFO_LOG_LENGTH, &shaderLogSize);
-		if (shaderLogSize > 0)
-		{
-			GLchar* buf = new GLchar[shaderLogSize];
-			glGetShaderInfoLog(fHandle, shaderLogSize, NULL, buf);
-			compilerLog.append(buf);
-			printf("[FRAGMENT SHADER COMPILE ERROR]: %s", buf);
-			delete[] buf;
-		}
+	void Shader::CompileAndLink() {
+		Cleanup();
 
 		handle = glCreateProgram();
-		glAttachShader(handle, vHandle);
-		glAttachShader(handle, fHandle);
+		if (!csSrcPath.empty()) {
+			cHandle = CompileStage(GL_COMPUTE_SHADER, csSrc, "COMPUTE");
+			glAttachShader(handle, cHandle);
+		}
+		else {
+			vHandle = CompileStage(GL_VERTEX_SHADER, vsSrc, "VERTEX");
+			fHandle = CompileStage(GL_FRAGMENT_SHADER, fsSrc, "FRAGMENT");
+			glAttachShader(handle, vHandle);
+			glAttachShader(handle, fHandle);
+		}
 		glLinkProgram(handle);
 
-		shaderLogSize = 0;
+		GLint shaderLogSize = 0;
 		glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &shaderLogSize);
 		if (shaderLogSize > 0)
 		{
 			GLchar* buf = new GLchar[shaderLogSize];
 			glGetProgramInfoLog(handle, shaderLogSize, NULL, buf);
-			compilerLog.append(buf);
 			printf("[PROGRAM LINK ERROR]: %s", buf);
 			delete[] buf;
 		}
+
+		Reflect();
 	}
 
-	GLuint Shader::GetOrUpdateUniformLoc(const std::string& name) {
-		if (!uniformLoc.contains(name)) {
-			uniformLoc[name] = glGetUniformLocation(handle, name.c_str());
+	void Shader::Reflect() {
+		uniforms.clear();
+		blocks.clear();
+		handleLocations.assign(handleLocations.size(), unresolvedLocation);
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(handle, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			return;
+		}
+
+		std::string name;
+		const auto readName = [&](GLenum interface, GLint index) {
+			GLint maxLength = 0;
+			glGetProgramInterfaceiv(handle, interface, GL_MAX_NAME_LENGTH, &maxLength);
+			name.resize(std::max(maxLength, 1));
+			GLsizei length = 0;
+			glGetProgramResourceName(handle, interface, index, (GLsizei)name.size(), &length, name.data());
+			return std::string(name.data(), length);
+		};
+
+		GLint count = 0;
+		glGetProgramInterfaceiv(handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+		for (GLint i = 0; i < count; ++i) {
+			const GLenum props[] = { GL_BLOCK_INDEX, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+			GLint values[4] = {};
+			glGetProgramResourceiv(handle, GL_UNIFORM, i, 4, props, 4, nullptr, values);
+			// members of uniform blocks have no location of their own
+			if (values[0] != -1) continue;
+
+			const std::string key = readName(GL_UNIFORM, i);
+			const UniformInfo info{ values[1], (GLenum)values[2], values[3] };
+			uniforms[key] = info;
+			if (key.ends_with("[0]")) {
+				uniforms[key.substr(0, key.size() - 3)] = info;
+			}
+		}
+
+		for (const GLenum interface : { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK }) {
+			glGetProgramInterfaceiv(handle, interface, GL_ACTIVE_RESOURCES, &count);
+			for (GLint i = 0; i < count; ++i) {
+				const GLenum props[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+				GLint values[2] = {};
+				glGetProgramResourceiv(handle, interface, i, 2, props, 2, nullptr, values);
+				blocks[readName(interface, i)] = { interface, values[0], values[1] };
+			}
 		}
-		return uniformLoc[name];
 	}
 
-	void ShaderManager::Push(const std::string& name, const std::filesystem::path& vsPath,
-		const std::filesystem::path& fsPath) {
-		if (shaders.contains(name)) {
+	ShaderManager::Handle ShaderManager::Emplace(const std::string& name, std::shared_ptr<Shader> shader) {
+		const auto id = Utils::StringId::FromString(name);
+		const auto [it, inserted] = slots.try_emplace(id, (uint32)shaders.size());
+		if (inserted) {
+			shaders.push_back(std::move(shader));
+		} else {
 			std::cerr << "[WARNING] Overwriting existing shader " << name << '\n';
-			shaders[name]->Cleanup();
-			shaders[name].reset();
+			shaders[it->second]->Cleanup();
+			shaders[it->second] = std::move(shader);
 		}
+		return { it->second };
+	}
 
-		shaders[name] = std::make_shared<Shader>(vsPath, fsPath);
+	ShaderManager::Handle ShaderManager::Push(const std::string& name, const std::filesystem::path& vsPath,
+		const std::filesystem::path& fsPath) {
+		return Emplace(name, std::make_shared<Shader>(vsPath, fsPath));
 	}
 
-	std::weak_ptr<Shader> ShaderManager::Get(const std::string& name) const {
-		if (!shaders.contains(name)) {
-			std::cerr << "[ERROR] Trying to access nonexistent shader " << name << '\n';
+	ShaderManager::Handle ShaderManager::PushCompute(const std::string& name, const std::filesystem::path& csPath) {
+		return Emplace(name, std::make_shared<Shader>(csPath));
+	}
+
+	ShaderManager::Handle ShaderManager::Find(Utils::StringId name) const {
+		const auto it = slots.find(name);
+		if (it == slots.end()) {
+			std::cerr << "[ERROR] Trying to access nonexistent shader " << name.GetName()
+				<< " (0x" << std::hex << name.GetHash() << std::dec << ")\n";
 			return {};
 		}
+		return { it->second };
+	}
 
-		return shaders.at(name);
+	std::weak_ptr<Shader> ShaderManager::Get(Utils::StringId name) const {
+		const auto h = Find(name);
+		if (!h.IsValid()) {
+			return {};
+		}
+		return shaders[h.index];
 	}
 
 	void ShaderManager::RecompileAll() {
-		for (auto& shader : shaders | std::views::values) {
+		for (auto& shader : shaders) {
 			shader->Recompile();
 		}
 	}
 
-	void ShaderManager::Recompile(const std::string& name) {
-		if (!shaders.contains(name)) {
-			std::cerr << "[ERROR] Trying to recompile nonexistent shader " << name << '\n';
-			return;
+	void ShaderManager::Recompile(Utils::StringId name) {
+		if (auto* shader = Get(Find(name))) {
+			shader->Recompile();
 		}
-
-		shaders[name]->Recompile();
 	}
 
 } // Resource
\ No newline at end of file
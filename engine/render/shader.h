@@ -3,39 +3,80 @@
 #include "GL/glew.h"
 
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <memory>
+#include <vector>
 
 #include "math/vec2.h"
 #include "math/vec3.h"
 #include "math/vec4.h"
 #include "math/mat4.h"
+#include "util/stringId.h"
 
 namespace Resource {
 
+	class Shader;
+
+	// A uniform name registered once and then usable with every shader, typed by what is uploaded
+	// through it. Make them static at the call site so the string is only touched the first time;
+	// each shader turns the handle into its location with an array lookup, which survives Recompile.
+	template<typename T>
+	class UniformHandle {
+		uint32 id;
+
+	public:
+		explicit UniformHandle(std::string_view name);
+
+		uint32 GetId() const { return id; }
+	};
+
+	// a vertex and fragment program, or a compute program when built from a single source
 	class Shader {
+	public:
+		// an active uniform as reflected at link time; arrays are listed under their name
+		// without the [0] as well
+		struct UniformInfo {
+			GLint location;
+			GLenum type;
+			GLint arraySize;
+		};
+
+		// a uniform or shader storage block as reflected at link time
+		struct BlockInfo {
+			GLenum interface;
+			GLint binding;
+			GLint dataSize;
+		};
+
+	private:
 		GLuint handle;
 		GLuint vHandle;
 		GLuint fHandle;
+		GLuint cHandle;
 
 		std::filesystem::path vsSrcPath;
 		std::filesystem::path fsSrcPath;
+		std::filesystem::path csSrcPath;
 		std::string vsSrc;
 		std::string fsSrc;
+		std::string csSrc;
 
-		std::unordered_map<std::string, GLuint> uniformLoc;
-
-		bool used;
+		std::unordered_map<std::string, UniformInfo> uniforms;
+		std::unordered_map<std::string, BlockInfo> blocks;
+		// per UniformHandle id its location in this program, unresolvedLocation until first used
+		std::vector<GLint> handleLocations;
 
 	public:
 		Shader(const std::filesystem::path& vsPath, const std::filesystem::path& fsPath);
+		explicit Shader(const std::filesystem::path& csPath);
 		~Shader();
 
 		void Cleanup();
 
+		// the program stays bound until another one is used
 		void Use();
-		void UnUse();
 
 		GLuint GetHandle() const { return handle; }
 		std::string& GetVSSrc() { return vsSrc; }
@@ -48,18 +89,55 @@ namespace Resource {
 		void UploadUniform4fv(const std::string& name, const Math::vec4& v);
 		void UploadUniformMat4fv(const std::string& name, const Math::mat4& m);
 
+		void Upload(UniformHandle<GLint> h, GLint v);
+		void Upload(UniformHandle<float32> h, float32 v);
+		void Upload(UniformHandle<Math::vec2> h, const Math::vec2& v);
+		void Upload(UniformHandle<Math::vec3> h, const Math::vec3& v);
+		void Upload(UniformHandle<Math::vec4> h, const Math::vec4& v);
+		void Upload(UniformHandle<Math::mat4> h, const Math::mat4& m);
+
+		const std::unordered_map<std::string, UniformInfo>& GetUniforms() const { return uniforms; }
+		const std::unordered_map<std::string, BlockInfo>& GetBlocks() const { return blocks; }
+		// -1 when the program has no active uniform of that name
+		GLint GetUniformLocation(const std::string& name) const;
+
 		void Recompile();
 
+		// the id of a uniform name, the same for every shader; what UniformHandle is built from
+		static uint32 RegisterUniform(std::string_view name);
+
 	private:
 		void ReadSource(const std::string& path, std::string& dst);
 		void CompileAndLink();
-		
-
-		GLuint GetOrUpdateUniformLoc(const std::string& name);
+		GLuint CompileStage(GLenum type, const std::string& src, const char* stageName);
+		// fills the uniform and block tables from the linked program and forgets handle locations
+		void Reflect();
+
+		// checks the reflected type against what the handle uploads, once per handle and program
+		GLint ResolveHandle(uint32 id, bool (*matches)(GLenum));
+		template<typename T>
+		GLint HandleLocation(UniformHandle<T> h);
 	};
 
+	template<typename T>
+	UniformHandle<T>::UniformHandle(std::string_view name)
+		: id(Shader::RegisterUniform(name)) {
+	}
+
+	// Shaders by name. Names are looked up once, as a StringId, into a Handle that indexes the
+	// shaders directly; a handle keeps naming the same shader when its name is pushed again.
 	class ShaderManager {
-		std::unordered_map<std::string, std::shared_ptr<Shader>> shaders;
+	public:
+		struct Handle {
+			static constexpr uint32 invalidIndex = UINT32_MAX;
+			uint32 index = invalidIndex;
+
+			bool IsValid() const { return index != invalidIndex; }
+		};
+
+	private:
+		std::vector<std::shared_ptr<Shader>> shaders;
+		std::unordered_map<Utils::StringId, uint32, Utils::StringIdHash> slots;
 
 	public:
 		ShaderManager() = default;
@@ -70,12 +148,21 @@ namespace Resource {
 		ShaderManager& operator=(const ShaderManager&) = delete;
 		ShaderManager& operator=(ShaderManager&&) = delete;
 
-		void Push(const std::string& name, const std::filesystem::path& vsPath,
+		Handle Push(const std::string& name, const std::filesystem::path& vsPath,
 			const std::filesystem::path& fsPath);
-		std::weak_ptr<Shader> Get(const std::string& name) const;
+		Handle PushCompute(const std::string& name, const std::filesystem::path& csPath);
+
+		// an invalid handle when no shader has that name
+		Handle Find(Utils::StringId name) const;
+		// nullptr for an invalid handle, valid until the name is pushed again
+		Shader* Get(Handle h) const { return h.IsValid() ? shaders[h.index].get() : nullptr; }
+		std::weak_ptr<Shader> Get(Utils::StringId name) const;
 
 		void RecompileAll();
-		void Recompile(const std::string& name);
+		void Recompile(Utils::StringId name);
+
+	private:
+		Handle Emplace(const std::string& name, std::shared_ptr<Shader> shader);
 	};
 
-} // Resource
\ No newline at end of file
+} // Resource
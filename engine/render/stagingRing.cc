@@ -0,0 +1,97 @@
+#include "config.h"
+#include "stagingRing.h"
+
+#include <iostream>
+
+namespace Resource {
+
+	StagingRing::StagingRing(std::size_t size)
+		: size(size) {
+		constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, (GLsizeiptr)size, nullptr, flags);
+		mapped = static_cast<uchar*>(glMapNamedBufferRange(buffer, 0, (GLsizeiptr)size, flags));
+		if (mapped == nullptr) {
+			std::cerr << "[ERROR] failed to map texture staging buffer\n";
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+		}
+	}
+
+	StagingRing::~StagingRing() {
+		if (buffer == 0) {
+			return;
+		}
+		for (const auto& region : inFlight) {
+			glDeleteSync(region.fence);
+		}
+		glUnmapNamedBuffer(buffer);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	void StagingRing::Retire() {
+		while (!inFlight.empty()) {
+			const GLenum status = glClientWaitSync(inFlight.front().fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+			tail = inFlight.front().end;
+			glDeleteSync(inFlight.front().fence);
+			inFlight.pop_front();
+		}
+
+		if (inFlight.empty() && !unfenced) {
+			head = 0;
+			tail = 0;
+		}
+	}
+
+	std::size_t StagingRing::Allocate(std::size_t bytes, std::size_t alignment) {
+		if (buffer == 0 || bytes > size) {
+			stalls++;
+			return invalidOffset;
+		}
+
+		Retire();
+		const bool empty = inFlight.empty() && !unfenced;
+		std::size_t offset = (head + alignment - 1) / alignment * alignment;
+
+		// free space is [head, size) plus [0, tail) while the used part has not wrapped, [head, tail) after
+		bool fits;
+		if (empty || head >= tail) {
+			fits = offset + bytes <= size;
+			if (!fits && (empty || bytes < tail)) {
+				offset = 0;
+				fits = true;
+			}
+		}
+		else {
+			fits = offset + bytes < tail;
+		}
+
+		if (!fits) {
+			stalls++;
+			return invalidOffset;
+		}
+
+		head = offset + bytes;
+		unfenced = true;
+		stagedBytes += bytes;
+		return offset;
+	}
+
+	void StagingRing::Fence() {
+		if (!unfenced) {
+			return;
+		}
+		inFlight.push_back({ head, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+		unfenced = false;
+	}
+
+	void StagingRing::Abandon() {
+		buffer = 0;
+		mapped = nullptr;
+		inFlight.clear();
+		unfenced = false;
+	}
+
+} // Resource
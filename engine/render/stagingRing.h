@@ -0,0 +1,61 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <deque>
+#include <limits>
+
+namespace Resource {
+
+	// Persistently mapped GL_PIXEL_UNPACK_BUFFER handed out front to back as a ring. Space
+	// written since the last Fence is protected by the fence placed then and reused once the
+	// GPU has passed it, so pixel copies run while the CPU moves on. Needs the GL context.
+	class StagingRing {
+		struct Region {
+			std::size_t end;
+			GLsync fence;
+		};
+
+		GLuint buffer = 0;
+		uchar* mapped = nullptr;
+		std::size_t size;
+		std::size_t head = 0;
+		std::size_t tail = 0;
+		bool unfenced = false;
+		std::deque<Region> inFlight;
+
+		std::size_t stagedBytes = 0;
+		std::size_t stalls = 0;
+
+	public:
+		static constexpr std::size_t invalidOffset = std::numeric_limits<std::size_t>::max();
+
+		explicit StagingRing(std::size_t size = 32 << 20);
+		StagingRing(const StagingRing&) = delete;
+		StagingRing(StagingRing&&) = delete;
+		~StagingRing();
+
+		StagingRing& operator=(const StagingRing&) = delete;
+		StagingRing& operator=(StagingRing&&) = delete;
+
+		// offset of bytes free for writing, invalidOffset when they do not fit until the GPU catches up
+		std::size_t Allocate(std::size_t bytes, std::size_t alignment = 16);
+		uchar* Data(std::size_t offset) const { return mapped + offset; }
+		GLuint GetHandle() const { return buffer; }
+		std::size_t GetSize() const { return size; }
+
+		// everything allocated since the previous fence is in use by the commands issued so far
+		void Fence();
+
+		// forgets the GL objects without deleting them, for after the context is gone
+		void Abandon();
+
+		std::size_t GetStagedBytes() const { return stagedBytes; }
+		// allocations that did not fit and went through client memory instead
+		std::size_t GetStalls() const { return stalls; }
+
+	private:
+		void Retire();
+	};
+
+} // Resource
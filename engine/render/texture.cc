@@ -1,7 +1,19 @@
 #include "config.h"
 #include "texture.h"
 
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "bcEncoder.h"
+#include "glState.h"
+#include "mipGenerator.h"
+#include "stagingRing.h"
+#include "textureArray.h"
+#include "textureContainer.h"
 
 #include "stb_image.h"
 #include "fx/gltf.h"
@@ -14,51 +26,44 @@ namespace Resource {
 	}
 
 	Texture::Texture(const std::filesystem::path& dir, const fx::gltf::Document& doc, int tex_i, int flip) {
-		SetDefaultSampling();
-		if (!doc.samplers.empty()) {
-			const auto& sampler = doc.samplers[doc.textures[tex_i].sampler];
-
-			wrap = { (GLint)sampler.wrapS, (GLint)sampler.wrapT };
-
-			if (sampler.minFilter == fx::gltf::Sampler::MinFilter::None) {
-				filter.min = GL_LINEAR;
-			}
-			else {
-				filter.min = (GLint)sampler.minFilter;
-			}
-
-			if (sampler.magFilter == fx::gltf::Sampler::MagFilter::None) {
-				filter.mag = GL_LINEAR;
-			}
-			else {
-				filter.mag = (GLint)sampler.magFilter;
-			}
-		}
+		SetSamplingFromGLTF(doc, tex_i);
 		LoadFromGLTF(dir, doc, tex_i, flip);
 	}
 
+	Texture::Texture(const fx::gltf::Document& doc, int tex_i) {
+		SetSamplingFromGLTF(doc, tex_i);
+	}
+
 	Texture::Texture(const Texture& other)
 		: handle(other.handle) {
 	}
 
-	Texture Texture::DummyTexture() {
-		Texture t;
-		t.SetDefaultSampling();
-
-		glCreateTextures(GL_TEXTURE_2D, 1, &t.handle);
-		glBindTexture(GL_TEXTURE_2D, t.handle);
-
-		GLubyte data[3];
-		data[0] = 255;
-		data[1] = 255;
-		data[2] = 255;
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 1, 1, 0,
-			GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)data);
-
-		glBindTexture(GL_TEXTURE_2D, 0);
+	std::shared_ptr<Texture> Texture::DummyTexture() {
+		// built in place, the copy constructor only takes the handle
+		auto t = std::make_shared<Texture>();
+		t->SetDefaultSampling();
+
+		ImageData white;
+		white.width = 1;
+		white.height = 1;
+		white.pixels = { 255, 255, 255, 255 };
+		white.levels.push_back({ 1, 1, 0, 4 });
+		t->Upload(white);
 		return t;
 	}
 
+	GLuint Texture::PlaceholderHandle() {
+		// textures still being loaded in the background sample as plain white
+		static GLuint placeholder = 0;
+		if (placeholder == 0) {
+			const GLubyte data[4] = { 255, 255, 255, 255 };
+			glCreateTextures(GL_TEXTURE_2D, 1, &placeholder);
+			glTextureStorage2D(placeholder, 1, GL_RGBA8, 1, 1);
+			glTextureSubImage2D(placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+		return placeholder;
+	}
+
 	Texture& Texture::operator=(const Texture& other) {
 		this->handle = other.handle;
 		return *this;
@@ -66,58 +71,226 @@ namespace Resource {
 
 	void Texture::Unload() {
 		if (handle != 0) {
+			Render::GLState::Get().ForgetTexture(handle);
 			glDeleteTextures(1, &handle);
+			handle = 0;
 		}
+		array.reset();
+		layer = -1;
+	}
+
+	std::size_t Texture::GetByteSize() const {
+		if (array) {
+			return array->GetLayerBytes();
+		}
+		return handle != 0 ? byteSize : 0;
 	}
 
 	void Texture::Bind(GLint loc) const {
-		//glUniform1i(GL_TEXTURE0, loc);
-		glActiveTexture(GL_TEXTURE0 + loc);
-		glBindTexture(GL_TEXTURE_2D, handle);
+		Render::GLState::Get().BindTexture(loc, handle != 0 ? handle : PlaceholderHandle());
 	}
 
-	void Texture::UnBind() const {
-		glBindTexture(GL_TEXTURE_2D, 0);
+	ImageData Texture::Decode(const std::filesystem::path& path, int flip) {
+		std::vector<uchar> bytes;
+		if (!TextureCache::ReadFile(path, bytes)) {
+			return {};
+		}
+
+		auto image = Decode(bytes, flip);
+		if (!image.IsValid()) {
+			std::cerr << "[ERROR] failed to decode texture file: " << path << '\n';
+		}
+		return image;
 	}
 
-	void Texture::LoadFromFile(const std::filesystem::path& path, int flip) {
-		if (!std::filesystem::exists(path)) {
-			std::cerr << "[ERROR] trying to read non-existing texture file: " << path << '\n';
+	ImageData Texture::Decode(const std::vector<uchar>& encoded, int flip) {
+		ImageData image;
+
+		// containers already hold GPU ready data and their own mip chain, flip does not apply
+		if (TextureContainer::IsDDS(encoded)) {
+			TextureContainer::ReadDDS(encoded, image);
+			return image;
+		}
+		if (TextureContainer::IsKTX2(encoded)) {
+			TextureContainer::ReadKTX2(encoded, image);
+			return image;
+		}
+
+		int comp;
+		stbi_set_flip_vertically_on_load_thread(flip);
+		uchar* data = stbi_load_from_memory(encoded.data(), (int)encoded.size(),
+			&image.width, &image.height, &comp, STBI_rgb_alpha);
+
+		if (data == nullptr) {
+			std::cerr << "[ERROR] failed to decode texture: " << stbi_failure_reason() << '\n';
+			return image;
+		}
+
+		const auto size = (std::size_t)image.width * image.height * 4;
+		image.pixels.assign(data, data + size);
+		image.levels.push_back({ image.width, image.height, 0, size });
+		stbi_image_free(data);
+		return image;
+	}
+
+	bool Texture::ReadSize(const std::vector<uchar>& encoded, int& width, int& height) {
+		int comp;
+		return stbi_info_from_memory(encoded.data(), (int)encoded.size(), &width, &height, &comp) != 0;
+	}
+
+	std::filesystem::path Texture::PathFromGLTF(const std::filesystem::path& dir, const fx::gltf::Document& doc, int tex_i) {
+		return dir / std::filesystem::path(doc.images[doc.textures[tex_i].source].uri).make_preferred();
+	}
+
+	void Texture::Upload(const ImageData& image, StagingRing* staging) {
+		if (!image.IsValid()) {
 			return;
 		}
 
-		int w, h, comp;
-		stbi_set_flip_vertically_on_load(flip);
-		uchar* image = stbi_load(path.string().c_str(), &w, &h, &comp, STBI_rgb_alpha);
+		Unload();
+		width = image.width;
+		height = image.height;
+		format = image.format;
+
+		// without a prebuilt chain a mipmapped filter falls back to the driver's glGenerateMipmap,
+		// which compressed formats cannot do, so those sample level 0 only
+		const bool prebuiltMips = image.levels.size() > 1;
+		if (image.IsCompressed() && !prebuiltMips && UsesMipmaps()) {
+			filter.min = GL_LINEAR;
+		}
+		const bool generateMips = !prebuiltMips && UsesMipmaps();
+
+		levelCount = (int)image.levels.size();
+		if (generateMips) {
+			levelCount = 1;
+			for (int size = std::max(width, height); size > 1; size /= 2) levelCount++;
+		}
+
+		residentLevel = 0;
+		handle = CreateStorage(0);
+		UploadLevels(handle, image, 0, (int)image.levels.size(), 0, staging);
+		if (generateMips) {
+			glGenerateTextureMipmap(handle);
+		}
+		byteSize = ResidentBytes();
+	}
 
-		if (image == nullptr) {
+	void Texture::Stream(const ImageData& image, int firstLevel, StagingRing* staging) {
+		if (!image.IsValid()) {
 			return;
 		}
 
-		glCreateTextures(GL_TEXTURE_2D, 1, &handle);
-		glBindTexture(GL_TEXTURE_2D, handle);
+		firstLevel = std::clamp(firstLevel, 0, (int)image.levels.size() - 1);
+		if (handle != 0 && firstLevel == residentLevel) {
+			return;
+		}
+
+		width = image.width;
+		height = image.height;
+		format = image.format;
+		levelCount = (int)image.levels.size();
+
+		// the storage only ever holds the resident mips, levels both allocations share move over on the GPU
+		const GLuint previous = handle;
+		const int previousFirst = residentLevel;
+		handle = CreateStorage(firstLevel);
+
+		int uploadEnd = levelCount;
+		if (previous != 0) {
+			const int keepFrom = std::max(firstLevel, previousFirst);
+			for (int l = keepFrom; l < levelCount; ++l) {
+				glCopyImageSubData(previous, GL_TEXTURE_2D, l - previousFirst, 0, 0, 0,
+					handle, GL_TEXTURE_2D, l - firstLevel, 0, 0, 0,
+					image.levels[l].width, image.levels[l].height, 1);
+			}
+			Render::GLState::Get().ForgetTexture(previous);
+			glDeleteTextures(1, &previous);
+			uploadEnd = keepFrom;
+		}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap.s);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap.s);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter.min);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter.mag);
+		UploadLevels(handle, image, firstLevel, uploadEnd, firstLevel, staging);
+		residentLevel = firstLevel;
+		byteSize = ResidentBytes();
+	}
+
+	std::size_t Texture::LevelBytes(int level) const {
+		return TextureContainer::LevelSize(format, std::max(width >> level, 1), std::max(height >> level, 1));
+	}
+
+	std::size_t Texture::ResidentBytes() const {
+		std::size_t bytes = 0;
+		for (int l = residentLevel; l < levelCount; ++l) {
+			bytes += LevelBytes(l);
+		}
+		return bytes;
+	}
+
+	GLuint Texture::CreateStorage(int firstLevel) const {
+		// immutable storage, the driver knows the whole chain up front and never has to reallocate
+		GLuint texture;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, levelCount - firstLevel, TextureContainer::GLInternalFormat(format),
+			std::max(width >> firstLevel, 1), std::max(height >> firstLevel, 1));
+		TextureContainer::SetSwizzle(texture, format);
+
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrap.s);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrap.t);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, filter.min);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, filter.mag);
 
 		float maxAniso{ 1.0f };
 		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAniso);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, maxAniso);
+		glTextureParameterf(texture, GL_TEXTURE_MAX_ANISOTROPY, maxAniso);
+		return texture;
+	}
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0,
-			GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)image);
+	void Texture::UploadLevels(GLuint texture, const ImageData& image, int from, int to, int firstLevel, StagingRing* staging) const {
+		if (from >= to) {
+			return;
+		}
 
-		GenerateMipMapifNeeded();
+		// the levels are contiguous in the image, copied into the staging ring the pixels are read by the GPU
+		// asynchronously, otherwise the driver has to copy them out of client memory before returning
+		const std::size_t begin = image.levels[from].offset;
+		const std::size_t bytes = image.levels[to - 1].offset + image.levels[to - 1].size - begin;
+		std::size_t offset = StagingRing::invalidOffset;
+		if (staging != nullptr) {
+			offset = staging->Allocate(bytes);
+		}
+
+		const uchar* source = image.pixels.data();
+		if (offset != StagingRing::invalidOffset) {
+			std::memcpy(staging->Data(offset), image.pixels.data() + begin, bytes);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->GetHandle());
+			source = nullptr;
+		}
+		else {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			offset = begin;
+		}
+
+		const auto internalFormat = TextureContainer::GLInternalFormat(image.format);
+		for (int i = from; i < to; ++i) {
+			const auto& level = image.levels[i];
+			const auto* data = reinterpret_cast<const GLvoid*>(source + offset + (level.offset - begin));
+			if (image.IsCompressed()) {
+				glCompressedTextureSubImage2D(texture, i - firstLevel, 0, 0, level.width, level.height,
+					internalFormat, (GLsizei)level.size, data);
+			}
+			else {
+				glTextureSubImage2D(texture, i - firstLevel, 0, 0, level.width, level.height,
+					GL_RGBA, GL_UNSIGNED_BYTE, data);
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
 
-		glBindTexture(GL_TEXTURE_2D, 0);
-		stbi_image_free(image);
+	void Texture::LoadFromFile(const std::filesystem::path& path, int flip) {
+		Upload(Decode(path, flip));
 	}
 
 	void Texture::LoadFromGLTF(const std::filesystem::path& dir, const fx::gltf::Document& doc, int tex_i, int flip) {
-		const auto& path = dir / std::filesystem::path(doc.images[doc.textures[tex_i].source].uri).make_preferred();
-		LoadFromFile(path, flip);
+		LoadFromFile(PathFromGLTF(dir, doc, tex_i), flip);
 	}
 
 	void Texture::SetDefaultSampling() {
@@ -125,35 +298,320 @@ namespace Resource {
 		filter = { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR };
 	}
 
-	void Texture::GenerateMipMapifNeeded() const {
+	void Texture::SetSamplingFromGLTF(const fx::gltf::Document& doc, int tex_i) {
+		SetDefaultSampling();
+		if (!doc.samplers.empty()) {
+			const auto& sampler = doc.samplers[doc.textures[tex_i].sampler];
+
+			wrap = { (GLint)sampler.wrapS, (GLint)sampler.wrapT };
+
+			if (sampler.minFilter == fx::gltf::Sampler::MinFilter::None) {
+				filter.min = GL_LINEAR;
+			}
+			else {
+				filter.min = (GLint)sampler.minFilter;
+			}
+
+			if (sampler.magFilter == fx::gltf::Sampler::MagFilter::None) {
+				filter.mag = GL_LINEAR;
+			}
+			else {
+				filter.mag = (GLint)sampler.magFilter;
+			}
+		}
+	}
+
+	bool Texture::UsesMipmaps() const {
 		switch (filter.min) {
 		case GL_NEAREST_MIPMAP_NEAREST:
 		case GL_NEAREST_MIPMAP_LINEAR:
 		case GL_LINEAR_MIPMAP_NEAREST:
-		case GL_LINEAR_MIPMAP_LINEAR: {
-			glGenerateMipmap(GL_TEXTURE_2D);
-			break;
+		case GL_LINEAR_MIPMAP_LINEAR:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	TextureCache::TextureCache()
+		: pathHits(0), contentHits(0) {
+	}
+
+	TextureCache& TextureCache::Get() {
+		static TextureCache cache;
+		return cache;
+	}
+
+	std::filesystem::path TextureCache::Canonical(const std::filesystem::path& path) {
+		std::error_code ec;
+		auto canonical = std::filesystem::weakly_canonical(path, ec);
+		return ec ? path.lexically_normal() : canonical;
+	}
+
+	uint64 TextureCache::HashContents(const std::vector<uchar>& bytes) {
+		// FNV-1a
+		uint64 hash = 14695981039346656037ull;
+		for (const auto b : bytes) {
+			hash ^= b;
+			hash *= 1099511628211ull;
 		}
-		default: break;
+		return hash;
+	}
+
+	bool TextureCache::ReadFile(const std::filesystem::path& path, std::vector<uchar>& bytes) {
+		std::ifstream in{ path, std::ios::in | std::ios::binary };
+		if (!in.is_open()) {
+			std::cerr << "[ERROR] trying to read non-existing texture file: " << path << '\n';
+			return false;
 		}
+
+		in.seekg(0, std::ios::end);
+		bytes.resize((std::size_t)in.tellg());
+		in.seekg(0, std::ios::beg);
+		in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+		return true;
+	}
+
+	void TextureCache::SetCompression(const CompressionSettings& settings) {
+		std::lock_guard lock(mutex);
+		compression = settings;
 	}
 
-	void TextureManager::Push(const std::string& name, const std::filesystem::path& path, int flip) {
-		if (textures.contains(name)) {
-			std::cerr << "[WARNING] Overwriting existing shader " << name << '\n';
-			textures[name]->Unload();
-			textures[name].reset();
+	ImageData TextureCache::Decode(const std::vector<uchar>& encoded, uint64 contentHash, const MipSettings& mips, int flip) const {
+		if (TextureContainer::IsDDS(encoded) || TextureContainer::IsKTX2(encoded)) {
+			return Texture::Decode(encoded, flip);
 		}
+		return Decode([&] { return Texture::Decode(encoded, flip); }, contentHash, mips, flip);
+	}
 
-		textures[name] = std::make_shared<Texture>(path, flip);
+	TextureCache::CompressionSettings TextureCache::GetCompression() const {
+		std::lock_guard lock(mutex);
+		return compression;
 	}
 
-	std::weak_ptr<Texture> TextureManager::Get(const std::string& name) const {
-		if (!textures.contains(name)) {
-			std::cerr << "[ERROR] Trying to access nonexistent texture " << name << '\n';
+	ImageData TextureCache::Decode(const std::function<ImageData()>& build, uint64 contentHash, const MipSettings& mips, int flip) const {
+		const auto settings = GetCompression();
+		if (!settings.enabled) {
+			auto image = build();
+			return image.IsValid() ? Mips::Generate(image, mips, settings.pool) : image;
+		}
+
+		// everything that changes the stored bytes is part of the name
+		std::ostringstream name;
+		name << std::hex << std::setw(16) << std::setfill('0') << contentHash << std::dec
+			<< "_q" << (int)settings.quality << 'f' << flip << 'm' << (int)mips.filter
+			<< (mips.srgb ? 's' : 'l') << (mips.wrap ? 'w' : 'c');
+		if (mips.alphaCutoff >= 0.0f) name << 'a' << std::lround(mips.alphaCutoff * 255.0f);
+		name << ".dds";
+		const auto cached = settings.cacheDir / name.str();
+
+		std::error_code ec;
+		std::vector<uchar> bytes;
+		if (std::filesystem::exists(cached, ec) && ReadFile(cached, bytes)) {
+			auto image = Texture::Decode(bytes);
+			if (image.IsValid()) return image;
+			std::cerr << "[WARNING] discarding unreadable compressed texture: " << cached << '\n';
+		}
+
+		auto image = build();
+		if (!image.IsValid()) return image;
+		image = Mips::Generate(image, mips, settings.pool);
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto format = BCn::ChooseFormat(image, settings.quality);
+		auto compressed = BCn::Compress(image, format, settings.quality, settings.pool);
+		if (!compressed.IsValid()) return image;
+		const std::chrono::duration<float64, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		static const char* const formatNames[] = { "RGBA8", "BC1", "BC3", "BC4", "BC5", "BC7" };
+		std::ostringstream report;
+		report << "[INFO] compressed " << name.str() << " (" << image.width << 'x' << image.height << ") to "
+			<< formatNames[(int)format] << " in " << std::fixed << std::setprecision(1) << elapsed.count()
+			<< " ms, PSNR " << std::setprecision(2) << BCn::PSNR(image, compressed) << " dB\n";
+		std::cout << report.str();
+
+		// written under a temporary name first, a second thread compressing the same image just replaces it
+		std::filesystem::create_directories(settings.cacheDir, ec);
+		auto temporary = cached;
+		temporary += '.' + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+		const auto dds = TextureContainer::WriteDDS(compressed);
+		{
+			std::ofstream out{ temporary, std::ios::out | std::ios::binary };
+			out.write(reinterpret_cast<const char*>(dds.data()), dds.size());
+			if (!out) {
+				std::cerr << "[WARNING] failed to write compressed texture: " << temporary << '\n';
+			}
+		}
+		std::filesystem::rename(temporary, cached, ec);
+		if (ec) std::filesystem::remove(temporary, ec);
+
+		return compressed;
+	}
+
+	std::string TextureCache::PathKey(const std::filesystem::path& canonicalPath, const Texture& prototype, int flip, const MipSettings& mips) {
+		return canonicalPath.string() + '|' + std::to_string(ContentKey(0, prototype, flip, mips));
+	}
+
+	uint64 TextureCache::ContentKey(uint64 contentHash, const Texture& prototype, int flip, const MipSettings& mips) {
+		// sampling lives in the texture object, the same pixels sampled differently need their own copy,
+		// and so do pixels decoded as color or data, or with their alpha coverage scaled
+		uint64 key = contentHash;
+		for (const uint64 v : { (uint64)prototype.wrap.s, (uint64)prototype.wrap.t,
+			(uint64)prototype.filter.min, (uint64)prototype.filter.mag, (uint64)flip,
+			(uint64)mips.srgb, (uint64)std::lround(mips.alphaCutoff * 255.0f) }) {
+			key ^= v + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+		}
+		return key;
+	}
+
+	std::shared_ptr<Texture> TextureCache::Acquire(const std::filesystem::path& canonicalPath, uint64 contentHash,
+		const Texture& prototype, int flip, const MipSettings& mips, bool& isNew) {
+		std::lock_guard lock(mutex);
+
+		const auto pathKey = PathKey(canonicalPath, prototype, flip, mips);
+		// an unreadable file has no content hash, it must not match every other unreadable file
+		const uint64 contentKey = contentHash != 0 ? ContentKey(contentHash, prototype, flip, mips) : 0;
+
+		std::size_t found = entries.size();
+		if (auto it = byPath.find(pathKey); it != byPath.end()) {
+			found = it->second;
+			pathHits++;
+		}
+		else if (auto it = byContent.find(contentKey); contentKey != 0 && it != byContent.end()) {
+			found = it->second;
+			contentHits++;
+			byPath[pathKey] = found;
+		}
+
+		if (found < entries.size()) {
+			isNew = false;
+			return entries[found].texture;
+		}
+
+		auto texture = std::make_shared<Texture>();
+		texture->wrap = prototype.wrap;
+		texture->filter = prototype.filter;
+
+		byPath[pathKey] = entries.size();
+		if (contentKey != 0) byContent[contentKey] = entries.size();
+		entries.push_back({ texture, pathKey, contentKey });
+
+		isNew = true;
+		return texture;
+	}
+
+	std::shared_ptr<Texture> TextureCache::Load(const std::filesystem::path& path, int flip) {
+		std::vector<uchar> bytes;
+		if (!ReadFile(path, bytes)) {
 			return {};
 		}
 
-		return textures.at(name);
+		Texture prototype;
+		prototype.SetDefaultSampling();
+
+		bool isNew;
+		const auto hash = HashContents(bytes);
+		auto texture = Acquire(Canonical(path), hash, prototype, flip, {}, isNew);
+		if (isNew) {
+			texture->Upload(Decode(bytes, hash, {}, flip));
+		}
+		return texture;
+	}
+
+	std::shared_ptr<Texture> TextureCache::White() {
+		std::lock_guard lock(mutex);
+		if (!white) {
+			white = Texture::DummyTexture();
+		}
+		return white;
+	}
+
+	void TextureCache::Collect() {
+		std::lock_guard lock(mutex);
+
+		std::vector<Entry> kept;
+		kept.reserve(entries.size());
+		for (auto& entry : entries) {
+			if (entry.texture.use_count() > 1) {
+				kept.push_back(std::move(entry));
+			}
+			else {
+				entry.texture->Unload();
+			}
+		}
+
+		entries = std::move(kept);
+		byPath.clear();
+		byContent.clear();
+		for (std::size_t i = 0; i < entries.size(); ++i) {
+			byPath[entries[i].pathKey] = i;
+			if (entries[i].contentKey != 0) byContent[entries[i].contentKey] = i;
+		}
+	}
+
+	std::size_t TextureCache::GetResidentBytes() const {
+		std::lock_guard lock(mutex);
+		std::size_t bytes = 0;
+		for (const auto& entry : entries) {
+			bytes += entry.texture->GetByteSize();
+		}
+		return bytes;
+	}
+
+	std::size_t TextureCache::GetSavedBytes() const {
+		std::lock_guard lock(mutex);
+		std::size_t bytes = 0;
+		// every holder past the first would have needed a copy of its own, the cache's reference is not one
+		for (const auto& entry : entries) {
+			const auto holders = (std::size_t)entry.texture.use_count() - 1;
+			if (holders > 1) bytes += (holders - 1) * entry.texture->GetByteSize();
+		}
+		return bytes;
+	}
+
+	void TextureCache::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto mb = [](std::size_t bytes) { return bytes / (1024.0 * 1024.0); };
+		const auto resident = GetResidentBytes();
+		const auto saved = GetSavedBytes();
+
+		std::lock_guard lock(mutex);
+		out << std::fixed << std::setprecision(2)
+			<< "  " << entries.size() << " unique textures, " << mb(resident) << " MB resident\n"
+			<< "  " << pathHits << " path hits, " << contentHits << " content hits, "
+			<< mb(saved) << " MB of video memory saved\n";
+		out.flags(flags);
+	}
+
+	TextureManager::Handle TextureManager::Push(const std::string& name, const std::filesystem::path& path, int flip) {
+		auto texture = TextureCache::Get().Load(path, flip);
+		const auto id = Utils::StringId::FromString(name);
+		const auto [it, inserted] = slots.try_emplace(id, (uint32)textures.size());
+		if (inserted) {
+			textures.push_back(std::move(texture));
+		} else {
+			std::cerr << "[WARNING] Overwriting existing texture " << name << '\n';
+			textures[it->second] = std::move(texture);
+			TextureCache::Get().Collect();
+		}
+		return { it->second };
+	}
+
+	TextureManager::Handle TextureManager::Find(Utils::StringId name) const {
+		const auto it = slots.find(name);
+		if (it == slots.end()) {
+			std::cerr << "[ERROR] Trying to access nonexistent texture " << name.GetName()
+				<< " (0x" << std::hex << name.GetHash() << std::dec << ")\n";
+			return {};
+		}
+		return { it->second };
+	}
+
+	std::weak_ptr<Texture> TextureManager::Get(Utils::StringId name) const {
+		const auto h = Find(name);
+		if (!h.IsValid()) {
+			return {};
+		}
+		return textures[h.index];
 	}
 } // Resource
\ No newline at end of file
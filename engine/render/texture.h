@@ -3,16 +3,82 @@
 #include <GL/glew.h>
 
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "util/stringId.h"
 
 namespace fx::gltf {
 	struct Document;
 }
 
+namespace Utils {
+	class ThreadPool;
+}
+
 namespace Resource {
 
+	class StagingRing;
+	class TextureArray;
+
+	enum class PixelFormat {
+		RGBA8,
+		BC1,
+		BC3,
+		BC4,
+		BC5,
+		BC7,
+	};
+
+	// time spent in the block compressor against quality, High also switches color textures to BC7
+	enum class BCQuality {
+		Fast,
+		Normal,
+		High,
+	};
+
+	enum class MipFilter {
+		Box,
+		Kaiser,
+		Lanczos,
+	};
+
+	// how the CPU mip chain of an RGBA8 image is built
+	struct MipSettings {
+		MipFilter filter = MipFilter::Kaiser;
+		// color data is filtered in linear light, data textures (normals, roughness) as stored
+		bool srgb = false;
+		// alpha test threshold whose coverage every level keeps, negative when not alpha tested
+		float alphaCutoff = -1.0f;
+		// filter across the edges as GL_REPEAT samples them
+		bool wrap = true;
+	};
+
+	// CPU side pixels, every mip level stored back to back in pixels starting with the largest
+	struct ImageData {
+		struct Level {
+			int width;
+			int height;
+			std::size_t offset;
+			std::size_t size;
+		};
+
+		int width = 0;
+		int height = 0;
+		PixelFormat format = PixelFormat::RGBA8;
+		std::vector<Level> levels;
+		std::vector<uchar> pixels;
+
+		bool IsValid() const { return !pixels.empty() && !levels.empty(); }
+		bool IsCompressed() const { return format != PixelFormat::RGBA8; }
+		const uchar* LevelData(std::size_t i) const { return pixels.data() + levels[i].offset; }
+	};
+
 	class Texture {
 		struct Wrap {
 			GLint s;
@@ -23,37 +89,171 @@ namespace Resource {
 			GLint mag;
 		};
 
-		GLuint handle;
+		GLuint handle = 0;
 		Wrap wrap;
 		Filter filter;
-
+		int width = 0;
+		int height = 0;
+		PixelFormat format = PixelFormat::RGBA8;
+		// mips of the full chain, the GPU holds [residentLevel, levelCount)
+		int levelCount = 0;
+		int residentLevel = 0;
+		std::size_t byteSize = 0;
+		// set once the TextureArrayPacker moved the pixels into a layer of an array, handle is 0 then
+		std::shared_ptr<TextureArray> array;
+		int layer = -1;
 
 	public:
 		Texture() = default;
 		Texture(const std::filesystem::path& path, int flip = 0);
 		Texture(const std::filesystem::path& dir, const fx::gltf::Document& doc, int tex_i, int flip = 0);
+		// only sets up sampling, the pixels arrive later through Upload
+		Texture(const fx::gltf::Document& doc, int tex_i);
 		Texture(const Texture& other);
 		~Texture() = default;
 
-		static Texture DummyTexture();
+		static std::shared_ptr<Texture> DummyTexture();
+
+		// Decode is safe to call from any thread, Upload needs the GL context
+		static ImageData Decode(const std::filesystem::path& path, int flip = 0);
+		static ImageData Decode(const std::vector<uchar>& encoded, int flip = 0);
+		// dimensions from the header of a PNG/JPG without decoding it, false for anything else
+		static bool ReadSize(const std::vector<uchar>& encoded, int& width, int& height);
+		static std::filesystem::path PathFromGLTF(const std::filesystem::path& dir, const fx::gltf::Document& doc, int tex_i);
+		// with a staging ring the pixels are copied through it, falling back to client memory when it is full
+		void Upload(const ImageData& image, StagingRing* staging = nullptr);
+		// keeps mips [firstLevel, n) of a prebuilt chain on the GPU, levels already there are copied
+		// over on the GPU instead of being uploaded again
+		void Stream(const ImageData& image, int firstLevel, StagingRing* staging = nullptr);
+		bool IsResident() const { return handle != 0 || array; }
+		// packed textures only sample through their array, Bind binds the placeholder for them
+		const std::shared_ptr<TextureArray>& GetArray() const { return array; }
+		int GetLayer() const { return layer; }
+		int GetWidth() const { return width; }
+		int GetHeight() const { return height; }
+		GLint GetWrapS() const { return wrap.s; }
+		GLint GetWrapT() const { return wrap.t; }
+		int GetLevelCount() const { return levelCount; }
+		int GetResidentLevel() const { return residentLevel; }
+		// bytes of mip level of the full chain, resident or not
+		std::size_t LevelBytes(int level) const;
+		// bytes of video memory including the mip chain, 0 until uploaded
+		std::size_t GetByteSize() const;
 
 		Texture& operator=(const Texture& other);
 
 		void Unload();
 
 		void Bind(GLint loc = 0) const;
-		void UnBind() const;
 
 
 	private:
 		void LoadFromFile(const std::filesystem::path& path, int flip = 0);
 		void LoadFromGLTF(const std::filesystem::path& dir, const fx::gltf::Document& doc, int tex_i, int flip = 0);
 		void SetDefaultSampling();
-		void GenerateMipMapifNeeded() const;
+		void SetSamplingFromGLTF(const fx::gltf::Document& doc, int tex_i);
+		bool UsesMipmaps() const;
+		std::size_t ResidentBytes() const;
+		GLuint CreateStorage(int firstLevel) const;
+		void UploadLevels(GLuint texture, const ImageData& image, int from, int to, int firstLevel, StagingRing* staging) const;
+
+		static GLuint PlaceholderHandle();
+
+		friend class TextureCache;
+		friend class TextureArray;
+		friend class TextureArrayPacker;
 	};
 
+	// Engine-wide texture store. Textures are shared between everyone asking for the same file,
+	// found either by canonical path or, for copies living under a different name, by a hash of
+	// the file contents. The cache keeps one reference itself, Collect frees textures nobody else holds.
+	class TextureCache {
+	public:
+		// PNG/JPG sources are block compressed the first time they are seen and stored in cacheDir
+		// as DDS named by content hash, later runs read that file instead of decoding the source.
+		// The pool also builds the mip chains, with or without compression.
+		struct CompressionSettings {
+			bool enabled = false;
+			BCQuality quality = BCQuality::Normal;
+			std::filesystem::path cacheDir = "texcache";
+			Utils::ThreadPool* pool = nullptr;
+		};
+
+	private:
+		struct Entry {
+			std::shared_ptr<Texture> texture;
+			std::string pathKey;
+			// 0 when the file could not be read, such entries are only found by path
+			uint64 contentKey;
+		};
+
+		std::vector<Entry> entries;
+		std::unordered_map<std::string, std::size_t> byPath;
+		std::unordered_map<uint64, std::size_t> byContent;
+		std::shared_ptr<Texture> white;
+		std::size_t pathHits;
+		std::size_t contentHits;
+		CompressionSettings compression;
+		mutable std::mutex mutex;
+
+		TextureCache();
+
+	public:
+		TextureCache(const TextureCache&) = delete;
+		TextureCache(TextureCache&&) = delete;
+		~TextureCache() = default;
+
+		TextureCache& operator=(const TextureCache&) = delete;
+		TextureCache& operator=(TextureCache&&) = delete;
+
+		static TextureCache& Get();
+
+		static std::filesystem::path Canonical(const std::filesystem::path& path);
+		static uint64 HashContents(const std::vector<uchar>& bytes);
+		static bool ReadFile(const std::filesystem::path& path, std::vector<uchar>& bytes);
+
+		void SetCompression(const CompressionSettings& settings);
+		// Texture::Decode plus a CPU built mip chain, going through the compressed cache when it is enabled;
+		// safe to call from any thread
+		ImageData Decode(const std::vector<uchar>& encoded, uint64 contentHash, const MipSettings& mips = {}, int flip = 0) const;
+		// for RGBA8 images assembled in code, build only runs when the compressed cache has no copy
+		ImageData Decode(const std::function<ImageData()>& build, uint64 contentHash, const MipSettings& mips = {}, int flip = 0) const;
+		CompressionSettings GetCompression() const;
+
+		// sampling is taken from the prototype and mips are the settings the caller decodes with;
+		// isNew tells the caller it has to provide the pixels
+		std::shared_ptr<Texture> Acquire(const std::filesystem::path& canonicalPath, uint64 contentHash,
+			const Texture& prototype, int flip, const MipSettings& mips, bool& isNew);
+		// synchronous convenience for single files, needs the GL context
+		std::shared_ptr<Texture> Load(const std::filesystem::path& path, int flip = 0);
+		// the 1x1 white texture bound for missing material slots, needs the GL context
+		std::shared_ptr<Texture> White();
+
+		// unloads every texture only the cache still references, needs the GL context
+		void Collect();
+
+		std::size_t GetResidentBytes() const;
+		std::size_t GetSavedBytes() const;
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		static std::string PathKey(const std::filesystem::path& canonicalPath, const Texture& prototype, int flip, const MipSettings& mips);
+		static uint64 ContentKey(uint64 contentHash, const Texture& prototype, int flip, const MipSettings& mips);
+	};
+
+	// Textures by name, looked up the way ShaderManager looks up shaders
 	class TextureManager {
-		std::unordered_map<std::string, std::shared_ptr<Texture>> textures;
+	public:
+		struct Handle {
+			static constexpr uint32 invalidIndex = UINT32_MAX;
+			uint32 index = invalidIndex;
+
+			bool IsValid() const { return index != invalidIndex; }
+		};
+
+	private:
+		std::vector<std::shared_ptr<Texture>> textures;
+		std::unordered_map<Utils::StringId, uint32, Utils::StringIdHash> slots;
 
 	public:
 		TextureManager() = default;
@@ -64,8 +264,13 @@ namespace Resource {
 		TextureManager& operator=(const TextureManager&) = delete;
 		TextureManager& operator=(TextureManager&&) = delete;
 
-		void Push(const std::string& name, const std::filesystem::path& path, int flip = 0);
-		std::weak_ptr<Texture> Get(const std::string& name) const;
+		Handle Push(const std::string& name, const std::filesystem::path& path, int flip = 0);
+
+		// an invalid handle when no texture has that name
+		Handle Find(Utils::StringId name) const;
+		// nullptr for an invalid handle, valid until the name is pushed again
+		Texture* Get(Handle h) const { return h.IsValid() ? textures[h.index].get() : nullptr; }
+		std::weak_ptr<Texture> Get(Utils::StringId name) const;
 	};
 
-} // Resource
\ No newline at end of file
+} // Resource
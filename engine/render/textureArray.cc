@@ -0,0 +1,124 @@
+#include "config.h"
+#include "textureArray.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <tuple>
+
+#include "glState.h"
+#include "textureContainer.h"
+#include "virtualTexture.h"
+
+namespace Resource {
+
+	TextureArray::TextureArray(const Texture& prototype, int layers)
+		: format(prototype.format), width(prototype.width), height(prototype.height),
+		levels(prototype.levelCount), layers(layers) {
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &handle);
+		glTextureStorage3D(handle, levels, TextureContainer::GLInternalFormat(format), width, height, layers);
+		TextureContainer::SetSwizzle(handle, format);
+
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_S, prototype.wrap.s);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_T, prototype.wrap.t);
+		glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, prototype.filter.min);
+		glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, prototype.filter.mag);
+
+		float maxAniso{ 1.0f };
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAniso);
+		glTextureParameterf(handle, GL_TEXTURE_MAX_ANISOTROPY, maxAniso);
+	}
+
+	TextureArray::~TextureArray() {
+		Render::GLState::Get().ForgetTexture(handle);
+		glDeleteTextures(1, &handle);
+	}
+
+	void TextureArray::Bind(GLint unit) const {
+		Render::GLState::Get().BindTexture(unit, handle);
+	}
+
+	std::size_t TextureArray::GetLayerBytes() const {
+		std::size_t bytes = 0;
+		for (int l = 0; l < levels; ++l) {
+			bytes += TextureContainer::LevelSize(format, std::max(width >> l, 1), std::max(height >> l, 1));
+		}
+		return bytes;
+	}
+
+	TextureArrayPacker& TextureArrayPacker::Get() {
+		static TextureArrayPacker packer;
+		return packer;
+	}
+
+	std::size_t TextureArrayPacker::Pack(const std::vector<std::shared_ptr<Texture>>& textures) {
+		if (!settings.enabled) {
+			return 0;
+		}
+
+		// textures only share an array when every layer samples the same way
+		using Key = std::tuple<PixelFormat, int, int, int, GLint, GLint, GLint, GLint>;
+		std::map<Key, std::vector<Texture*>> groups;
+		for (const auto& texture : textures) {
+			if (!texture) continue;
+			const auto& t = *texture;
+			if (t.handle == 0 || t.array || t.residentLevel != 0 || VirtualTextureSystem::Get().IsVirtual(&t)) continue;
+
+			auto& group = groups[{ t.format, t.width, t.height, t.levelCount, t.wrap.s, t.wrap.t, t.filter.min, t.filter.mag }];
+			if (std::find(group.begin(), group.end(), &t) == group.end()) {
+				group.push_back(texture.get());
+			}
+		}
+
+		std::size_t packed = 0;
+		for (const auto& [key, group] : groups) {
+			if ((int)group.size() < settings.minLayers) continue;
+
+			auto array = std::make_shared<TextureArray>(*group.front(), (int)group.size());
+			for (int layer = 0; layer < (int)group.size(); ++layer) {
+				auto& texture = *group[layer];
+				for (int l = 0; l < texture.levelCount; ++l) {
+					glCopyImageSubData(texture.handle, GL_TEXTURE_2D, l, 0, 0, 0,
+						array->GetHandle(), GL_TEXTURE_2D_ARRAY, l, 0, 0, layer,
+						std::max(texture.width >> l, 1), std::max(texture.height >> l, 1), 1);
+				}
+
+				Render::GLState::Get().ForgetTexture(texture.handle);
+				glDeleteTextures(1, &texture.handle);
+				texture.handle = 0;
+				texture.array = array;
+				texture.layer = layer;
+			}
+
+			arrays.push_back(array);
+			packed += group.size();
+		}
+
+		std::erase_if(arrays, [](const auto& a) { return a.expired(); });
+		return packed;
+	}
+
+	void TextureArrayPacker::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		constexpr float64 MiB = 1024.0 * 1024.0;
+		std::size_t count = 0;
+		std::size_t layers = 0;
+		std::size_t bytes = 0;
+		for (const auto& weak : arrays) {
+			if (const auto array = weak.lock()) {
+				count++;
+				layers += array->GetLayers();
+				bytes += array->GetLayers() * array->GetLayerBytes();
+			}
+		}
+
+		out << std::fixed << std::setprecision(1)
+			<< "  " << count << " texture arrays holding " << layers << " textures, " << bytes / MiB << " MiB\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Resource
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "render/texture.h"
+
+namespace Resource {
+
+	// One GL_TEXTURE_2D_ARRAY holding textures of the same format, size, mip count and sampling
+	// as layers. Deleted with the last texture referencing it, needs the GL context then.
+	class TextureArray {
+		GLuint handle = 0;
+		PixelFormat format = PixelFormat::RGBA8;
+		int width = 0;
+		int height = 0;
+		int levels = 0;
+		int layers = 0;
+
+	public:
+		TextureArray(const Texture& prototype, int layers);
+		TextureArray(const TextureArray&) = delete;
+		TextureArray(TextureArray&&) = delete;
+		~TextureArray();
+
+		TextureArray& operator=(const TextureArray&) = delete;
+		TextureArray& operator=(TextureArray&&) = delete;
+
+		// binds only when a different array is on the unit, units used for arrays should not be
+		// bound through anything else
+		void Bind(GLint unit) const;
+
+		GLuint GetHandle() const { return handle; }
+		int GetLayers() const { return layers; }
+		// bytes of one layer with its mip chain
+		std::size_t GetLayerBytes() const;
+	};
+
+	// Moves fully resident textures that share format, size, mip count and sampling into texture
+	// arrays, on the GPU, so draws whose materials sample from the same arrays need no binding
+	// changes. The textures stay valid handles to their layer. Render thread only.
+	class TextureArrayPacker {
+	public:
+		struct Settings {
+			bool enabled = false;
+			// smaller groups stay plain 2D textures
+			int minLayers = 2;
+		};
+
+	private:
+		Settings settings;
+		std::vector<std::weak_ptr<TextureArray>> arrays;
+
+		TextureArrayPacker() = default;
+
+	public:
+		TextureArrayPacker(const TextureArrayPacker&) = delete;
+		TextureArrayPacker(TextureArrayPacker&&) = delete;
+		~TextureArrayPacker() = default;
+
+		TextureArrayPacker& operator=(const TextureArrayPacker&) = delete;
+		TextureArrayPacker& operator=(TextureArrayPacker&&) = delete;
+
+		static TextureArrayPacker& Get();
+
+		void SetSettings(const Settings& s) { settings = s; }
+		bool IsEnabled() const { return settings.enabled; }
+
+		// packs the textures not packed yet, skipping empty entries; returns how many moved into arrays
+		std::size_t Pack(const std::vector<std::shared_ptr<Texture>>& textures);
+
+		void PrintStats(std::ostream& out) const;
+	};
+
+} // Resource
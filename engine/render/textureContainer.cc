@@ -0,0 +1,257 @@
+#include "config.h"
+#include "textureContainer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace Resource::TextureContainer {
+
+	template<typename T>
+	static T Read(const std::vector<uchar>& bytes, std::size_t offset) {
+		T v;
+		std::memcpy(&v, bytes.data() + offset, sizeof(T));
+		return v;
+	}
+
+	static constexpr uint32 FourCC(char a, char b, char c, char d) {
+		return (uint32)a | ((uint32)b << 8) | ((uint32)c << 16) | ((uint32)d << 24);
+	}
+
+	static const uchar ktx2Identifier[12] = {
+		0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+	};
+
+	bool IsDDS(const std::vector<uchar>& bytes) {
+		return bytes.size() >= 4 && Read<uint32>(bytes, 0) == FourCC('D', 'D', 'S', ' ');
+	}
+
+	bool IsKTX2(const std::vector<uchar>& bytes) {
+		return bytes.size() >= sizeof(ktx2Identifier)
+			&& std::memcmp(bytes.data(), ktx2Identifier, sizeof(ktx2Identifier)) == 0;
+	}
+
+	std::size_t LevelSize(PixelFormat format, int width, int height) {
+		const std::size_t bw = (std::max(width, 1) + 3) / 4;
+		const std::size_t bh = (std::max(height, 1) + 3) / 4;
+		switch (format) {
+		case PixelFormat::RGBA8: return (std::size_t)std::max(width, 1) * std::max(height, 1) * 4;
+		case PixelFormat::BC1:
+		case PixelFormat::BC4: return bw * bh * 8;
+		case PixelFormat::BC3:
+		case PixelFormat::BC5:
+		case PixelFormat::BC7: return bw * bh * 16;
+		}
+		return 0;
+	}
+
+	GLenum GLInternalFormat(PixelFormat format) {
+		// sRGB variants map to the same linear formats the RGBA8 path uploads with
+		switch (format) {
+		case PixelFormat::RGBA8: return GL_RGBA8;
+		case PixelFormat::BC1: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case PixelFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case PixelFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case PixelFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		case PixelFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+		return GL_RGBA8;
+	}
+
+	void SetSwizzle(GLuint texture, PixelFormat format) {
+		// BCn::ChooseFormat only picks BC4 for gray images, sampled as (r, 0, 0, 1) they would turn red
+		if (format != PixelFormat::BC4) return;
+		const GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+
+	// lays out levelCount levels back to back starting at offset, levels that do not fit are dropped
+	static bool BuildLevels(const std::vector<uchar>& bytes, std::size_t offset, int levelCount, ImageData& image) {
+		int w = image.width;
+		int h = image.height;
+		for (int i = 0; i < levelCount; ++i) {
+			const auto size = LevelSize(image.format, w, h);
+			if (size > bytes.size() || offset > bytes.size() - size) break;
+
+			image.levels.push_back({ w, h, image.pixels.size(), size });
+			image.pixels.insert(image.pixels.end(), bytes.begin() + offset, bytes.begin() + offset + size);
+			offset += size;
+			w = std::max(w / 2, 1);
+			h = std::max(h / 2, 1);
+		}
+		return !image.levels.empty();
+	}
+
+	bool ReadDDS(const std::vector<uchar>& bytes, ImageData& image) {
+		constexpr std::size_t headerSize = 4 + 124;
+		if (!IsDDS(bytes) || bytes.size() < headerSize || Read<uint32>(bytes, 4) != 124) {
+			std::cerr << "[ERROR] malformed DDS header\n";
+			return false;
+		}
+
+		image = {};
+		image.height = (int)Read<uint32>(bytes, 12);
+		image.width = (int)Read<uint32>(bytes, 16);
+		const int mipCount = std::max((int)Read<uint32>(bytes, 28), 1);
+
+		// DDS_PIXELFORMAT starts at 76
+		const uint32 pfFlags = Read<uint32>(bytes, 80);
+		const uint32 fourCC = Read<uint32>(bytes, 84);
+		std::size_t offset = headerSize;
+
+		constexpr uint32 DDPF_FOURCC = 0x4;
+		constexpr uint32 DDPF_RGB = 0x40;
+		if (pfFlags & DDPF_FOURCC) {
+			switch (fourCC) {
+			case FourCC('D', 'X', 'T', '1'): image.format = PixelFormat::BC1; break;
+			case FourCC('D', 'X', 'T', '5'): image.format = PixelFormat::BC3; break;
+			case FourCC('A', 'T', 'I', '1'):
+			case FourCC('B', 'C', '4', 'U'): image.format = PixelFormat::BC4; break;
+			case FourCC('A', 'T', 'I', '2'):
+			case FourCC('B', 'C', '5', 'U'): image.format = PixelFormat::BC5; break;
+			case FourCC('D', 'X', '1', '0'): {
+				if (bytes.size() < headerSize + 20) {
+					std::cerr << "[ERROR] malformed DDS DX10 header\n";
+					return false;
+				}
+				switch (Read<uint32>(bytes, headerSize)) {
+				case 28: case 29: image.format = PixelFormat::RGBA8; break;
+				case 71: case 72: image.format = PixelFormat::BC1; break;
+				case 77: case 78: image.format = PixelFormat::BC3; break;
+				case 80: image.format = PixelFormat::BC4; break;
+				case 83: image.format = PixelFormat::BC5; break;
+				case 98: case 99: image.format = PixelFormat::BC7; break;
+				default:
+					std::cerr << "[ERROR] unsupported DDS DXGI format " << Read<uint32>(bytes, headerSize) << '\n';
+					return false;
+				}
+				offset += 20;
+				break;
+			}
+			default:
+				std::cerr << "[ERROR] unsupported DDS four character code\n";
+				return false;
+			}
+		}
+		else if ((pfFlags & DDPF_RGB) && Read<uint32>(bytes, 88) == 32 && Read<uint32>(bytes, 92) == 0x000000FF) {
+			image.format = PixelFormat::RGBA8;
+		}
+		else {
+			std::cerr << "[ERROR] unsupported DDS pixel format\n";
+			return false;
+		}
+
+		return BuildLevels(bytes, offset, mipCount, image);
+	}
+
+	bool ReadKTX2(const std::vector<uchar>& bytes, ImageData& image) {
+		constexpr std::size_t headerSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+		if (!IsKTX2(bytes) || bytes.size() < headerSize) {
+			std::cerr << "[ERROR] malformed KTX2 header\n";
+			return false;
+		}
+
+		image = {};
+		const uint32 vkFormat = Read<uint32>(bytes, 12);
+		image.width = (int)Read<uint32>(bytes, 20);
+		image.height = (int)Read<uint32>(bytes, 24);
+		const uint32 layerCount = Read<uint32>(bytes, 32);
+		const uint32 faceCount = Read<uint32>(bytes, 36);
+		const int levelCount = std::max((int)Read<uint32>(bytes, 40), 1);
+		const uint32 supercompression = Read<uint32>(bytes, 44);
+
+		if (supercompression != 0 || vkFormat == 0) {
+			std::cerr << "[ERROR] supercompressed (Basis/zstd) KTX2 files are not supported\n";
+			return false;
+		}
+		if (layerCount > 1 || faceCount != 1) {
+			std::cerr << "[ERROR] only single layer 2D KTX2 textures are supported\n";
+			return false;
+		}
+
+		switch (vkFormat) {
+		case 37: case 43: image.format = PixelFormat::RGBA8; break;
+		case 131: case 132: case 133: case 134: image.format = PixelFormat::BC1; break;
+		case 137: case 138: image.format = PixelFormat::BC3; break;
+		case 139: image.format = PixelFormat::BC4; break;
+		case 141: image.format = PixelFormat::BC5; break;
+		case 145: case 146: image.format = PixelFormat::BC7; break;
+		default:
+			std::cerr << "[ERROR] unsupported KTX2 vkFormat " << vkFormat << '\n';
+			return false;
+		}
+
+		// the level index follows the header, each level is stored at its own offset
+		if (bytes.size() < headerSize + (std::size_t)levelCount * 24) {
+			std::cerr << "[ERROR] malformed KTX2 level index\n";
+			return false;
+		}
+
+		int w = image.width;
+		int h = image.height;
+		for (int i = 0; i < levelCount; ++i) {
+			const auto offset = (std::size_t)Read<uint64>(bytes, headerSize + i * 24);
+			const auto size = LevelSize(image.format, w, h);
+			if (size > bytes.size() || offset > bytes.size() - size) break;
+
+			image.levels.push_back({ w, h, image.pixels.size(), size });
+			image.pixels.insert(image.pixels.end(), bytes.begin() + offset, bytes.begin() + offset + size);
+			w = std::max(w / 2, 1);
+			h = std::max(h / 2, 1);
+		}
+
+		return !image.levels.empty();
+	}
+
+	template<typename T>
+	static void Write(std::vector<uchar>& bytes, std::size_t offset, T v) {
+		std::memcpy(bytes.data() + offset, &v, sizeof(T));
+	}
+
+	std::vector<uchar> WriteDDS(const ImageData& image) {
+		constexpr std::size_t headerSize = 4 + 124;
+		uint32 fourCC = 0;
+		uint32 dxgiFormat = 0;
+		switch (image.format) {
+		case PixelFormat::BC1: fourCC = FourCC('D', 'X', 'T', '1'); break;
+		case PixelFormat::BC3: fourCC = FourCC('D', 'X', 'T', '5'); break;
+		case PixelFormat::BC4: fourCC = FourCC('A', 'T', 'I', '1'); break;
+		case PixelFormat::BC5: fourCC = FourCC('A', 'T', 'I', '2'); break;
+		case PixelFormat::BC7: fourCC = FourCC('D', 'X', '1', '0'); dxgiFormat = 98; break;
+		case PixelFormat::RGBA8: fourCC = FourCC('D', 'X', '1', '0'); dxgiFormat = 28; break;
+		}
+
+		const std::size_t dataOffset = headerSize + (dxgiFormat != 0 ? 20 : 0);
+		std::vector<uchar> bytes(dataOffset, 0);
+
+		constexpr uint32 DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000,
+			DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+		constexpr uint32 DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+		const bool mipmapped = image.levels.size() > 1;
+
+		Write<uint32>(bytes, 0, FourCC('D', 'D', 'S', ' '));
+		Write<uint32>(bytes, 4, 124);
+		Write<uint32>(bytes, 8, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE);
+		Write<uint32>(bytes, 12, (uint32)image.height);
+		Write<uint32>(bytes, 16, (uint32)image.width);
+		Write<uint32>(bytes, 20, (uint32)image.levels[0].size);
+		Write<uint32>(bytes, 28, (uint32)image.levels.size());
+		Write<uint32>(bytes, 76, 32);
+		Write<uint32>(bytes, 80, 0x4); // DDPF_FOURCC
+		Write<uint32>(bytes, 84, fourCC);
+		Write<uint32>(bytes, 108, DDSCAPS_TEXTURE | (mipmapped ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+
+		if (dxgiFormat != 0) {
+			Write<uint32>(bytes, headerSize, dxgiFormat);
+			Write<uint32>(bytes, headerSize + 4, 3); // DDS_DIMENSION_TEXTURE2D
+			Write<uint32>(bytes, headerSize + 12, 1); // array size
+		}
+
+		for (std::size_t i = 0; i < image.levels.size(); ++i) {
+			const uchar* level = image.LevelData(i);
+			bytes.insert(bytes.end(), level, level + image.levels[i].size);
+		}
+		return bytes;
+	}
+
+} // Resource::TextureContainer
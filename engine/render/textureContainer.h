@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include "render/texture.h"
+
+namespace Resource {
+
+	// Readers for GPU ready texture containers holding BC1/BC3/BC4/BC5/BC7 (or plain RGBA8)
+	// with their mip chains already built. They only look at bytes, no GL context is needed
+	// except for SetSwizzle.
+	namespace TextureContainer {
+
+		bool IsDDS(const std::vector<uchar>& bytes);
+		bool IsKTX2(const std::vector<uchar>& bytes);
+
+		bool ReadDDS(const std::vector<uchar>& bytes, ImageData& image);
+		bool ReadKTX2(const std::vector<uchar>& bytes, ImageData& image);
+
+		// DDS with the whole mip chain, a DX10 header is only written where no four character code exists (BC7)
+		std::vector<uchar> WriteDDS(const ImageData& image);
+
+		// bytes of a single level, 4x4 blocks for the BC formats
+		std::size_t LevelSize(PixelFormat format, int width, int height);
+		GLenum GLInternalFormat(PixelFormat format);
+		// on a texture just created with the format's storage, BC4 reads back gray instead of red only
+		void SetSwizzle(GLuint texture, PixelFormat format);
+
+	} // TextureContainer
+
+} // Resource
@@ -0,0 +1,173 @@
+#include "config.h"
+#include "textureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace Resource {
+
+	TextureStreamer::TextureStreamer()
+		: frame(0), loads(0), evictions(0) {
+	}
+
+	TextureStreamer& TextureStreamer::Get() {
+		static TextureStreamer streamer;
+		return streamer;
+	}
+
+	std::size_t TextureStreamer::BytesFrom(const Texture& texture, int level) {
+		std::size_t bytes = 0;
+		for (int l = level; l < texture.GetLevelCount(); ++l) {
+			bytes += texture.LevelBytes(l);
+		}
+		return bytes;
+	}
+
+	bool TextureStreamer::Register(const std::shared_ptr<Texture>& texture, std::shared_ptr<const ImageData> source,
+		StagingRing* staging) {
+		if (!settings.enabled || !source || source->levels.size() < 2) {
+			return false;
+		}
+
+		int coarsest = 0;
+		while (coarsest + 1 < (int)source->levels.size()
+			&& std::max(source->levels[coarsest].width, source->levels[coarsest].height) > settings.residentSize) {
+			coarsest++;
+		}
+
+		texture->Stream(*source, coarsest, staging);
+		entries[texture.get()] = { texture, std::move(source), (float)coarsest, frame, coarsest, coarsest, false };
+		return true;
+	}
+
+	void TextureStreamer::Request(const Texture* texture, float mip) {
+		const auto it = entries.find(texture);
+		if (it == entries.end()) {
+			return;
+		}
+
+		auto& entry = it->second;
+		if (entry.lastRequest != frame) {
+			entry.requested = mip;
+			entry.lastRequest = frame;
+		}
+		else {
+			entry.requested = std::min(entry.requested, mip);
+		}
+	}
+
+	void TextureStreamer::Update(UploadQueue& queue) {
+		// wanted mips from this frame's requests, textures nobody asked for in a while fall back to their resident mips
+		std::size_t total = 0;
+		for (auto it = entries.begin(); it != entries.end();) {
+			auto texture = it->second.texture.lock();
+			if (!texture || !texture->IsResident()) {
+				it = entries.erase(it);
+				continue;
+			}
+
+			auto& entry = it->second;
+			if (frame - entry.lastRequest > settings.evictAfterFrames) {
+				entry.target = entry.coarsest;
+			}
+			else if (entry.lastRequest == frame) {
+				int wanted = std::clamp((int)std::floor(entry.requested), 0, entry.coarsest);
+				// some slack before dropping detail, a texture on the edge between two mips would flip every frame
+				const int resident = texture->GetResidentLevel();
+				if (wanted > resident && entry.requested < resident + 1.5f) {
+					wanted = resident;
+				}
+				entry.target = wanted;
+			}
+			total += BytesFrom(*texture, entry.target);
+			++it;
+		}
+
+		// over budget, give up the finest level where it is largest relative to how recently it was wanted
+		while (total > settings.budgetBytes) {
+			Entry* victim = nullptr;
+			float64 worst = 0.0;
+			for (auto& [key, entry] : entries) {
+				if (entry.target >= entry.coarsest) continue;
+				const float64 cost = (float64)key->LevelBytes(entry.target) * (1.0 + (float64)(frame - entry.lastRequest));
+				if (cost > worst) {
+					worst = cost;
+					victim = &entry;
+				}
+			}
+			if (victim == nullptr) break;
+
+			const auto texture = victim->texture.lock();
+			total -= texture->LevelBytes(victim->target);
+			victim->target++;
+		}
+
+		for (auto& [key, entry] : entries) {
+			auto texture = entry.texture.lock();
+			const int resident = texture->GetResidentLevel();
+
+			if (entry.target > resident) {
+				// dropping detail only copies on the GPU, it frees memory right away
+				texture->Stream(*entry.source, entry.target);
+				evictions++;
+			}
+			else if (entry.target < resident && !entry.loading) {
+				const std::size_t bytes = BytesFrom(*texture, entry.target) - BytesFrom(*texture, resident);
+				entry.loading = true;
+				queue.Push([this, key, weak = entry.texture, &queue] {
+					const auto it = entries.find(key);
+					auto texture = weak.lock();
+					if (it == entries.end() || !texture || it->second.texture.lock() != texture) return;
+
+					// the target may have moved on while the job waited
+					it->second.loading = false;
+					if (it->second.target < texture->GetResidentLevel()) {
+						texture->Stream(*it->second.source, it->second.target, &queue.Staging());
+						loads++;
+					}
+				}, bytes);
+			}
+		}
+
+		frame++;
+	}
+
+	std::size_t TextureStreamer::GetResidentBytes() const {
+		std::size_t bytes = 0;
+		for (const auto& [key, entry] : entries) {
+			if (auto texture = entry.texture.lock()) {
+				bytes += texture->GetByteSize();
+			}
+		}
+		return bytes;
+	}
+
+	std::size_t TextureStreamer::GetFullBytes() const {
+		std::size_t bytes = 0;
+		for (const auto& [key, entry] : entries) {
+			if (auto texture = entry.texture.lock()) {
+				bytes += BytesFrom(*texture, 0);
+			}
+		}
+		return bytes;
+	}
+
+	void TextureStreamer::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		constexpr float64 MiB = 1024.0 * 1024.0;
+		const auto resident = GetResidentBytes();
+		const auto full = GetFullBytes();
+		out << std::fixed << std::setprecision(1)
+			<< "  " << entries.size() << " streamed textures, " << resident / MiB << " of " << full / MiB
+			<< " MiB resident (" << (full > 0 ? 100.0 * resident / full : 0.0) << "%), budget "
+			<< settings.budgetBytes / MiB << " MiB\n"
+			<< "  " << loads << " loads, " << evictions << " evictions\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Resource
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
+#include "render/texture.h"
+#include "render/uploadQueue.h"
+
+namespace Resource {
+
+	// Keeps only the mips of each streamed texture that its largest on-screen footprint needs.
+	// Draw code reports the finest mip it would sample every frame, Update fits the wanted mips
+	// into the VRAM budget, drops detail right away and loads it through the upload queue.
+	// The full chains stay in system memory. Render thread only.
+	class TextureStreamer {
+	public:
+		struct Settings {
+			bool enabled = false;
+			// video memory for all streamed textures together
+			std::size_t budgetBytes = 256 << 20;
+			// mips this size and smaller never leave, so there is always something to sample
+			int residentSize = 64;
+			// frames without a request before a texture drops to its resident mips
+			uint64 evictAfterFrames = 120;
+		};
+
+	private:
+		struct Entry {
+			std::weak_ptr<Texture> texture;
+			std::shared_ptr<const ImageData> source;
+			float requested;
+			uint64 lastRequest;
+			int coarsest;
+			int target;
+			bool loading;
+		};
+
+		Settings settings;
+		std::unordered_map<const Texture*, Entry> entries;
+		uint64 frame;
+		std::size_t loads;
+		std::size_t evictions;
+
+		TextureStreamer();
+
+	public:
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer(TextureStreamer&&) = delete;
+		~TextureStreamer() = default;
+
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(TextureStreamer&&) = delete;
+
+		static TextureStreamer& Get();
+
+		void SetSettings(const Settings& s) { settings = s; }
+		bool IsEnabled() const { return settings.enabled; }
+
+		// uploads only the resident mips of the chain now, returns false for images that cannot stream
+		bool Register(const std::shared_ptr<Texture>& texture, std::shared_ptr<const ImageData> source, StagingRing* staging);
+		// mip is fractional, 0 asks for full detail
+		void Request(const Texture* texture, float mip);
+		// once per frame after every Request
+		void Update(UploadQueue& queue);
+
+		std::size_t GetResidentBytes() const;
+		// what the streamed textures would take fully resident
+		std::size_t GetFullBytes() const;
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		static std::size_t BytesFrom(const Texture& texture, int level);
+	};
+
+} // Resource
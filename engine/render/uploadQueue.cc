@@ -0,0 +1,116 @@
+#include "config.h"
+#include "uploadQueue.h"
+
+#include <chrono>
+#include <iomanip>
+
+namespace Resource {
+
+	UploadQueue::UploadQueue(std::size_t capacity)
+		: capacity(capacity), renderThread(std::this_thread::get_id()) {
+	}
+
+	void UploadQueue::Push(std::function<void()> job, std::size_t bytes) {
+		std::unique_lock lock(mutex);
+		// the render thread is the consumer, blocking it here would never wake up again
+		if (!IsRenderThread()) {
+			notFull.wait(lock, [this] { return jobs.size() < capacity; });
+		}
+		jobs.push_back({ std::move(job), bytes });
+	}
+
+	std::size_t UploadQueue::Flush(float64 budgetMs, std::size_t byteBudget) {
+		using clock = std::chrono::steady_clock;
+		const auto start = clock::now();
+
+		std::size_t count = 0;
+		std::size_t bytes = 0;
+		bool deferred = false;
+		while (true) {
+			Job job;
+			{
+				std::lock_guard lock(mutex);
+				if (jobs.empty()) break;
+				// a job larger than the whole budget still goes through, alone in its frame
+				if (count > 0 && bytes + jobs.front().bytes > byteBudget) {
+					deferred = true;
+					break;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			notFull.notify_one();
+
+			job.run();
+			count++;
+			bytes += job.bytes;
+
+			const std::chrono::duration<float64, std::milli> elapsed = clock::now() - start;
+			if (elapsed.count() >= budgetMs) break;
+		}
+
+		if (staging) {
+			staging->Fence();
+		}
+
+		if (count > 0) {
+			const std::chrono::duration<float64, std::milli> elapsed = clock::now() - start;
+			stats.jobs += count;
+			stats.bytes += bytes;
+			stats.busyMs += elapsed.count();
+		}
+		stats.lastFrameBytes = bytes;
+		if (deferred) stats.deferredFrames++;
+		return count;
+	}
+
+	void UploadQueue::Discard() {
+		{
+			std::lock_guard lock(mutex);
+			jobs.clear();
+		}
+		notFull.notify_all();
+
+		if (staging) {
+			staging->Abandon();
+			staging.reset();
+		}
+	}
+
+	void UploadQueue::ReleaseStaging() {
+		staging.reset();
+	}
+
+	StagingRing& UploadQueue::Staging() {
+		if (!staging) {
+			staging = std::make_unique<StagingRing>();
+		}
+		return *staging;
+	}
+
+	void UploadQueue::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		constexpr float64 MiB = 1024.0 * 1024.0;
+		out << std::fixed << std::setprecision(1)
+			<< "  " << stats.jobs << " uploads, " << stats.bytes / MiB << " MiB in " << stats.busyMs << " ms";
+		if (stats.busyMs > 0.0) {
+			out << " (" << stats.bytes / MiB / (stats.busyMs / 1000.0) << " MiB/s)";
+		}
+		out << ", " << stats.deferredFrames << " frames hit the byte budget\n";
+		if (staging) {
+			out << "  staging ring " << staging->GetSize() / MiB << " MiB, " << staging->GetStagedBytes() / MiB
+				<< " MiB staged, " << staging->GetStalls() << " uploads fell back to client memory\n";
+		}
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+	std::size_t UploadQueue::Pending() const {
+		std::lock_guard lock(mutex);
+		return jobs.size();
+	}
+
+} // Resource
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+#include "render/stagingRing.h"
+
+namespace Resource {
+
+	// Jobs that have to run on the thread owning the GL context. Worker threads block in Push
+	// while the queue is full, the render thread drains it with Flush under a per-frame time and
+	// byte budget. Texture jobs copy through the queue's staging ring instead of client memory.
+	class UploadQueue {
+	public:
+		struct Stats {
+			std::size_t jobs = 0;
+			std::size_t bytes = 0;
+			std::size_t lastFrameBytes = 0;
+			std::size_t deferredFrames = 0;
+			float64 busyMs = 0.0;
+		};
+
+	private:
+		struct Job {
+			std::function<void()> run;
+			std::size_t bytes;
+		};
+
+		std::deque<Job> jobs;
+		std::size_t capacity;
+		std::thread::id renderThread;
+		mutable std::mutex mutex;
+		std::condition_variable notFull;
+		std::unique_ptr<StagingRing> staging;
+		Stats stats;
+
+	public:
+		// must be constructed on the render thread
+		explicit UploadQueue(std::size_t capacity = 64);
+		UploadQueue(const UploadQueue&) = delete;
+		UploadQueue(UploadQueue&&) = delete;
+		~UploadQueue() = default;
+
+		UploadQueue& operator=(const UploadQueue&) = delete;
+		UploadQueue& operator=(UploadQueue&&) = delete;
+
+		// bytes is what the job sends to the GPU, counted against the byte budget of Flush
+		void Push(std::function<void()> job, std::size_t bytes = 0);
+
+		// runs queued jobs until budgetMs or byteBudget is used up, at least one job always runs;
+		// returns the number of jobs run
+		std::size_t Flush(float64 budgetMs, std::size_t byteBudget = std::numeric_limits<std::size_t>::max());
+
+		// drops every queued job, for shutting down after the GL context is gone
+		void Discard();
+		// deletes the staging ring, needs the GL context
+		void ReleaseStaging();
+
+		std::size_t Pending() const;
+		bool IsRenderThread() const { return std::this_thread::get_id() == renderThread; }
+
+		// created on first use, render thread only
+		StagingRing& Staging();
+
+		const Stats& GetStats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+
+		// co_await queue.Schedule() continues the coroutine on the render thread during the next Flush
+		auto Schedule() {
+			struct Awaiter {
+				UploadQueue& queue;
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> h) { queue.Push([h] { h.resume(); }); }
+				void await_resume() const noexcept {}
+			};
+			return Awaiter{ *this };
+		}
+	};
+
+} // Resource
@@ -0,0 +1,528 @@
+#include "config.h"
+#include "virtualTexture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+#include "glState.h"
+#include "textureContainer.h"
+#include "util/threadPool.h"
+
+namespace Resource {
+
+	VirtualTextureSystem::VirtualTextureSystem()
+		: current(0), feedbackWidth(0), feedbackHeight(0), jitter(0), frame(1), generations(0) {
+	}
+
+	VirtualTextureSystem& VirtualTextureSystem::Get() {
+		static VirtualTextureSystem system;
+		return system;
+	}
+
+	VirtualTextureSystem::PageKey VirtualTextureSystem::MakeKey(int id, int level, int x, int y) {
+		return ((PageKey)id << 20) | ((PageKey)level << 16) | ((PageKey)x << 8) | (PageKey)y;
+	}
+
+	int VirtualTextureSystem::PageLevels(const ImageData& image) {
+		const auto isPow2 = [](int v) { return v > 0 && (v & (v - 1)) == 0; };
+		if (!isPow2(image.width) || !isPow2(image.height) || std::min(image.width, image.height) < pageSize
+			|| std::max(image.width, image.height) > pageSize * 256) {
+			return 0;
+		}
+
+		// levels down to the one whose smaller side is a single page, every page stays full
+		int levels = 1;
+		while ((std::min(image.width, image.height) >> levels) >= pageSize) {
+			levels++;
+		}
+		return (int)image.levels.size() >= levels && levels <= 16 ? levels : 0;
+	}
+
+	// texel (or block) v of a row of size as a sampler with the wrap mode reads it
+	static int Address(int v, int size, GLint mode) {
+		switch (mode) {
+		case GL_CLAMP_TO_EDGE:
+		case GL_CLAMP_TO_BORDER:
+			return std::clamp(v, 0, size - 1);
+		case GL_MIRRORED_REPEAT: {
+			const int m = (v % (2 * size) + 2 * size) % (2 * size);
+			return m < size ? m : 2 * size - 1 - m;
+		}
+		default:
+			return (v % size + size) % size;
+		}
+	}
+
+	std::vector<uchar> VirtualTextureSystem::CutPage(const ImageData& image, int level, int x, int y, GLint wrapS, GLint wrapT) {
+		// whole 4x4 blocks for the BC formats, the border keeps them aligned; their clamped or mirrored
+		// borders repeat the edge block as is, which still never reads the opposite edge
+		const int block = image.IsCompressed() ? 4 : 1;
+		const std::size_t blockBytes = TextureContainer::LevelSize(image.format, block, block);
+		const int levelWidth = image.levels[level].width / block;
+		const int levelHeight = image.levels[level].height / block;
+		const int n = physicalPageSize / block;
+		const int firstX = (x * pageSize - pageBorder) / block;
+		const int firstY = (y * pageSize - pageBorder) / block;
+
+		std::vector<uchar> page(n * n * blockBytes);
+		const uchar* src = image.LevelData(level);
+		for (int r = 0; r < n; ++r) {
+			const uchar* row = src + (std::size_t)Address(firstY + r, levelHeight, wrapT) * levelWidth * blockBytes;
+			uchar* dst = page.data() + (std::size_t)r * n * blockBytes;
+			// runs of consecutive source texels, only the borders at the edges break them up
+			for (int c = 0; c < n;) {
+				const int sx = Address(firstX + c, levelWidth, wrapS);
+				int run = 1;
+				while (c + run < n && Address(firstX + c + run, levelWidth, wrapS) == sx + run) run++;
+				std::memcpy(dst + c * blockBytes, row + sx * blockBytes, run * blockBytes);
+				c += run;
+			}
+		}
+		return page;
+	}
+
+	VirtualTextureSystem::Atlas& VirtualTextureSystem::AtlasFor(PixelFormat format) {
+		auto& atlas = atlases[format];
+		if (atlas.handle != 0) {
+			return atlas;
+		}
+
+		// indirection entries hold the slot position in 8 bits
+		atlas.perSide = std::clamp(settings.atlasPages, 1, 255);
+		const int size = atlas.perSide * physicalPageSize;
+		glCreateTextures(GL_TEXTURE_2D, 1, &atlas.handle);
+		glTextureStorage2D(atlas.handle, 1, TextureContainer::GLInternalFormat(format), size, size);
+		TextureContainer::SetSwizzle(atlas.handle, format);
+		glTextureParameteri(atlas.handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(atlas.handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(atlas.handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(atlas.handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		atlas.slots.assign(atlas.perSide * atlas.perSide, {});
+		atlas.free.resize(atlas.slots.size());
+		for (std::size_t i = 0; i < atlas.free.size(); ++i) {
+			atlas.free[i] = (int)(atlas.free.size() - 1 - i);
+		}
+		return atlas;
+	}
+
+	int VirtualTextureSystem::AllocateSlot(Atlas& atlas) {
+		if (!atlas.free.empty()) {
+			const int slot = atlas.free.back();
+			atlas.free.pop_back();
+			return slot;
+		}
+
+		// least recently used page that neither this nor the last frame asked for
+		int victim = -1;
+		for (int i = 0; i < (int)atlas.slots.size(); ++i) {
+			const auto& slot = atlas.slots[i];
+			if (slot.pinned || slot.lastUsed + 1 >= frame) continue;
+			if (victim < 0 || slot.lastUsed < atlas.slots[victim].lastUsed) {
+				victim = i;
+			}
+		}
+		if (victim < 0) {
+			return -1;
+		}
+
+		const PageKey key = atlas.slots[victim].key;
+		auto& vt = textures[key >> 20];
+		const int level = (key >> 16) & 0xF;
+		vt.pages[level][(key & 0xFF) * std::max(vt.pagesX >> level, 1) + ((key >> 8) & 0xFF)] = -1;
+		vt.dirty = true;
+		stats.evictions++;
+		return victim;
+	}
+
+	bool VirtualTextureSystem::Register(const std::shared_ptr<Texture>& texture, std::shared_ptr<const ImageData> source,
+		StagingRing* staging) {
+		if (!settings.enabled || !source || byTexture.size() >= maxTextures) {
+			return false;
+		}
+		const int levels = PageLevels(*source);
+		if (levels == 0) {
+			return false;
+		}
+
+		// the coarsest level stays resident for good, every other page falls back to it
+		const int coarsest = levels - 1;
+		const int coarseX = (source->width / pageSize) >> coarsest;
+		const int coarseY = (source->height / pageSize) >> coarsest;
+		if ((int)AtlasFor(source->format).free.size() < coarseX * coarseY) {
+			return false;
+		}
+
+		int id;
+		if (freeIds.empty()) {
+			id = (int)textures.size();
+			textures.emplace_back();
+		}
+		else {
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+
+		auto& vt = textures[id];
+		vt.texture = texture;
+		vt.source = source;
+		vt.generation = ++generations;
+		vt.pagesX = source->width / pageSize;
+		vt.pagesY = source->height / pageSize;
+		vt.levels = levels;
+		vt.wrapS = texture->GetWrapS();
+		vt.wrapT = texture->GetWrapT();
+		vt.pages.resize(levels);
+		for (int l = 0; l < levels; ++l) {
+			vt.pages[l].assign(std::max(vt.pagesX >> l, 1) * std::max(vt.pagesY >> l, 1), -1);
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &vt.indirection);
+		glTextureStorage2D(vt.indirection, levels, GL_RGBA8UI, vt.pagesX, vt.pagesY);
+		glTextureParameteri(vt.indirection, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(vt.indirection, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		byTexture[texture.get()] = id;
+
+		for (int y = 0; y < coarseY; ++y) {
+			for (int x = 0; x < coarseX; ++x) {
+				Commit(MakeKey(id, coarsest, x, y), vt.generation, CutPage(*source, coarsest, x, y, vt.wrapS, vt.wrapT), true);
+			}
+		}
+
+		// shaders sampling the texture directly get the mips up to a page
+		int first = 0;
+		while (first + 1 < (int)source->levels.size()
+			&& std::max(source->levels[first].width, source->levels[first].height) > pageSize) {
+			first++;
+		}
+		texture->Stream(*source, first, staging);
+		return true;
+	}
+
+	void VirtualTextureSystem::Commit(PageKey key, uint32 generation, const std::vector<uchar>& page, bool pinned) {
+		loading.erase(key);
+		const std::size_t id = key >> 20;
+		if (id >= textures.size() || textures[id].generation != generation || !textures[id].source) {
+			return;
+		}
+
+		auto& vt = textures[id];
+		const int level = (key >> 16) & 0xF;
+		auto& entry = vt.pages[level][(key & 0xFF) * std::max(vt.pagesX >> level, 1) + ((key >> 8) & 0xFF)];
+		if (entry >= 0) {
+			return;
+		}
+
+		const auto format = vt.source->format;
+		auto& atlas = AtlasFor(format);
+		const int slot = AllocateSlot(atlas);
+		if (slot < 0) {
+			stats.thrashed++;
+			return;
+		}
+
+		atlas.slots[slot] = { key, frame, pinned };
+		entry = slot;
+		vt.dirty = true;
+		if (!pinned) {
+			stats.loads++;
+		}
+
+		const GLint x = (slot % atlas.perSide) * physicalPageSize;
+		const GLint y = (slot / atlas.perSide) * physicalPageSize;
+		if (format == PixelFormat::RGBA8) {
+			glTextureSubImage2D(atlas.handle, 0, x, y, physicalPageSize, physicalPageSize, GL_RGBA, GL_UNSIGNED_BYTE, page.data());
+		}
+		else {
+			glCompressedTextureSubImage2D(atlas.handle, 0, x, y, physicalPageSize, physicalPageSize,
+				TextureContainer::GLInternalFormat(format), (GLsizei)page.size(), page.data());
+		}
+	}
+
+	void VirtualTextureSystem::Release(int id) {
+		auto& vt = textures[id];
+		auto& atlas = atlases[vt.source->format];
+		for (int i = 0; i < (int)atlas.slots.size(); ++i) {
+			if (atlas.slots[i].key != noPage && (int)(atlas.slots[i].key >> 20) == id) {
+				atlas.slots[i] = {};
+				atlas.free.push_back(i);
+			}
+		}
+
+		std::erase_if(byTexture, [id](const auto& entry) { return entry.second == id; });
+		Render::GLState::Get().ForgetTexture(vt.indirection);
+		glDeleteTextures(1, &vt.indirection);
+		vt = {};
+		freeIds.push_back(id);
+	}
+
+	void VirtualTextureSystem::ReadFeedback(Readback& readback) {
+		const std::size_t first = requested.size();
+		requested.resize(first + readback.entries);
+		glGetNamedBufferSubData(readback.buffer, 0, readback.entries * sizeof(PageKey), requested.data() + first);
+		glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+	}
+
+	void VirtualTextureSystem::Update(UploadQueue& queue, Utils::ThreadPool* pool) {
+		if (!settings.enabled) {
+			return;
+		}
+
+		for (int id = 0; id < (int)textures.size(); ++id) {
+			if (!textures[id].source) continue;
+			const auto texture = textures[id].texture.lock();
+			if (!texture || !texture->IsResident()) {
+				Release(id);
+			}
+		}
+
+		for (auto& readback : readbacks) {
+			if (readback.fence == nullptr) continue;
+			const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+			if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+				ReadFeedback(readback);
+			}
+		}
+		if (requested.empty()) {
+			frame++;
+			return;
+		}
+
+		// every requested page wants its parents too, they are what it falls back to until it lands
+		std::unordered_set<PageKey> wanted;
+		for (const auto key : requested) {
+			const std::size_t id = key >> 20;
+			if (key == noPage || id >= textures.size() || !textures[id].source) continue;
+
+			const auto& vt = textures[id];
+			const int level = (key >> 16) & 0xF;
+			const int x = (key >> 8) & 0xFF;
+			const int y = key & 0xFF;
+			if (level >= vt.levels || x >= std::max(vt.pagesX >> level, 1) || y >= std::max(vt.pagesY >> level, 1)) continue;
+
+			for (int l = level; l < vt.levels; ++l) {
+				if (!wanted.insert(MakeKey((int)id, l, x >> (l - level), y >> (l - level))).second) break;
+			}
+		}
+		requested.clear();
+		stats.requests = wanted.size();
+
+		std::vector<PageKey> missing;
+		for (const auto key : wanted) {
+			const auto& vt = textures[key >> 20];
+			const int level = (key >> 16) & 0xF;
+			const int slot = vt.pages[level][(key & 0xFF) * std::max(vt.pagesX >> level, 1) + ((key >> 8) & 0xFF)];
+			if (slot >= 0) {
+				atlases[vt.source->format].slots[slot].lastUsed = frame;
+			}
+			else if (!loading.contains(key)) {
+				missing.push_back(key);
+			}
+		}
+
+		// coarse pages first, each one improves everything below it
+		std::sort(missing.begin(), missing.end(), [](PageKey a, PageKey b) {
+			return ((a >> 16) & 0xF) > ((b >> 16) & 0xF);
+		});
+
+		const int room = std::min(settings.loadsPerFrame, settings.maxInFlight - (int)loading.size());
+		for (int i = 0; i < std::min(room, (int)missing.size()); ++i) {
+			const PageKey key = missing[i];
+			const auto& vt = textures[key >> 20];
+			loading.insert(key);
+
+			auto cut = [this, key, generation = vt.generation, source = vt.source, wrapS = vt.wrapS, wrapT = vt.wrapT, &queue] {
+				auto page = std::make_shared<std::vector<uchar>>(
+					CutPage(*source, (key >> 16) & 0xF, (key >> 8) & 0xFF, key & 0xFF, wrapS, wrapT));
+				const auto bytes = page->size();
+				queue.Push([this, key, generation, page] { Commit(key, generation, *page, false); }, bytes);
+			};
+			if (pool) {
+				pool->Submit(cut);
+			}
+			else {
+				cut();
+			}
+		}
+
+		frame++;
+	}
+
+	void VirtualTextureSystem::RebuildIndirection(VirtualTexture& vt) const {
+		const int perSide = atlases.at(vt.source->format).perSide;
+
+		// from the coarsest level down, a missing page takes the entry of its parent
+		std::vector<uchar> parent;
+		for (int l = vt.levels - 1; l >= 0; --l) {
+			const int w = std::max(vt.pagesX >> l, 1);
+			const int h = std::max(vt.pagesY >> l, 1);
+			const int parentWidth = std::max(vt.pagesX >> (l + 1), 1);
+			std::vector<uchar> table(w * h * 4, 0);
+			for (int y = 0; y < h; ++y) {
+				for (int x = 0; x < w; ++x) {
+					uchar* entry = &table[(y * w + x) * 4];
+					const int slot = vt.pages[l][y * w + x];
+					if (slot >= 0) {
+						entry[0] = (uchar)(slot % perSide);
+						entry[1] = (uchar)(slot / perSide);
+						entry[2] = (uchar)l;
+						entry[3] = 255;
+					}
+					else if (!parent.empty()) {
+						std::memcpy(entry, &parent[((y >> 1) * parentWidth + (x >> 1)) * 4], 4);
+					}
+				}
+			}
+			glTextureSubImage2D(vt.indirection, l, 0, 0, w, h, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, table.data());
+			parent = std::move(table);
+		}
+		vt.dirty = false;
+	}
+
+	void VirtualTextureSystem::BeginFeedback(int viewportWidth, int viewportHeight) {
+		if (!settings.enabled) {
+			return;
+		}
+
+		for (auto& vt : textures) {
+			if (vt.source && vt.dirty) {
+				RebuildIndirection(vt);
+			}
+		}
+
+		const int scale = std::max(settings.feedbackScale, 1);
+		feedbackWidth = (viewportWidth + scale - 1) / scale;
+		feedbackHeight = (viewportHeight + scale - 1) / scale;
+		const std::size_t entries = (std::size_t)feedbackWidth * feedbackHeight;
+
+		current = (current + 1) % readbacks.size();
+		auto& readback = readbacks[current];
+		if (readback.fence != nullptr) {
+			// the GPU is a whole ring behind, wait rather than lose the requests
+			glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			ReadFeedback(readback);
+		}
+		if (readback.buffer == 0 || readback.entries != entries) {
+			glDeleteBuffers(1, &readback.buffer);
+			glCreateBuffers(1, &readback.buffer);
+			glNamedBufferStorage(readback.buffer, entries * sizeof(PageKey), nullptr, GL_DYNAMIC_STORAGE_BIT);
+			readback.entries = entries;
+		}
+
+		const PageKey empty = noPage;
+		glClearNamedBufferData(readback.buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &empty);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, readback.buffer);
+		// a different pixel of every cell each frame, over scale² frames the whole screen is seen
+		jitter = (jitter + 1) % (scale * scale);
+	}
+
+	void VirtualTextureSystem::EndFeedback() {
+		if (!settings.enabled) {
+			return;
+		}
+
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		readbacks[current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	}
+
+	VirtualTextureSystem::SlotInfo VirtualTextureSystem::GetSlot(const Texture* texture) const {
+		SlotInfo slot;
+		const auto it = byTexture.find(texture);
+		if (!settings.enabled || it == byTexture.end()) {
+			return slot;
+		}
+
+		const auto& vt = textures[it->second];
+		slot.id = it->second;
+		slot.pagesX = vt.pagesX;
+		slot.pagesY = vt.pagesY;
+		slot.levels = vt.levels;
+		slot.atlasPages = atlases.at(vt.source->format).perSide;
+		return slot;
+	}
+
+	void VirtualTextureSystem::Bind(const Texture* texture, GLint unit) const {
+		const auto it = byTexture.find(texture);
+		if (!settings.enabled || it == byTexture.end()) {
+			return;
+		}
+
+		const auto& vt = textures[it->second];
+		auto& state = Render::GLState::Get();
+		state.BindTexture(unit, vt.indirection);
+		state.BindTexture(unit + 1, atlases.at(vt.source->format).handle);
+	}
+
+	void VirtualTextureSystem::BindFeedback(Shader& shader, int slot) const {
+		static const UniformHandle<GLint> widthUniform("feedbackWidth");
+		static const UniformHandle<GLint> scaleUniform("feedbackScale");
+		static const UniformHandle<GLint> jitterUniform("feedbackJitter");
+		static const UniformHandle<GLint> slotUniform("feedbackSlot");
+
+		const int scale = std::max(settings.feedbackScale, 1);
+		shader.Upload(widthUniform, feedbackWidth);
+		shader.Upload(scaleUniform, scale);
+		shader.Upload(jitterUniform, jitter);
+		shader.Upload(slotUniform, slot);
+	}
+
+	void VirtualTextureSystem::Clear() {
+		for (int id = 0; id < (int)textures.size(); ++id) {
+			if (textures[id].source) {
+				Release(id);
+			}
+		}
+		textures.clear();
+		freeIds.clear();
+		loading.clear();
+		requested.clear();
+
+		for (auto& [format, atlas] : atlases) {
+			Render::GLState::Get().ForgetTexture(atlas.handle);
+			glDeleteTextures(1, &atlas.handle);
+		}
+		atlases.clear();
+
+		for (auto& readback : readbacks) {
+			if (readback.fence != nullptr) {
+				glDeleteSync(readback.fence);
+			}
+			glDeleteBuffers(1, &readback.buffer);
+			readback = {};
+		}
+	}
+
+	std::size_t VirtualTextureSystem::GetResidentPages() const {
+		std::size_t pages = 0;
+		for (const auto& [format, atlas] : atlases) {
+			pages += atlas.slots.size() - atlas.free.size();
+		}
+		return pages;
+	}
+
+	void VirtualTextureSystem::PrintStats(std::ostream& out) const {
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+
+		constexpr float64 MiB = 1024.0 * 1024.0;
+		std::size_t slots = 0;
+		std::size_t atlasBytes = 0;
+		for (const auto& [format, atlas] : atlases) {
+			slots += atlas.slots.size();
+			atlasBytes += TextureContainer::LevelSize(format, atlas.perSide * physicalPageSize, atlas.perSide * physicalPageSize);
+		}
+
+		out << std::fixed << std::setprecision(1)
+			<< "  " << byTexture.size() << " virtual textures, " << GetResidentPages() << " of " << slots
+			<< " pages resident in " << atlases.size() << " atlases (" << atlasBytes / MiB << " MiB)\n"
+			<< "  " << stats.loads << " page loads, " << stats.evictions << " evictions, " << stats.thrashed
+			<< " dropped, last feedback asked for " << stats.requests << " pages\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+
+} // Resource
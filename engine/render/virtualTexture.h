@@ -0,0 +1,182 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "render/shader.h"
+#include "render/texture.h"
+#include "render/uploadQueue.h"
+
+namespace Utils {
+	class ThreadPool;
+}
+
+namespace Resource {
+
+	// Software virtual texturing. Registered textures are cut into pageSize² pages, only the pages the
+	// geometry pass asked for live on the GPU, in one atlas of physical pages per pixel format, and an
+	// indirection texture per virtual texture maps every page to the atlas slot of itself or of its
+	// nearest resident parent. Fragments record the pages they sample into a low resolution feedback
+	// buffer, it is read back a few frames later without stalling and the missing pages are cut out
+	// of the chain on the pool and committed through the upload queue. Render thread only, except
+	// where noted.
+	class VirtualTextureSystem {
+	public:
+		// what gVirtualFrag.glsl needs to know of a virtual texture, id is -1 for textures that are not
+		struct SlotInfo {
+			int id = -1;
+			int pagesX = 0;
+			int pagesY = 0;
+			int levels = 0;
+			int atlasPages = 0;
+		};
+
+		// both must match gVirtualFrag.glsl
+		static constexpr int pageSize = 128;
+		// texels copied from the neighbouring pages on each side, keeps bilinear filtering seamless
+		// and BC blocks aligned
+		static constexpr int pageBorder = 4;
+		static constexpr int physicalPageSize = pageSize + 2 * pageBorder;
+
+		struct Settings {
+			bool enabled = false;
+			// physical pages per atlas side, one atlas per pixel format
+			int atlasPages = 32;
+			// one feedback entry per feedbackScale² pixels
+			int feedbackScale = 8;
+			// pages cut and queued per frame, and in flight at most
+			int loadsPerFrame = 16;
+			int maxInFlight = 64;
+		};
+
+		struct Stats {
+			// pages the last feedback read back asked for, parents included
+			std::size_t requests = 0;
+			std::size_t loads = 0;
+			std::size_t evictions = 0;
+			// loads dropped because every page of the atlas was still in use
+			std::size_t thrashed = 0;
+		};
+
+	private:
+		// 12 bit virtual texture id, 4 bit level, 8 bits each for the page x and y, as the shader writes it
+		using PageKey = uint32;
+		static constexpr PageKey noPage = 0xFFFFFFFF;
+		static constexpr int maxTextures = 4095;
+
+		struct Slot {
+			PageKey key = noPage;
+			uint64 lastUsed = 0;
+			bool pinned = false;
+		};
+
+		struct Atlas {
+			GLuint handle = 0;
+			int perSide = 0;
+			std::vector<Slot> slots;
+			std::vector<int> free;
+		};
+
+		struct VirtualTexture {
+			std::weak_ptr<Texture> texture;
+			std::shared_ptr<const ImageData> source;
+			uint32 generation = 0;
+			int pagesX = 0;
+			int pagesY = 0;
+			int levels = 0;
+			// the source's sampler wrap modes, page borders are filled the way it addresses its edges
+			GLint wrapS = GL_REPEAT;
+			GLint wrapT = GL_REPEAT;
+			GLuint indirection = 0;
+			// atlas slot per page of every level, -1 where the page is not resident
+			std::vector<std::vector<int>> pages;
+			bool dirty = false;
+		};
+
+		struct Readback {
+			GLuint buffer = 0;
+			GLsync fence = nullptr;
+			std::size_t entries = 0;
+		};
+
+		Settings settings;
+		std::unordered_map<PixelFormat, Atlas> atlases;
+		std::vector<VirtualTexture> textures;
+		std::vector<int> freeIds;
+		std::unordered_map<const Texture*, int> byTexture;
+		std::unordered_set<PageKey> loading;
+		std::vector<PageKey> requested;
+
+		std::array<Readback, 3> readbacks;
+		std::size_t current;
+		int feedbackWidth;
+		int feedbackHeight;
+		int jitter;
+
+		uint64 frame;
+		uint32 generations;
+		Stats stats;
+
+		VirtualTextureSystem();
+
+	public:
+		VirtualTextureSystem(const VirtualTextureSystem&) = delete;
+		VirtualTextureSystem(VirtualTextureSystem&&) = delete;
+		~VirtualTextureSystem() = default;
+
+		VirtualTextureSystem& operator=(const VirtualTextureSystem&) = delete;
+		VirtualTextureSystem& operator=(VirtualTextureSystem&&) = delete;
+
+		static VirtualTextureSystem& Get();
+
+		void SetSettings(const Settings& s) { settings = s; }
+		bool IsEnabled() const { return settings.enabled; }
+
+		// commits the coarsest pages and uploads the small mips into the texture itself for
+		// non-virtual shaders, returns false for images that cannot be paged (not a power of two,
+		// smaller than a page, missing mips or the atlas full)
+		bool Register(const std::shared_ptr<Texture>& texture, std::shared_ptr<const ImageData> source, StagingRing* staging);
+		bool IsVirtual(const Texture* texture) const { return byTexture.contains(texture); }
+
+		// reads back finished feedback, frees the pages of dead textures and schedules the missing pages
+		void Update(UploadQueue& queue, Utils::ThreadPool* pool);
+		// before the geometry pass: uploads changed indirection tables and binds a cleared feedback buffer
+		void BeginFeedback(int viewportWidth, int viewportHeight);
+		void EndFeedback();
+
+		SlotInfo GetSlot(const Texture* texture) const;
+		// binds the indirection table to unit and the atlas to the one after it, nothing for
+		// textures that are not virtual
+		void Bind(const Texture* texture, GLint unit) const;
+		void BindFeedback(Shader& shader, int slot) const;
+
+		// frees every GL object, needs the context
+		void Clear();
+
+		std::size_t GetResidentPages() const;
+		uint64 GetFrame() const { return frame; }
+		const Stats& GetStats() const { return stats; }
+		void PrintStats(std::ostream& out) const;
+
+	private:
+		static PageKey MakeKey(int id, int level, int x, int y);
+		static int PageLevels(const ImageData& image);
+		// the page with its border, cut from the chain addressing the edges like the wrap modes;
+		// safe to call from any thread
+		static std::vector<uchar> CutPage(const ImageData& image, int level, int x, int y, GLint wrapS, GLint wrapT);
+
+		Atlas& AtlasFor(PixelFormat format);
+		int AllocateSlot(Atlas& atlas);
+		void Commit(PageKey key, uint32 generation, const std::vector<uchar>& page, bool pinned);
+		void Release(int id);
+		void ReadFeedback(Readback& readback);
+		void RebuildIndirection(VirtualTexture& vt) const;
+	};
+
+} // Resource
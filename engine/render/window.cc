@@ -4,6 +4,7 @@
 //------------------------------------------------------------------------------
 #include "config.h"
 #include "window.h"
+#include "glState.h"
 #include <imgui.h>
 #include "imgui_impl_glfw_gl3.h"
 
@@ -330,6 +331,8 @@ Window::SwapBuffers()
 			ImGui_ImplGlfwGL3_NewFrame();
 			this->uiFunc();
 			ImGui::Render();
+			// ImGui sets its own state and puts back only some of it
+			Render::GLState::Get().Invalidate();
 		}
 		glfwSwapBuffers(this->window);
 	}
@@ -0,0 +1,51 @@
+#include "config.h"
+#include "stringId.h"
+
+#ifndef NDEBUG
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#endif
+
+namespace Utils {
+
+#ifndef NDEBUG
+	struct StringIdRegistry {
+		std::mutex mutex;
+		std::unordered_map<uint64, std::string> names;
+	};
+
+	static StringIdRegistry& Registry() {
+		static StringIdRegistry registry;
+		return registry;
+	}
+#endif
+
+	StringId StringId::FromString(std::string_view name) {
+		const StringId id(HashString(name), 0);
+#ifndef NDEBUG
+		auto& registry = Registry();
+		std::lock_guard lock(registry.mutex);
+		const auto [it, inserted] = registry.names.try_emplace(id.hash, name);
+		if (!inserted && it->second != name) {
+			std::cerr << "[ERROR] StringId collision between " << it->second << " and " << name << '\n';
+			assert(false);
+		}
+#endif
+		return id;
+	}
+
+	std::string_view StringId::GetName() const {
+#ifndef NDEBUG
+		auto& registry = Registry();
+		std::lock_guard lock(registry.mutex);
+		const auto it = registry.names.find(hash);
+		if (it != registry.names.end()) {
+			return it->second;
+		}
+#endif
+		return {};
+	}
+
+} // Utils
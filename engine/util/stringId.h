@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string_view>
+
+namespace Utils {
+
+	// 64 bit FNV-1a, usable at compile time
+	constexpr uint64 HashString(std::string_view s) {
+		uint64 hash = 14695981039346656037ull;
+		for (const char c : s) {
+			hash ^= (uchar)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// A name reduced to its hash. String literals convert implicitly and are hashed by the compiler,
+	// names only known at run time go through FromString. Debug builds remember the string behind
+	// every hash they see at run time and report two names sharing one.
+	class StringId {
+		uint64 hash = 0;
+
+		constexpr explicit StringId(uint64 h, int) : hash(h) {}
+
+	public:
+		constexpr StringId() = default;
+		consteval StringId(const char* name) : hash(HashString(name)) {}
+
+		static StringId FromString(std::string_view name);
+
+		constexpr uint64 GetHash() const { return hash; }
+		// the registered name in debug builds, empty when unknown or in release builds
+		std::string_view GetName() const;
+
+		constexpr bool operator==(const StringId&) const = default;
+	};
+
+	struct StringIdHash {
+		std::size_t operator()(StringId id) const { return (std::size_t)id.GetHash(); }
+	};
+
+} // Utils
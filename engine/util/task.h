@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace Utils {
+
+	template<typename T>
+	class Task;
+
+	namespace Detail {
+
+		// Tasks start eagerly and may finish on another thread while they are being awaited,
+		// whoever reaches the handoff flag second (the finished task or the awaiter) resumes the awaiter.
+		// A Task dropped before it finished detaches instead, it leaves no continuation and the
+		// frame frees itself when it gets to its end.
+		struct PromiseBase {
+			std::coroutine_handle<> continuation;
+			std::atomic<bool> handoff = false;
+			std::atomic<bool> finished = false;
+			std::exception_ptr error;
+
+			struct FinalAwaiter {
+				bool await_ready() const noexcept { return false; }
+
+				template<typename P>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+					auto& p = h.promise();
+					p.finished.store(true, std::memory_order_release);
+					if (p.handoff.exchange(true, std::memory_order_acq_rel)) {
+						if (!p.continuation) {
+							// detached, nobody is left to read the result
+							h.destroy();
+							return std::noop_coroutine();
+						}
+						return p.continuation;
+					}
+					return std::noop_coroutine();
+				}
+
+				void await_resume() const noexcept {}
+			};
+
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		template<typename T>
+		struct Promise : PromiseBase {
+			std::optional<T> value;
+
+			Task<T> get_return_object();
+			void return_value(T v) { value = std::move(v); }
+
+			T Result() {
+				if (error) std::rethrow_exception(error);
+				return std::move(*value);
+			}
+		};
+
+		template<>
+		struct Promise<void> : PromiseBase {
+			Task<void> get_return_object();
+			void return_void() {}
+
+			void Result() {
+				if (error) std::rethrow_exception(error);
+			}
+		};
+
+	} // Detail
+
+	template<typename T = void>
+	class Task {
+	public:
+		using promise_type = Detail::Promise<T>;
+
+	private:
+		std::coroutine_handle<promise_type> h;
+
+	public:
+		Task() = default;
+		explicit Task(std::coroutine_handle<promise_type> h) : h(h) {}
+		Task(const Task&) = delete;
+		Task(Task&& other) noexcept : h(std::exchange(other.h, {})) {}
+		~Task() {
+			Release();
+		}
+
+		Task& operator=(const Task&) = delete;
+		Task& operator=(Task&& other) noexcept {
+			if (this != &other) {
+				Release();
+				h = std::exchange(other.h, {});
+			}
+			return *this;
+		}
+
+		bool IsValid() const { return static_cast<bool>(h); }
+		bool IsDone() const { return h && h.promise().finished.load(std::memory_order_acquire); }
+
+		// only valid once IsDone() returns true
+		T Get() { return h.promise().Result(); }
+
+		bool await_ready() const noexcept { return IsDone(); }
+
+		bool await_suspend(std::coroutine_handle<> awaiter) noexcept {
+			h.promise().continuation = awaiter;
+			return !h.promise().handoff.exchange(true, std::memory_order_acq_rel);
+		}
+
+		T await_resume() { return h.promise().Result(); }
+
+	private:
+		// frees a finished frame, detaches a running one so it frees itself; a task that is being
+		// awaited must not be dropped
+		void Release() {
+			if (!h) return;
+			auto& p = h.promise();
+			p.continuation = {};
+			if (p.handoff.exchange(true, std::memory_order_acq_rel)) {
+				h.destroy();
+			}
+			h = {};
+		}
+	};
+
+	namespace Detail {
+
+		template<typename T>
+		Task<T> Promise<T>::get_return_object() {
+			return Task<T>{ std::coroutine_handle<Promise<T>>::from_promise(*this) };
+		}
+
+		inline Task<void> Promise<void>::get_return_object() {
+			return Task<void>{ std::coroutine_handle<Promise<void>>::from_promise(*this) };
+		}
+
+	} // Detail
+
+} // Utils
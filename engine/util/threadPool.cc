@@ -0,0 +1,115 @@
+#include "config.h"
+#include "threadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace Utils {
+
+	ThreadPool::ThreadPool(std::size_t threadCount)
+		: activeJobs(0), stopping(false) {
+		if (threadCount == 0) {
+			const auto hw = std::thread::hardware_concurrency();
+			threadCount = hw > 1 ? hw - 1 : 1;
+		}
+
+		workers.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; ++i) {
+			workers.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool() {
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	void ThreadPool::Submit(std::function<void()> job) {
+		{
+			std::lock_guard lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		jobAvailable.notify_one();
+	}
+
+	void ThreadPool::Wait() {
+		std::unique_lock lock(mutex);
+		jobsDone.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+	}
+
+	bool ThreadPool::IsIdle() {
+		std::lock_guard lock(mutex);
+		return jobs.empty() && activeJobs == 0;
+	}
+
+	void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& fn) {
+		if (count == 0) return;
+
+		struct State {
+			std::atomic<std::size_t> next{ 0 };
+			std::atomic<std::size_t> finished{ 0 };
+			std::size_t count;
+			const std::function<void(std::size_t)>* fn;
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+
+		auto state = std::make_shared<State>();
+		state->count = count;
+		state->fn = &fn;
+
+		// helpers that start after every index has been taken exit without touching fn
+		auto run = [](State& s) {
+			for (std::size_t i = s.next++; i < s.count; i = s.next++) {
+				(*s.fn)(i);
+				if (++s.finished == s.count) {
+					std::lock_guard lock(s.mutex);
+					s.done.notify_all();
+				}
+			}
+		};
+
+		const auto helpers = std::min(workers.size(), count - 1);
+		for (std::size_t i = 0; i < helpers; ++i) {
+			Submit([state, run] { run(*state); });
+		}
+
+		run(*state);
+
+		std::unique_lock lock(state->mutex);
+		state->done.wait(lock, [&state] { return state->finished == state->count; });
+	}
+
+	void ThreadPool::WorkerLoop() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock lock(mutex);
+				jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping && jobs.empty()) return;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				activeJobs++;
+			}
+
+			job();
+
+			{
+				std::lock_guard lock(mutex);
+				activeJobs--;
+				if (jobs.empty() && activeJobs == 0) {
+					jobsDone.notify_all();
+				}
+			}
+		}
+	}
+
+} // Utils
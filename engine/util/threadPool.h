@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils {
+
+	class ThreadPool {
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> jobs;
+		std::mutex mutex;
+		std::condition_variable jobAvailable;
+		std::condition_variable jobsDone;
+		std::size_t activeJobs;
+		bool stopping;
+
+	public:
+		// threadCount == 0 picks one worker per hardware thread minus the calling one
+		explicit ThreadPool(std::size_t threadCount = 0);
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		~ThreadPool();
+
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		void Submit(std::function<void()> job);
+		void Wait();
+		bool IsIdle();
+
+		// runs fn(0..count-1) across the workers, the calling thread helps out and returns when all are done
+		void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& fn);
+
+		std::size_t GetWorkerCount() const { return workers.size(); }
+
+		// co_await pool.Schedule() continues the coroutine on one of the workers
+		auto Schedule() {
+			struct Awaiter {
+				ThreadPool& pool;
+
+				bool await_ready() const noexcept { return false; }
+				void await_suspend(std::coroutine_handle<> h) { pool.Submit([h] { h.resume(); }); }
+				void await_resume() const noexcept {}
+			};
+			return Awaiter{ *this };
+		}
+
+	private:
+		void WorkerLoop();
+	};
+
+} // Utils
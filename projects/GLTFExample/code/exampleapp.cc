@@ -6,18 +6,48 @@
 #include "exampleapp.h"
 #include "imgui.h"
 
+#include "render/glState.h"
+#include "render/materialTable.h"
 #include "render/mesh.h"
 #include "math/math.h"
 #include "input/input.h"
 #include "render/model.h"
+#include "render/textureArray.h"
+#include "render/textureStreamer.h"
+#include "render/virtualTexture.h"
 
 #include <iostream>
+#include <thread>
 
 #include "fx/gltf.h"
 
 using namespace Display;
 namespace Example {
 
+	// milliseconds per frame the render thread spends on texture and buffer uploads
+	constexpr float64 UPLOAD_BUDGET_MS = 4.0;
+	// a quarter of the staging ring, leaves room for the frames the GPU has not finished yet
+	constexpr std::size_t UPLOAD_BUDGET_BYTES = 8 << 20;
+	// material textures either paged and mip streamed, or fully resident and packed into arrays
+	// so that draws share their bindings
+	constexpr bool VIRTUAL_TEXTURING = false;
+	// point lights binned into view clusters and shaded in one compute dispatch, or drawn as light
+	// volumes with one instanced draw
+	constexpr bool CLUSTERED_LIGHTING = true;
+	constexpr std::size_t POINT_LIGHTS = 1024;
+	constexpr std::size_t SPOT_LIGHTS = 32;
+
+	// the fixed function state of each pass
+	static constexpr Render::PipelineState geometryPipeline{ Render::PipelineDesc{} };
+	// only the back faces of the light volumes are drawn, where the G-buffer surface lies in front of
+	// them; clamping keeps volumes reaching past the far plane from losing their back faces
+	static constexpr Render::PipelineState lightVolumePipeline{ Render::PipelineDesc{
+		.depthWrite = false, .depthClamp = true, .depthFunc = GL_GEQUAL,
+		.blend = true, .blendDst = GL_ONE, .cullFace = GL_FRONT } };
+	static constexpr Render::PipelineState fullscreenPipeline{ Render::PipelineDesc{
+		.depthTest = false, .depthWrite = false, .blend = true, .blendDst = GL_ONE } };
+	static constexpr Render::PipelineState gizmoPipeline{ Render::PipelineDesc{ .depthWrite = false } };
+
 	//------------------------------------------------------------------------------
 	/**
 	*/
@@ -36,11 +66,57 @@ namespace Example {
 	/**
 	*/
 	void ImGuiExampleApp::Close() {
+		// let in-flight loads land before tearing down the GL objects they upload into,
+		// once the context is gone there is nothing left to upload into so they are dropped
+		const bool open = this->window->IsOpen();
+		while (!threadPool.IsIdle() || uploadQueue.Pending() > 0
+			|| (open && sceneLoad.IsValid() && !sceneLoad.IsDone())) {
+			if (open) {
+				uploadQueue.Flush(UPLOAD_BUDGET_MS, UPLOAD_BUDGET_BYTES);
+			}
+			else {
+				uploadQueue.Discard();
+			}
+			std::this_thread::yield();
+		}
+
 		if (this->window->IsOpen()) {
-			helmetModel->UnLoad();
-			helmetModel.reset();
-			sponzaModel->UnLoad();
-			sponzaModel.reset();
+			std::cout << "[INFO] texture cache\n";
+			Resource::TextureCache::Get().PrintStats(std::cout);
+			std::cout << "[INFO] upload queue\n";
+			uploadQueue.PrintStats(std::cout);
+			std::cout << "[INFO] texture streaming\n";
+			Resource::TextureStreamer::Get().PrintStats(std::cout);
+			std::cout << "[INFO] virtual texturing\n";
+			Resource::VirtualTextureSystem::Get().PrintStats(std::cout);
+			std::cout << "[INFO] texture arrays\n";
+			Resource::TextureArrayPacker::Get().PrintStats(std::cout);
+			if (CLUSTERED_LIGHTING) {
+				std::cout << "[INFO] clustered lighting\n";
+				clusteredLighting.PrintStats(std::cout);
+			}
+			std::cout << "[INFO] light uploads\n";
+			lightManager.PrintStats(std::cout);
+			std::cout << "[INFO] materials\n";
+			Resource::MaterialTable::Get().PrintStats(std::cout);
+			std::cout << "[INFO] render queue\n";
+			renderQueue.PrintStats(std::cout);
+			std::cout << "[INFO] GL state\n";
+			Render::GLState::Get().PrintStats(std::cout);
+			uploadQueue.ReleaseStaging();
+			nodeBatches.Clear();
+
+			if (helmetModel) {
+				helmetModel->UnLoad();
+				helmetModel.reset();
+			}
+			if (sponzaModel) {
+				sponzaModel->UnLoad();
+				sponzaModel.reset();
+			}
+			Resource::VirtualTextureSystem::Get().Clear();
+			Resource::MaterialTable::Get().ReleaseBuffer();
+			Render::GLState::Get().ForgetVertexArray(quadVAO);
 			glDeleteVertexArrays(1, &quadVAO);
 			glDeleteBuffers(1, &quadVBO);
 
@@ -85,45 +161,70 @@ namespace Example {
 				(resPath / "shaders/gNormVert.glsl").make_preferred(),
 				(resPath / "shaders/gNormFrag.glsl").make_preferred());
 			shaderManager.Push(
+				"gVirtualPass",
+				(resPath / "shaders/gNormVert.glsl").make_preferred(),
+				(resPath / "shaders/gVirtualFrag.glsl").make_preferred());
+			shaderManager.Push(
+				"gArrayPass",
+				(resPath / "shaders/gNormVert.glsl").make_preferred(),
+				(resPath / "shaders/gArrayFrag.glsl").make_preferred());
+			pointLightPass = shaderManager.Push(
 				"PointLightPass",
-				(resPath / "shaders/LightVert.glsl").make_preferred(),
+				(resPath / "shaders/PointLightVert.glsl").make_preferred(),
 				(resPath / "shaders/PointLightFrag.glsl").make_preferred());
-			shaderManager.Push(
+			spotLightPass = shaderManager.Push(
+				"SpotLightPass",
+				(resPath / "shaders/SpotLightVert.glsl").make_preferred(),
+				(resPath / "shaders/SpotLightFrag.glsl").make_preferred());
+			dirLightPass = shaderManager.Push(
 				"DirLightPass",
 				(resPath / "shaders/LightVert.glsl").make_preferred(),
 				(resPath / "shaders/DirLightFrag.glsl").make_preferred());
-			shaderManager.Push(
-				"nullShader",
-				(resPath / "shaders/nVert.glsl").make_preferred(),
-				(resPath / "shaders/nFrag.glsl").make_preferred());
+			shaderManager.PushCompute(
+				"ClusterCull",
+				(resPath / "shaders/clusterCull.glsl").make_preferred());
+			shaderManager.PushCompute(
+				"ClusterShade",
+				(resPath / "shaders/clusterShade.glsl").make_preferred());
 
 			Resource::OBJMeshBuilder meshBuilder{ (resPath / "meshes/sphere.obj").make_preferred() };
 			auto debugSphere = std::make_shared<Resource::Mesh>(meshBuilder.CreateMesh());
-
-			helmetModel = std::make_shared<Resource::Model>(
-				resPath / std::filesystem::path("models/FlightHelmet/gltf/FlightHelmet.gltf").make_preferred(),
-				shaderManager
-			);
-			sponzaModel = std::make_shared<Resource::Model>(
-				resPath / std::filesystem::path("models/Sponza/gltf/Sponza.gltf").make_preferred(),
-				shaderManager
-			);
-
-			for (std::size_t i = 0; i < 5; ++i) {
-				for (std::size_t j = 0; j < 5; ++j) {
-					Resource::GraphicsNode node{ helmetModel };
-					node.transform *= Math::translate({-2.5f + i * 1.0f, 0.0f, -2.5f + j * 1.0f})
-						* Math::rotationy(Math::toRad(Math::Random::rand_int(-180, 180)));
-					nodes.push_back(node);
-				}
+			Resource::ConeMeshBuilder coneBuilder{ 24 };
+			auto spotCone = std::make_shared<Resource::Mesh>(coneBuilder.CreateMesh());
+
+			// first run compresses the glTF images, later runs load the cached DDS files
+			Resource::TextureCache::CompressionSettings compression;
+			compression.enabled = true;
+			compression.quality = Resource::BCQuality::Normal;
+			compression.cacheDir = (resPath / "texcache").make_preferred();
+			compression.pool = &threadPool;
+			Resource::TextureCache::Get().SetCompression(compression);
+
+			if (VIRTUAL_TEXTURING) {
+				// only the mips the camera can resolve stay in video memory
+				Resource::TextureStreamer::Settings streaming;
+				streaming.enabled = true;
+				streaming.budgetBytes = 96 << 20;
+				Resource::TextureStreamer::Get().SetSettings(streaming);
+
+				// textures that can be paged only keep the pages the geometry pass samples,
+				// the streamer handles the rest
+				Resource::VirtualTextureSystem::Settings paging;
+				paging.enabled = true;
+				Resource::VirtualTextureSystem::Get().SetSettings(paging);
 			}
-			nodes.emplace_back(sponzaModel);
-			nodes.back().transform *= Math::scale(0.015f);
+			else {
+				Resource::TextureArrayPacker::Settings packing;
+				packing.enabled = true;
+				Resource::TextureArrayPacker::Get().SetSettings(packing);
+			}
+
+			sceneLoad = LoadScene(resPath);
 
 
-			//lightManager.PushLightingShader(shaderManager.Get("PointLightPass"));
 			lightManager.SetLightSourceShader(shaderManager.Get("lightSourceShader"));
 			lightManager.SetMesh(debugSphere);
+			lightManager.SetSpotMesh(spotCone);
 
 			Render::DirectionalLight dl;
 			dl.SetDirection({ 0, -1, -1});
@@ -134,8 +235,8 @@ namespace Example {
 
 			Render::PointLight pl;
 			pl.SetFalloff(75.0f);
-			pl.SetRadius(45.0f);
-			for (std::size_t i = 0; i < Render::MAX_NUM_LIGHT_SOURCES; ++i) {
+			pl.SetRadius(12.0f);
+			for (std::size_t i = 0; i < POINT_LIGHTS; ++i) {
 				float x = Math::Random::rand_float(-19.0f, 24.0f);
 				float y = Math::Random::rand_float(0.5f, 12.5f);
 				float z = Math::Random::rand_float(-11.0f, 9.0f);
@@ -148,8 +249,25 @@ namespace Example {
 				pl.SetAmbient(c * 0.005f);
 				pl.SetDiffuse(c * 0.01f);
 				pl.SetSpecular(c * 0.25f);
-				pl.vel = { 0, 0, speed };
-				lightManager.PushPointLight(pl);
+				lightManager.PushPointLight(pl, { 0, 0, speed });
+			}
+
+			// a row of spots under the ceiling along both sides, shining down
+			Render::SpotLight sl;
+			sl.SetDirection({ 0.0f, -1.0f, 0.0f });
+			sl.SetCutoffAngle(Math::toRad(22.0f));
+			sl.SetOuterCutoffAngle(Math::toRad(30.0f));
+			sl.SetRadius(14.0f);
+			sl.SetAttenuation({ 1.0f, 0.02f, 0.005f });
+			for (std::size_t i = 0; i < SPOT_LIGHTS; ++i) {
+				float x = -19.0f + 43.0f * (float)(i / 2) / (float)(SPOT_LIGHTS / 2);
+				float z = (i % 2 == 0) ? -6.0f : 4.0f;
+				Math::vec3 c{ Math::Random::rand_float(), Math::Random::rand_float(), Math::Random::rand_float() };
+				sl.SetPos({ x, 12.0f, z });
+				sl.SetAmbient(c * 0.01f);
+				sl.SetDiffuse(c * 0.6f);
+				sl.SetSpecular(c * 0.3f);
+				lightManager.PushSpotLight(sl);
 			}
 
 			this->camera = new Render::Camera(
@@ -165,23 +283,31 @@ namespace Example {
 			dt = (time - prev_time) / 1000.0f;
 
 			gbuf.Init(S_WIDTH, S_HEIGHT);
+			clusteredLighting.Init(S_WIDTH, S_HEIGHT);
+			clusteredLighting.SetShaders(shaderManager.Get("ClusterCull"), shaderManager.Get("ClusterShade"));
 
 			{
-				const auto& s = shaderManager.Get("PointLightPass").lock();
+				auto* s = shaderManager.Get(pointLightPass);
 				s->Use();
 				s->UploadUniform1i("gPos", 0);
 				s->UploadUniform1i("gCol", 1);
 				s->UploadUniform1i("gNorm", 2);
-				s->UnUse();
 			}
 
 			{
-				const auto& s = shaderManager.Get("DirLightPass").lock();
+				auto* s = shaderManager.Get(spotLightPass);
+				s->Use();
+				s->UploadUniform1i("gPos", 0);
+				s->UploadUniform1i("gCol", 1);
+				s->UploadUniform1i("gNorm", 2);
+			}
+
+			{
+				auto* s = shaderManager.Get(dirLightPass);
 				s->Use();
 				s->UploadUniform1i("gPos", 0);
 				s->UploadUniform1i("gCol", 1);
 				s->UploadUniform1i("gNorm", 2);
-				s->UnUse();
 			}
 
 			return true;
@@ -197,7 +323,6 @@ namespace Example {
 	/**
 	*/
 	void ImGuiExampleApp::Run() {
-		glEnable(GL_CULL_FACE);
 		glEnable(GL_FRAMEBUFFER_SRGB);
 
 		float angle = 0.0f;
@@ -206,33 +331,46 @@ namespace Example {
 			this->window->Update();
 			HandleInput();
 			UpdateLights();
+			lightManager.UploadLights();
+
+			int32 width, height;
+			this->window->GetSize(width, height);
+			nodeBatches.Build(nodes);
+			nodeBatches.RequestMips(*camera, (float)height);
+			Resource::TextureStreamer::Get().Update(uploadQueue);
+			Resource::VirtualTextureSystem::Get().Update(uploadQueue, &threadPool);
+
+			uploadQueue.Flush(UPLOAD_BUDGET_MS, UPLOAD_BUDGET_BYTES);
 
 			angle += dt;
 
+			// every pass reads the camera from here, the geometry pass its materials
+			frameUniforms.Update(*camera, S_WIDTH, S_HEIGHT);
+			Resource::MaterialTable::Get().Update();
 			gbuf.StartFrame();
 
+			Resource::VirtualTextureSystem::Get().BeginFeedback(S_WIDTH, S_HEIGHT);
 			GeometryPass();
+			Resource::VirtualTextureSystem::Get().EndFeedback();
 
-			glEnable(GL_STENCIL_TEST);
-			std::size_t i = 0;
-			for (const auto& pl : lightManager.GetPointLights()) {
-				StencilPassPointLight(pl);
-				LightingPassPointLight(pl, i);
-				i++;
+			if (CLUSTERED_LIGHTING) {
+				clusteredLighting.Dispatch(gbuf, *camera, lightManager);
 			}
-			glDisable(GL_STENCIL_TEST);
-
-			LightingPassGlobalLight();
+			else {
+				LightingPassPointLights();
+				LightingPassGlobalLight();
+			}
+			LightingPassSpotLights();
 
 			gbuf.BindForDebugPass();
-			glEnable(GL_DEPTH_TEST);
-			glDisable(GL_BLEND);
-			lightManager.DrawLightSources(*camera);
+			Render::GLState::Get().Apply(gizmoPipeline);
+			lightManager.DrawLightSources();
 
 			FinalPass();
 
 			// transfer new frame to window
 			this->window->SwapBuffers();
+			Render::GLState::Get().EndFrame();
 
 			// delta time
 			prev_time = time;
@@ -249,6 +387,36 @@ namespace Example {
 		}
 	}
 
+	Utils::Task<void> ImGuiExampleApp::LoadScene(std::filesystem::path resPath) {
+		// both loads start right away, nodes are added as each model's geometry lands
+		auto helmetLoad = Resource::AsyncLoadModel(
+			resPath / std::filesystem::path("models/FlightHelmet/gltf/FlightHelmet.gltf").make_preferred(),
+			shaderManager, threadPool, uploadQueue
+		);
+		auto sponzaLoad = Resource::AsyncLoadModel(
+			resPath / std::filesystem::path("models/Sponza/gltf/Sponza.gltf").make_preferred(),
+			shaderManager, threadPool, uploadQueue
+		);
+
+		helmetModel = co_await helmetLoad;
+		if (helmetModel) {
+			for (std::size_t i = 0; i < 5; ++i) {
+				for (std::size_t j = 0; j < 5; ++j) {
+					Resource::GraphicsNode node{ helmetModel };
+					node.transform *= Math::translate({-2.5f + i * 1.0f, 0.0f, -2.5f + j * 1.0f})
+						* Math::rotationy(Math::toRad(Math::Random::rand_int(-180, 180)));
+					nodes.push_back(node);
+				}
+			}
+		}
+
+		sponzaModel = co_await sponzaLoad;
+		if (sponzaModel) {
+			nodes.emplace_back(sponzaModel);
+			nodes.back().transform *= Math::scale(0.015f);
+		}
+	}
+
 	void ImGuiExampleApp::HandleInput() {
 		using namespace Input;
 		if (InputManager::IsKeyPressed(Key::Escape))
@@ -276,7 +444,7 @@ namespace Example {
 
 			glGenVertexArrays(1, &quadVAO);
 			glGenBuffers(1, &quadVBO);
-			glBindVertexArray(quadVAO);
+			Render::GLState::Get().BindVertexArray(quadVAO);
 			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 			glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
 			glEnableVertexAttribArray(0);
@@ -295,129 +463,70 @@ namespace Example {
 				GL_FALSE,
 				5 * sizeof(GLfloat),
 				(GLvoid*)(3 * sizeof(GLfloat)));
-			glBindVertexArray(0);
 		}
-		glBindVertexArray(quadVAO);
+		Render::GLState::Get().BindVertexArray(quadVAO);
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-		glBindVertexArray(0);
 	}
 
 	void ImGuiExampleApp::GeometryPass() {
-		const auto& s = shaderManager.Get("gNormPass").lock();
-		s->Use();
-
 		gbuf.BindForGeometryPass();
 
-		glDepthMask(GL_TRUE);
-
+		// before the clear, it needs depth writes
+		Render::GLState::Get().Apply(geometryPipeline);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		glEnable(GL_DEPTH_TEST);
-
-		for (const auto& node : nodes) {
-			node.Draw(*camera);
-		}
-
-		glDepthMask(GL_FALSE);
-
-		s->UnUse();
+		renderQueue.Clear();
+		nodeBatches.Enqueue(renderQueue, *camera);
+		renderQueue.Sort();
+		renderQueue.Submit();
 	}
 
-	void ImGuiExampleApp::StencilPassPointLight(const Render::PointLight& pl) {
-		const auto& s = shaderManager.Get("nullShader").lock();
-		s->Use();
-
-		gbuf.BindForStencilPass();
-		glEnable(GL_DEPTH_TEST);
-		glDisable(GL_CULL_FACE);
-
-		glClearStencil(0);
-		glClear(GL_STENCIL_BUFFER_BIT);
-		glStencilFunc(GL_ALWAYS, 0x01, 0xFF);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+	// the uniforms the lighting passes upload every frame
+	static const Resource::UniformHandle<Math::vec3> lightDirUniform("light.dir");
+	static const Resource::UniformHandle<Math::vec3> lightAmbientUniform("light.ambient");
+	static const Resource::UniformHandle<Math::vec3> lightDiffuseUniform("light.diffuse");
+	static const Resource::UniformHandle<Math::vec3> lightSpecularUniform("light.specular");
 
-		s->UploadUniformMat4fv("view", camera->GetView());
-		s->UploadUniformMat4fv("perspective", camera->GetPerspective());
+	void ImGuiExampleApp::LightingPassPointLights() {
+		auto* s = shaderManager.Get(pointLightPass);
+		s->Use();
 
-		auto transform = Math::translate(pl.GetPos()) * Math::scale(pl.GetRadius());
-		s->UploadUniformMat4fv("transform", transform);
+		gbuf.BindForLightingPass();
+		lightManager.BindLights();
 
-		lightManager.GetMesh()->Draw();
+		Render::GLState::Get().Apply(lightVolumePipeline);
 
-		s->UnUse();
+		lightManager.GetMesh()->DrawInstanced((GLsizei)lightManager.GetPointLightCount());
 	}
 
-	void ImGuiExampleApp::LightingPassPointLight(const Render::PointLight& pl, std::size_t i) {
-		const auto& s = shaderManager.Get("PointLightPass").lock();
+	void ImGuiExampleApp::LightingPassSpotLights() {
+		auto* s = shaderManager.Get(spotLightPass);
 		s->Use();
 
 		gbuf.BindForLightingPass();
+		lightManager.BindLights();
 
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-		glDisable(GL_DEPTH_TEST);
-
-		glEnable(GL_BLEND);
-		glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_ONE, GL_ONE);
-
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_FRONT);
-
-		Math::vec2 dim{ S_WIDTH, S_HEIGHT };
+		Render::GLState::Get().Apply(lightVolumePipeline);
 
-		s->UploadUniform2fv("screen_dim", dim);
-		s->UploadUniform3fv("cam_pos", camera->GetCameraPos());
-		s->UploadUniform3fv("light.pos", pl.GetPos());
-		s->UploadUniform3fv("light.ambient", pl.GetAmbient());
-		s->UploadUniform3fv("light.diffuse", pl.GetDiffuse());
-		s->UploadUniform3fv("light.specular", pl.GetSpecular());
-		s->UploadUniform1f("light.radius", pl.GetRadius());
-		s->UploadUniform1f("light.falloff", pl.GetFalloff());
-
-		//s->UploadUniformMat4fv("view", camera->GetView());
-		//s->UploadUniformMat4fv("perspective", camera->GetPerspective());
-
-		auto transform = Math::translate(pl.GetPos()) * Math::scale(pl.GetRadius());
-		s->UploadUniformMat4fv("mvp", camera->GetPerspective() * camera->GetView() * transform);
-		lightManager.GetMesh()->Draw();
-
-		glCullFace(GL_BACK);
-		glDisable(GL_BLEND);
-
-		s->UnUse();
+		lightManager.GetSpotMesh()->DrawInstanced((GLsizei)lightManager.GetSpotLights().size());
 	}
 
 	void ImGuiExampleApp::LightingPassGlobalLight() {
-		const auto& s = shaderManager.Get("DirLightPass").lock();
+		auto* s = shaderManager.Get(dirLightPass);
 		s->Use();
 
 		gbuf.BindForLightingPass();
 
-		glDisable(GL_DEPTH_TEST);
-		glEnable(GL_BLEND);
-		glBlendEquation(GL_FUNC_ADD);
-		glBlendFunc(GL_ONE, GL_ONE);
+		Render::GLState::Get().Apply(fullscreenPipeline);
 
-		Math::vec2 dim{ S_WIDTH, S_HEIGHT };
 		const auto& l = lightManager.GetGlobalLight();
 
-		s->UploadUniform2fv("screen_dim", dim);
-		s->UploadUniform3fv("cam_pos", camera->GetCameraPos());
-		s->UploadUniform3fv("light.dir", l.GetDirection());
-		s->UploadUniform3fv("light.ambient", l.GetAmbient());
-		s->UploadUniform3fv("light.diffuse", l.GetDiffuse());
-		s->UploadUniform3fv("light.specular", l.GetSpecular());
-
-		//s->UploadUniformMat4fv("view", camera->GetView());
-		//s->UploadUniformMat4fv("perspective", camera->GetPerspective());
-
-		s->UploadUniformMat4fv("mvp", Math::mat4::identity());
+		s->Upload(lightDirUniform, l.GetDirection());
+		s->Upload(lightAmbientUniform, l.GetAmbient());
+		s->Upload(lightDiffuseUniform, l.GetDiffuse());
+		s->Upload(lightSpecularUniform, l.GetSpecular());
 
 		renderQuad();
-		glDisable(GL_BLEND);
-
-		s->UnUse();
 	}
 
 	void ImGuiExampleApp::FinalPass() {
@@ -428,13 +537,10 @@ namespace Example {
 	}
 
 	void ImGuiExampleApp::UpdateLights() {
-		for (auto& l : lightManager.GetPointLights()) {
-			const auto& p = l.GetPos();
-			if (p.z < -11.0f || p.z > 9.0f) {
-				l.vel *= -1;
-			}
-
-			l.SetPos(p + l.vel * dt);
-		}
+		Render::PointLightAnimation anim;
+		anim.dt = dt;
+		anim.boundsMin.z = -11.0f;
+		anim.boundsMax.z = 9.0f;
+		lightManager.AnimatePointLights(anim, &threadPool);
 	}
 } // namespace Example
\ No newline at end of file
@@ -9,10 +9,16 @@
 #include "core/app.h"
 #include "render/window.h"
 #include "render/camera.h"
+#include "render/clusteredLighting.h"
+#include "render/frameData.h"
 #include "render/gbuf.h"
 #include "render/light.h"
 #include "render/model.h"
 #include "render/node.h"
+#include "render/renderQueue.h"
+#include "render/uploadQueue.h"
+#include "util/task.h"
+#include "util/threadPool.h"
 
 
 namespace Example {
@@ -33,8 +39,15 @@ namespace Example {
 		void HandleInput();
 
 	private:
+		Utils::ThreadPool threadPool;
+		Resource::UploadQueue uploadQueue;
+		Utils::Task<void> sceneLoad;
 		Render::LightManager lightManager;
 		Resource::ShaderManager shaderManager;
+		// the passes drawn every frame, looked up once when pushed
+		Resource::ShaderManager::Handle pointLightPass;
+		Resource::ShaderManager::Handle spotLightPass;
+		Resource::ShaderManager::Handle dirLightPass;
 		std::shared_ptr<Resource::Model> helmetModel;
 		std::shared_ptr<Resource::Model> sponzaModel;
 		Render::Camera* camera;
@@ -44,15 +57,22 @@ namespace Example {
 		float dt;
 
 		Render::GBuffer gbuf;
+		Render::ClusteredLighting clusteredLighting;
+		Render::RenderQueue renderQueue;
+		Render::FrameUniforms frameUniforms;
 
 		std::vector<Resource::GraphicsNode> nodes;
+		// the nodes grouped by model, rebuilt every frame
+		Resource::NodeBatches nodeBatches;
 
 		GLuint quadVAO = 0, quadVBO = 0;
 
+		Utils::Task<void> LoadScene(std::filesystem::path resPath);
+
 		void renderQuad();
 		void GeometryPass();
-		void StencilPassPointLight(const Render::PointLight& pl);
-		void LightingPassPointLight(const Render::PointLight& pl, std::size_t i);
+		void LightingPassPointLights();
+		void LightingPassSpotLights();
 		void LightingPassGlobalLight();
 		void FinalPass();
 
@@ -3,8 +3,18 @@ uniform sampler2D gPos;
 uniform sampler2D gCol;
 uniform sampler2D gNorm;
 
-uniform vec2 screen_dim;
-uniform vec3 cam_pos;
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
 
 struct DirectionalLight {
 	vec3 dir;
@@ -31,7 +41,7 @@ void main()
 	vec3 diff = temp.rgb;
 	float spec = temp.a;
 
-	vec3 cam_dir = normalize(cam_pos - pos);
+	vec3 cam_dir = normalize(frame.cameraPos.xyz - pos);
 
 	vec3 tempCol = CalcDirectionalLight(norm, cam_dir, diff, spec);
 
@@ -56,5 +66,5 @@ vec3 CalcDirectionalLight(vec3 norm, vec3 cam_dir, vec3 diff, float spec)
 }
 
 vec2 CalcUV() {
-	return gl_FragCoord.xy / screen_dim;
+	return gl_FragCoord.xy * frame.screenSize.zw;
 }
\ No newline at end of file
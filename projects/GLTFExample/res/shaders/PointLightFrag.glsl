@@ -3,48 +3,49 @@ uniform sampler2D gPos;
 uniform sampler2D gCol;
 uniform sampler2D gNorm;
 
-uniform vec2 screen_dim;
-uniform vec3 cam_pos;
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
 
 struct PointLight {
 	vec3 pos;
+	float radius;
 
 	vec3 ambient;
+	float falloff;
 	vec3 diffuse;
 	vec3 specular;
-
-	float radius;
-	float falloff;
 };
 
-uniform PointLight light;
-
-// struct SpotLight {
-// 	vec3 pos;
-// 	vec3 dir;
-// 	float cutoff
-// 	float outerCutoff;
-
-// 	vec3 ambient;
-// 	vec3 diffuse;
-// 	vec3 specular;
+// LightManager::pointLightBinding
+layout(std430, binding=1) readonly buffer Lights {
+	PointLight lights[];
+};
 
-// 	vec3 attenuation;
-// };
+layout(location=0) flat in int iLight;
 
-// uniform SpotLight slights[MAX_NUM_LIGHT_SOURCES];
-// uniform int slights_count;
+PointLight light;
 
 layout(location=0) out vec4 oColor;
 
 vec3 CalcPointLight(vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spec);
-// vec3 CalcSpotLight(SpotLight light, vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spec);
 
 float CalcAttenuation(float dist, float rad, float falloff);
 vec2 CalcUV();
 
 void main()
 {
+	light = lights[iLight];
+
 	vec2 uv = CalcUV();
 	vec3 pos = texture(gPos, uv).xyz;
 	vec3 norm = texture(gNorm, uv).xyz;
@@ -52,17 +53,10 @@ void main()
 	vec3 diff = temp.rgb;
 	float spec = temp.a;
 
-	vec3 cam_dir = normalize(cam_pos - pos);
+	vec3 cam_dir = normalize(frame.cameraPos.xyz - pos);
 
-	// Point Light
 	vec3 tempCol = CalcPointLight(norm, cam_dir, pos, diff, spec);
 
-	// Spot Lights
-	// for (int i = 0; i < slights_count; i++)
-	// {
-	// 	tempCol += CalcSpotLight(slights[i], norm, cam_dir, pos, diff, spec);
-	// }
-
 	float gamma = 0.9;
 	tempCol = pow(tempCol, vec3(1.0 / gamma));
 	oColor = vec4(tempCol, 1.0);
@@ -85,27 +79,6 @@ vec3 CalcPointLight(vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spe
 	return (ambient + diffuse + specular) * attenuation;
 }
 
-// vec3 CalcSpotLight(SpotLight light, vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spec)
-// {
-// 	vec3 ambient = light.ambient * diff;
-	
-// 	vec3 ldir = normalize(light.pos - frag_pos);
-// 	float d = max(dot(norm, ldir), 0.0);
-// 	vec3 diffuse = light.diffuse * d * diff;
-
-// 	vec3 halfwaydir = normalize(ldir + cam_dir);
-// 	float s = pow(max(dot(norm, -halfwaydir), d), spec * 128.0);
-// 	vec3 specular = light.specular * spec * diff;
-
-// 	float theta = dot(ldir, normalize(-light.dir));
-// 	float epsilon = light.cutoff - light.outerCutoff;
-// 	float intensity = clamp((theta - light.outerCutoff) / epsilon, 0.0, 1.0);
-
-// 	float dist = length(light.pos - frag_pos);
-// 	float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * dist + light.attenuation.z * (dist * dist));
-// 	return (ambient + (diffuse + specular) * intensity) * attenuation;
-// }
-
 float CalcAttenuation(float dist, float rad, float falloff)
 {
 	float s = dist / rad;
@@ -117,5 +90,5 @@ float CalcAttenuation(float dist, float rad, float falloff)
 }
 
 vec2 CalcUV() {
-	return gl_FragCoord.xy / screen_dim;
+	return gl_FragCoord.xy * frame.screenSize.zw;
 }
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 460 core
+layout(location=0) in vec3 iPos;
+
+layout(location=0) flat out int oLight;
+
+struct PointLight {
+	vec3 pos;
+	float radius;
+	vec3 ambient;
+	float falloff;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// LightManager::pointLightBinding
+layout(std430, binding=1) readonly buffer Lights {
+	PointLight lights[];
+};
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
+
+// one instance of the unit sphere per light, scaled to its radius
+void main()
+{
+	PointLight light = lights[gl_InstanceID];
+	gl_Position = frame.viewProjection * vec4(light.pos + iPos * light.radius, 1);
+	oLight = gl_InstanceID;
+}
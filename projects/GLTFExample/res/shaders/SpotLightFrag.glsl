@@ -0,0 +1,91 @@
+#version 460 core
+uniform sampler2D gPos;
+uniform sampler2D gCol;
+uniform sampler2D gNorm;
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
+
+struct SpotLight {
+	vec3 pos;
+	float range;
+	vec3 dir;
+	float cosCutoff;
+	vec3 ambient;
+	float cosOuterCutoff;
+	vec3 diffuse;
+	vec3 specular;
+	vec3 attenuation;
+};
+
+// LightManager::spotLightBinding
+layout(std430, binding=4) readonly buffer SpotLights {
+	SpotLight lights[];
+};
+
+layout(location=0) flat in int iLight;
+
+SpotLight light;
+
+layout(location=0) out vec4 oColor;
+
+vec3 CalcSpotLight(vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spec);
+vec2 CalcUV();
+
+void main()
+{
+	light = lights[iLight];
+
+	vec2 uv = CalcUV();
+	vec3 pos = texture(gPos, uv).xyz;
+	vec3 norm = texture(gNorm, uv).xyz;
+	vec4 temp = texture(gCol, uv);
+	vec3 diff = temp.rgb;
+	float spec = temp.a;
+
+	vec3 cam_dir = normalize(frame.cameraPos.xyz - pos);
+
+	vec3 tempCol = CalcSpotLight(norm, cam_dir, pos, diff, spec);
+
+	float gamma = 0.9;
+	tempCol = pow(tempCol, vec3(1.0 / gamma));
+	oColor = vec4(tempCol, 1.0);
+}
+
+vec3 CalcSpotLight(vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spec)
+{
+	vec3 ldir = normalize(light.pos - frag_pos);
+	float theta = dot(ldir, normalize(-light.dir));
+	float epsilon = max(light.cosCutoff - light.cosOuterCutoff, 1e-4);
+	float intensity = clamp((theta - light.cosOuterCutoff) / epsilon, 0.0, 1.0);
+
+	vec3 ambient = light.ambient * diff;
+
+	float d = max(dot(norm, ldir), 0.0);
+	vec3 diffuse = light.diffuse * d * diff;
+
+	vec3 halfwaydir = normalize(ldir + cam_dir);
+	float s = pow(max(dot(norm, -halfwaydir), d), spec * 128.0);
+	vec3 specular = light.specular * s * diff;
+
+	// the attenuation curve is windowed to reach zero at the range, where the cone volume ends
+	float dist = length(light.pos - frag_pos);
+	float r = min(dist / light.range, 1.0);
+	float window = (1.0 - r * r) * (1.0 - r * r);
+	float attenuation = window / (light.attenuation.x + light.attenuation.y * dist + light.attenuation.z * (dist * dist));
+	return (ambient + (diffuse + specular) * intensity) * attenuation;
+}
+
+vec2 CalcUV() {
+	return gl_FragCoord.xy * frame.screenSize.zw;
+}
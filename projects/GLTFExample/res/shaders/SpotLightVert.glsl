@@ -0,0 +1,53 @@
+#version 460 core
+layout(location=0) in vec3 iPos;
+
+layout(location=0) flat out int oLight;
+
+struct SpotLight {
+	vec3 pos;
+	float range;
+	vec3 dir;
+	float cosCutoff;
+	vec3 ambient;
+	float cosOuterCutoff;
+	vec3 diffuse;
+	vec3 specular;
+	vec3 attenuation;
+};
+
+// LightManager::spotLightBinding
+layout(std430, binding=4) readonly buffer SpotLights {
+	SpotLight lights[];
+};
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
+
+// one instance of the unit cone per light, its apex on the light, stretched to the range along the
+// light's direction and to the outer cutoff across it
+void main()
+{
+	SpotLight light = lights[gl_InstanceID];
+
+	vec3 w = normalize(light.dir);
+	vec3 up = abs(w.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+	vec3 u = normalize(cross(up, w));
+	vec3 v = cross(w, u);
+
+	float c = max(light.cosOuterCutoff, 0.02);
+	float radius = light.range * sqrt(1.0 - c * c) / c;
+
+	vec3 pos = light.pos + (u * iPos.x + v * iPos.y) * radius + w * (iPos.z * light.range);
+	gl_Position = frame.viewProjection * vec4(pos, 1);
+	oLight = gl_InstanceID;
+}
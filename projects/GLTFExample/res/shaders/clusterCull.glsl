@@ -0,0 +1,116 @@
+#version 460 core
+// ClusteredLighting::cullGroupSize
+layout(local_size_x = 128) in;
+
+struct PointLight {
+	vec3 pos;
+	float radius;
+	vec3 ambient;
+	float falloff;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// LightManager::pointLightBinding, ClusteredLighting::countBinding and indexBinding
+layout(std430, binding=1) readonly buffer Lights {
+	PointLight lights[];
+};
+
+layout(std430, binding=2) writeonly buffer ClusterCounts {
+	uint clusterCounts[];
+};
+
+layout(std430, binding=3) writeonly buffer ClusterLights {
+	uint clusterLights[];
+};
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
+
+uniform int screenWidth;
+uniform int screenHeight;
+uniform int tileSize;
+uniform int tilesX;
+uniform int tilesY;
+uniform int depthSlices;
+uniform float zNear;
+uniform float zFar;
+uniform int lightCount;
+uniform int maxLightsPerCluster;
+
+// view space position and radius of a batch of lights, shared by the whole group
+shared vec4 batch[128];
+
+// the point on the view ray through an NDC corner at the given distance in front of the camera
+vec3 CornerAt(vec2 ndc, float depth)
+{
+	vec4 p = frame.inverseProjection * vec4(ndc, -1.0, 1.0);
+	vec3 dir = p.xyz / p.w;
+	return dir * (depth / -dir.z);
+}
+
+void main()
+{
+	uint cluster = gl_GlobalInvocationID.x;
+	uint clusterCount = uint(tilesX * tilesY * depthSlices);
+	bool active = cluster < clusterCount;
+
+	// x fastest, then y, then the depth slice
+	int tx = int(cluster) % tilesX;
+	int ty = (int(cluster) / tilesX) % tilesY;
+	int slice = int(cluster) / (tilesX * tilesY);
+
+	// slices are spaced exponentially, the same as the shading pass picks them
+	float sliceNear = zNear * pow(zFar / zNear, float(slice) / float(depthSlices));
+	float sliceFar = zNear * pow(zFar / zNear, float(slice + 1) / float(depthSlices));
+
+	// the last row and column of tiles reach past the screen
+	vec2 screen = vec2(screenWidth, screenHeight);
+	vec2 tileMin = vec2(tx, ty) * float(tileSize) / screen * 2.0 - 1.0;
+	vec2 tileMax = min(vec2(tx + 1, ty + 1) * float(tileSize) / screen * 2.0 - 1.0, vec2(1.0));
+	vec3 aabbMin = vec3(1e30);
+	vec3 aabbMax = vec3(-1e30);
+	for (int c = 0; c < 4; c++) {
+		vec2 ndc = vec2((c & 1) == 0 ? tileMin.x : tileMax.x, (c & 2) == 0 ? tileMin.y : tileMax.y);
+		vec3 n = CornerAt(ndc, sliceNear);
+		vec3 f = CornerAt(ndc, sliceFar);
+		aabbMin = min(aabbMin, min(n, f));
+		aabbMax = max(aabbMax, max(n, f));
+	}
+
+	uint count = 0;
+	uint base = cluster * uint(maxLightsPerCluster);
+	for (int first = 0; first < lightCount; first += 128) {
+		int l = first + int(gl_LocalInvocationIndex);
+		if (l < lightCount) {
+			batch[gl_LocalInvocationIndex] = vec4((frame.view * vec4(lights[l].pos, 1.0)).xyz, lights[l].radius);
+		}
+		barrier();
+
+		int batchSize = min(128, lightCount - first);
+		for (int i = 0; active && i < batchSize; i++) {
+			vec4 light = batch[i];
+			vec3 closest = clamp(light.xyz, aabbMin, aabbMax);
+			vec3 d = closest - light.xyz;
+			if (dot(d, d) <= light.w * light.w && count < uint(maxLightsPerCluster)) {
+				clusterLights[base + count] = uint(first + i);
+				count++;
+			}
+		}
+		barrier();
+	}
+
+	if (active) {
+		clusterCounts[cluster] = count;
+	}
+}
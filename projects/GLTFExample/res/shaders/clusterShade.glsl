@@ -0,0 +1,145 @@
+#version 460 core
+// ClusteredLighting::shadeGroupSize
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D gPos;
+uniform sampler2D gCol;
+uniform sampler2D gNorm;
+
+layout(rgba8, binding=0) uniform writeonly image2D oColor;
+
+struct PointLight {
+	vec3 pos;
+	float radius;
+	vec3 ambient;
+	float falloff;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct DirectionalLight {
+	vec3 dir;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// LightManager::pointLightBinding, ClusteredLighting::countBinding and indexBinding
+layout(std430, binding=1) readonly buffer Lights {
+	PointLight lights[];
+};
+
+layout(std430, binding=2) readonly buffer ClusterCounts {
+	uint clusterCounts[];
+};
+
+layout(std430, binding=3) readonly buffer ClusterLights {
+	uint clusterLights[];
+};
+
+uniform DirectionalLight dlight;
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
+
+uniform int screenWidth;
+uniform int screenHeight;
+uniform int tileSize;
+uniform int tilesX;
+uniform int tilesY;
+uniform int depthSlices;
+uniform float zNear;
+uniform float zFar;
+uniform int maxLightsPerCluster;
+
+float CalcAttenuation(float dist, float rad, float falloff)
+{
+	float s = dist / rad;
+	if (s >= 1.0)
+		return 0.0;
+
+	float s2 = s * s;
+	return 2 * (1 - s2) * (1 - s2) / (1 + falloff * s2);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 norm, vec3 cam_dir, vec3 frag_pos, vec3 diff, float spec)
+{
+	vec3 ambient = light.ambient * diff;
+
+	vec3 ldir = normalize(light.pos - frag_pos);
+	float d = max(dot(norm, ldir), 0.0);
+	vec3 diffuse = light.diffuse * d * diff;
+
+	vec3 halfwaydir = normalize(ldir + cam_dir);
+	float s = pow(max(dot(norm, -halfwaydir), d), spec * 128.0);
+	vec3 specular = light.specular * s * diff;
+
+	float dist = length(light.pos - frag_pos);
+	float attenuation = CalcAttenuation(dist, light.radius, light.falloff);
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcDirectionalLight(vec3 norm, vec3 cam_dir, vec3 diff, float spec)
+{
+	vec3 ambient = dlight.ambient * diff;
+
+	vec3 ldir = normalize(-dlight.dir);
+	float d = max(dot(norm, ldir), 0.0);
+	vec3 diffuse = dlight.diffuse * d * diff;
+
+	vec3 halfwaydir = normalize(ldir + cam_dir);
+	float s = pow(max(dot(norm, -halfwaydir), d), spec * 128.0);
+	vec3 specular = dlight.specular * s * diff;
+
+	return ambient + diffuse + specular;
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (pixel.x >= screenWidth || pixel.y >= screenHeight)
+		return;
+
+	vec3 pos = texelFetch(gPos, pixel, 0).xyz;
+	vec3 norm = texelFetch(gNorm, pixel, 0).xyz;
+	vec4 temp = texelFetch(gCol, pixel, 0);
+	vec3 diff = temp.rgb;
+	float spec = temp.a;
+
+	// nothing was drawn here
+	if (dot(norm, norm) == 0.0) {
+		imageStore(oColor, pixel, vec4(0.0, 0.0, 0.0, 1.0));
+		return;
+	}
+
+	vec3 cam_dir = normalize(frame.cameraPos.xyz - pos);
+
+	// the light passes this replaces applied the gamma per light and summed the results with blending
+	float gamma = 0.9;
+	vec3 color = pow(CalcDirectionalLight(norm, cam_dir, diff, spec), vec3(1.0 / gamma));
+
+	float depth = -(frame.view * vec4(pos, 1.0)).z;
+	int slice = clamp(int(log(depth / zNear) / log(zFar / zNear) * float(depthSlices)), 0, depthSlices - 1);
+	ivec2 tile = min(pixel / tileSize, ivec2(tilesX, tilesY) - 1);
+	uint cluster = uint((slice * tilesY + tile.y) * tilesX + tile.x);
+
+	uint count = clusterCounts[cluster];
+	uint base = cluster * uint(maxLightsPerCluster);
+	for (uint i = 0; i < count; i++) {
+		PointLight light = lights[clusterLights[base + i]];
+		color += pow(CalcPointLight(light, norm, cam_dir, pos, diff, spec), vec3(1.0 / gamma));
+	}
+
+	imageStore(oColor, pixel, vec4(color, 1.0));
+}
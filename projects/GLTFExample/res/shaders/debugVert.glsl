@@ -3,20 +3,65 @@ layout(location=0) in vec3 iPos;
 
 layout(location=0) out vec3 oCol;
 
-uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 perspective;
+struct PointLight {
+	vec3 pos;
+	float radius;
+	vec3 ambient;
+	float falloff;
+	vec3 diffuse;
+	vec3 specular;
+};
 
-struct Light {
+struct SpotLight {
+	vec3 pos;
+	float range;
+	vec3 dir;
+	float cosCutoff;
 	vec3 ambient;
+	float cosOuterCutoff;
 	vec3 diffuse;
 	vec3 specular;
+	vec3 attenuation;
 };
 
-uniform Light light;
+// LightManager::pointLightBinding and spotLightBinding
+layout(std430, binding=1) readonly buffer PointLights {
+	PointLight plights[];
+};
+
+layout(std430, binding=4) readonly buffer SpotLights {
+	SpotLight slights[];
+};
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
+
+uniform int pointCount;
+uniform float gizmoScale;
 
+// one small sphere per light, the point lights' instances first and the spot lights' after them
 void main()
 {
-	gl_Position = perspective * view * transform * vec4(iPos, 1);
-	oCol = light.ambient + light.diffuse + light.specular;
+	vec3 pos;
+	if (gl_InstanceID < pointCount) {
+		PointLight light = plights[gl_InstanceID];
+		pos = light.pos;
+		oCol = light.ambient + light.diffuse + light.specular;
+	}
+	else {
+		SpotLight light = slights[gl_InstanceID - pointCount];
+		pos = light.pos;
+		oCol = light.ambient + light.diffuse + light.specular;
+	}
+	gl_Position = frame.viewProjection * vec4(pos + iPos * gizmoScale, 1);
 }
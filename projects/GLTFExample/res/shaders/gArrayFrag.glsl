@@ -0,0 +1,76 @@
+#version 460 core
+layout(location=0) in vec3 iPos;
+layout(location=1) in vec3 iNorm;
+layout(location=2) in vec2 iUV;
+layout(location=3) in mat3 iTBN;
+
+layout(location=0) out vec3 gPos;
+layout(location=1) out vec4 gCol;
+layout(location=2) out vec3 gNorm;
+
+struct VirtualSlot {
+	vec2 pages;
+	float atlasPages;
+	int levels;
+};
+
+// MaterialTable's GpuMaterial
+struct Material {
+	vec4 ambient;
+	float roughness;
+	float shininess;
+	bool normalMapped;
+	// TextureArray layers, -1 for textures not packed into one
+	int diffuseLayer;
+	int surfaceLayer;
+	// VirtualTextureSystem ids, -1 for textures that are not virtual
+	int diffuseVirtual;
+	int surfaceVirtual;
+	VirtualSlot virtualDiffuse;
+	VirtualSlot virtualSurface;
+};
+
+// MaterialTable::binding
+layout(std430, binding=5) readonly buffer Materials {
+	Material materials[];
+};
+
+layout(location=6) flat in uint iMaterial;
+
+layout(binding=0) uniform sampler2D diffuseTex;
+// R roughness, G normal Y, B metalness, A normal X
+layout(binding=1) uniform sampler2D surfaceTex;
+
+// the TextureArrays the packed textures were moved into
+layout(binding=10) uniform sampler2DArray diffuseArray;
+layout(binding=11) uniform sampler2DArray surfaceArray;
+
+// the surface texture keeps two normal components, Z is rebuilt
+vec3 UnpackNormal(vec4 surface)
+{
+	vec3 n;
+	n.xy = surface.ag * 2.0 - 1.0;
+	n.z = sqrt(max(1.0 - dot(n.xy, n.xy), 0.0));
+	return n;
+}
+
+vec4 SampleSlot(sampler2DArray array, int layer, sampler2D fallback, vec2 uv)
+{
+	if (layer >= 0)
+		return texture(array, vec3(uv, float(layer)));
+	return texture(fallback, uv);
+}
+
+void main()
+{
+	Material material = materials[iMaterial];
+	vec4 col = SampleSlot(diffuseArray, material.diffuseLayer, diffuseTex, iUV);
+	if (col.a < 0.5)
+		discard;
+
+	gPos = iPos;
+	gCol.rgb = col.rgb;
+	vec4 surface = SampleSlot(surfaceArray, material.surfaceLayer, surfaceTex, iUV);
+	gCol.a = surface.r;
+	gNorm = material.normalMapped ? normalize(iTBN * UnpackNormal(surface)) : normalize(iNorm);
+}
@@ -7,25 +7,18 @@ layout(location=0) out vec3 gPos;
 layout(location=1) out vec4 gCol;
 layout(location=2) out vec3 gNorm;
 
-struct Material {
-	sampler2D diffuse;
-	sampler2D specular;
-	sampler2D normal;
-	vec4 ambient;
-	float roughness;
-	float shininess;
-};
-
-uniform Material material;
+layout(binding=0) uniform sampler2D diffuseTex;
+// R roughness, G normal Y, B metalness, A normal X
+layout(binding=1) uniform sampler2D surfaceTex;
 
 void main()
 {
-	vec4 col = texture(material.diffuse, iUV);
+	vec4 col = texture(diffuseTex, iUV);
 	if (col.a < 0.5)
 		discard;
 
 	gPos = iPos;
-	gCol.rgb = texture(material.diffuse, iUV).rgb;
-	gCol.a = texture(material.specular, iUV).g;
+	gCol.rgb = col.rgb;
+	gCol.a = texture(surfaceTex, iUV).r;
 	gNorm = normalize(iNorm);
 }
\ No newline at end of file
@@ -8,25 +8,28 @@ layout(location=0) out vec3 gPos;
 layout(location=1) out vec4 gCol;
 layout(location=2) out vec3 gNorm;
 
-struct Material {
-	sampler2D diffuse;
-	sampler2D specular;
-	sampler2D normal;
-	vec4 ambient;
-	float roughness;
-	float shininess;
-};
+layout(binding=0) uniform sampler2D diffuseTex;
+// R roughness, G normal Y, B metalness, A normal X
+layout(binding=1) uniform sampler2D surfaceTex;
 
-uniform Material material;
+// the surface texture keeps two normal components, Z is rebuilt
+vec3 UnpackNormal(vec4 surface)
+{
+	vec3 n;
+	n.xy = surface.ag * 2.0 - 1.0;
+	n.z = sqrt(max(1.0 - dot(n.xy, n.xy), 0.0));
+	return n;
+}
 
 void main()
 {
-	vec4 col = texture(material.diffuse, iUV);
+	vec4 col = texture(diffuseTex, iUV);
 	if (col.a < 0.5)
 		discard;
 
 	gPos = iPos;
-	gCol.rgb = texture(material.diffuse, iUV).rgb;
-	gCol.a = texture(material.specular, iUV).g;
-	gNorm = normalize(iTBN * (texture(material.normal, iUV).rgb * 2.0 - 1.0));
+	vec4 surface = texture(surfaceTex, iUV);
+	gCol.rgb = col.rgb;
+	gCol.a = surface.r;
+	gNorm = normalize(iTBN * UnpackNormal(surface));
 }
\ No newline at end of file
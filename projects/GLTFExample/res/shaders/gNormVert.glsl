@@ -8,14 +8,43 @@ layout(location=0) out vec3 oPos;
 layout(location=1) out vec3 oNorm;
 layout(location=2) out vec2 oUV;
 layout(location=3) out mat3 oTBN;
+// into the MaterialTable
+layout(location=6) flat out uint oMaterial;
 
-uniform mat4 transform;
-uniform mat4 view;
-uniform mat4 perspective;
+// RenderQueue::GpuDraw
+struct Draw {
+	uint firstInstance;
+	uint material;
+};
+
+// RenderQueue::instanceBinding and drawBinding, a draw's record is at its base instance
+layout(std430, binding=6) readonly buffer Instances {
+	mat4 transforms[];
+};
+
+layout(std430, binding=7) readonly buffer Draws {
+	Draw draws[];
+};
+
+// FrameUniforms::binding, written once per frame
+layout(std140, binding=0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseView;
+	mat4 inverseProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPos;
+	// width, height and their reciprocals
+	vec4 screenSize;
+} frame;
 
 void main()
 {
-	gl_Position = perspective * view * transform * vec4(iPos, 1);
+	Draw draw = draws[gl_BaseInstance];
+	mat4 transform = transforms[draw.firstInstance + gl_InstanceID];
+
+	gl_Position = frame.viewProjection * transform * vec4(iPos, 1);
 	vec3 norm = mat3(transpose(inverse(transform))) * iNorm;
 	vec3 T = normalize(vec3(transform * vec4(iTan.rgb, 0.0)));
 	vec3 N = normalize(vec3(transform * vec4(norm, 0.0)));
@@ -26,4 +55,5 @@ void main()
 	oPos = (transform * vec4(iPos, 1.0)).xyz;
 	oNorm = norm;
 	oUV = iUV;
+	oMaterial = draw.material;
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+#version 460 core
+layout(location=0) in vec3 iPos;
+layout(location=1) in vec3 iNorm;
+layout(location=2) in vec2 iUV;
+layout(location=3) in mat3 iTBN;
+
+layout(location=0) out vec3 gPos;
+layout(location=1) out vec4 gCol;
+layout(location=2) out vec3 gNorm;
+
+// VirtualTextureSystem::pageSize and pageBorder
+const float PAGE_SIZE = 128.0;
+const float PAGE_BORDER = 4.0;
+
+struct VirtualSlot {
+	vec2 pages;
+	float atlasPages;
+	int levels;
+};
+
+// MaterialTable's GpuMaterial
+struct Material {
+	vec4 ambient;
+	float roughness;
+	float shininess;
+	bool normalMapped;
+	// TextureArray layers, -1 for textures not packed into one
+	int diffuseLayer;
+	int surfaceLayer;
+	// VirtualTextureSystem ids, -1 for textures that are not virtual
+	int diffuseVirtual;
+	int surfaceVirtual;
+	VirtualSlot virtualDiffuse;
+	VirtualSlot virtualSurface;
+};
+
+// MaterialTable::binding
+layout(std430, binding=5) readonly buffer Materials {
+	Material materials[];
+};
+
+layout(location=6) flat in uint iMaterial;
+
+layout(binding=0) uniform sampler2D diffuseTex;
+// R roughness, G normal Y, B metalness, A normal X
+layout(binding=1) uniform sampler2D surfaceTex;
+
+// the indirection table and atlas of each virtual texture
+layout(binding=3) uniform usampler2D diffuseIndirection;
+layout(binding=4) uniform sampler2D diffuseAtlas;
+layout(binding=5) uniform usampler2D surfaceIndirection;
+layout(binding=6) uniform sampler2D surfaceAtlas;
+
+// the surface texture keeps two normal components, Z is rebuilt
+vec3 UnpackNormal(vec4 surface)
+{
+	vec3 n;
+	n.xy = surface.ag * 2.0 - 1.0;
+	n.z = sqrt(max(1.0 - dot(n.xy, n.xy), 0.0));
+	return n;
+}
+
+// one page request per feedbackScale² pixels, written by the pixel of the cell picked by feedbackJitter
+layout(std430, binding=0) writeonly buffer Feedback {
+	uint requests[];
+};
+
+uniform int feedbackWidth;
+uniform int feedbackScale;
+uniform int feedbackJitter;
+uniform int feedbackSlot;
+
+// the texel of a resident page, the entry points at the page itself or at the closest parent that is resident
+vec4 SamplePage(VirtualSlot vt, usampler2D indirection, sampler2D atlas, vec2 wrapped, int level)
+{
+	ivec2 pages = max(ivec2(vt.pages) >> level, ivec2(1));
+	ivec2 page = min(ivec2(wrapped * vec2(pages)), pages - 1);
+	uvec4 entry = texelFetch(indirection, page, level);
+	vec2 residentPages = vec2(max(ivec2(vt.pages) >> int(entry.z), ivec2(1)));
+	vec2 inPage = fract(wrapped * residentPages);
+
+	// the atlas holds every page at its own level's resolution in a single mip
+	float physical = PAGE_SIZE + 2.0 * PAGE_BORDER;
+	vec2 atlasUV = (vec2(entry.xy) * physical + PAGE_BORDER + inPage * PAGE_SIZE) / (vt.atlasPages * physical);
+	return textureLod(atlas, atlasUV, 0.0);
+}
+
+vec4 SampleVirtual(VirtualSlot vt, int id, usampler2D indirection, sampler2D atlas, sampler2D fallback, vec2 uv, int slot)
+{
+	if (id < 0)
+		return texture(fallback, uv);
+
+	// the finer of the two mips trilinear filtering would blend
+	vec2 texels = uv * vt.pages * PAGE_SIZE;
+	vec2 dx = dFdx(texels);
+	vec2 dy = dFdy(texels);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+	int level = clamp(int(floor(lod)), 0, vt.levels - 1);
+
+	vec2 wrapped = fract(uv);
+	ivec2 pages = max(ivec2(vt.pages) >> level, ivec2(1));
+	ivec2 page = min(ivec2(wrapped * vec2(pages)), pages - 1);
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 jitter = ivec2(feedbackJitter % feedbackScale, feedbackJitter / feedbackScale);
+	if (slot == feedbackSlot && pixel % feedbackScale == jitter) {
+		ivec2 cell = pixel / feedbackScale;
+		requests[cell.y * feedbackWidth + cell.x] =
+			(uint(id) << 20) | (uint(level) << 16) | (uint(page.x) << 8) | uint(page.y);
+	}
+
+	// trilinear across pages: the page of the level and its parent, blended by the fraction of the lod
+	// between them; the parent is always requested along with the page
+	int coarser = min(level + 1, vt.levels - 1);
+	float blend = coarser > level ? clamp(lod - float(level), 0.0, 1.0) : 0.0;
+	vec4 fine = SamplePage(vt, indirection, atlas, wrapped, level);
+	if (blend == 0.0)
+		return fine;
+	return mix(fine, SamplePage(vt, indirection, atlas, wrapped, coarser), blend);
+}
+
+void main()
+{
+	Material material = materials[iMaterial];
+	vec4 col = SampleVirtual(material.virtualDiffuse, material.diffuseVirtual, diffuseIndirection, diffuseAtlas, diffuseTex, iUV, 0);
+	vec4 surface = SampleVirtual(material.virtualSurface, material.surfaceVirtual, surfaceIndirection, surfaceAtlas, surfaceTex, iUV, 1);
+	if (col.a < 0.5)
+		discard;
+
+	gPos = iPos;
+	gCol.rgb = col.rgb;
+	gCol.a = surface.r;
+	gNorm = material.normalMapped ? normalize(iTBN * UnpackNormal(surface)) : normalize(iNorm);
+}
@@ -1,5 +0,0 @@
-#version 460 core
-
-void main()
-{
-}
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <string>
+
+#include "config.h"
+
+#include "math/math.h"
+#include "render/camera.h"
+#include "render/light.h"
+#include "render/lightClusterBuilder.h"
+#include "util/threadPool.h"
+
+const char* programName = "Light cluster builder";
+const char* s = "OK";
+const char* f = "FAILED";
+
+typedef unsigned TestId;
+typedef unsigned Line;
+typedef std::string Expression;
+struct FailedTest {
+    TestId id;
+    Line line;
+    Expression expr;
+};
+static TestId testId = 0;
+static std::vector<FailedTest> failedTests;
+#define VERIFY(RESULT) {  testId++; printf("#%0*u: %*s\n", 3, testId, 6, RESULT ? s : f); if (!(RESULT)) failedTests.push_back({testId, __LINE__, #RESULT}); }
+
+static Math::vec3 ToView(const Render::Camera& cam, const Math::vec3& p)
+{
+    const Math::vec4 v = cam.GetView() * Math::vec4(p.x, p.y, p.z, 1.0f);
+    return Math::vec3(v.x, v.y, v.z);
+}
+
+// does the cluster hold the light, point lights come first in its index range
+static bool Lists(const Render::LightClusterBuilder& builder, int cluster, unsigned light, bool spot)
+{
+    const auto& c = builder.GetClusters()[cluster];
+    const auto& indices = builder.GetIndices();
+    const unsigned begin = c.offset + (spot ? c.PointCount() : 0);
+    const unsigned end = begin + (spot ? c.SpotCount() : c.PointCount());
+    for (unsigned i = begin; i < end; ++i)
+        if (indices[i] == light) return true;
+    return false;
+}
+
+// every sampled point inside a light must land in a cluster that lists it
+static bool NoFalseNegatives(const Render::LightClusterBuilder& builder, const Render::Camera& cam,
+    const Render::LightManager& lights, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const auto& points = lights.GetPointLights();
+    for (unsigned i = 0; i < points.size(); ++i) {
+        for (int n = 0; n < 64; ++n) {
+            Math::vec3 d(unit(rng), unit(rng), unit(rng));
+            if (Math::length(d) > 1.0f) continue;
+            const Math::vec3 pos(points.x[i], points.y[i], points.z[i]);
+            const int cluster = builder.ClusterOf(ToView(cam, pos + d * points.radius[i]));
+            if (cluster >= 0 && !Lists(builder, cluster, i, false)) return false;
+        }
+    }
+    const auto& spots = lights.GetSpotLights();
+    for (unsigned i = 0; i < spots.size(); ++i) {
+        const float cosAngle = std::cos(spots[i].GetOuterCutoffAngle());
+        const Math::vec3 dir = Math::normalize(spots[i].GetDirection());
+        for (int n = 0; n < 256; ++n) {
+            Math::vec3 d(unit(rng), unit(rng), unit(rng));
+            const float length = Math::length(d);
+            if (length > 1.0f || length < 1e-3f || Math::dot(d * (1.0f / length), dir) < cosAngle) continue;
+            const int cluster = builder.ClusterOf(ToView(cam, spots[i].GetPos() + d * spots[i].GetRadius()));
+            if (cluster >= 0 && !Lists(builder, cluster, i, true)) return false;
+        }
+    }
+    return true;
+}
+
+static void Scatter(Render::LightManager& lights, std::mt19937& rng, int pointCount, int spotCount)
+{
+    std::uniform_real_distribution<float> xz(-60.0f, 60.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 12.0f);
+    std::uniform_real_distribution<float> angle(0.1f, 1.4f);
+    const Math::vec3 white(1.0f, 1.0f, 1.0f);
+    for (int i = 0; i < pointCount; ++i)
+        lights.PushPointLight(Render::PointLight(Math::vec3(xz(rng), unit(rng) * 10.0f, xz(rng)),
+            white, white, white, radius(rng), 1.0f));
+    for (int i = 0; i < spotCount; ++i) {
+        const float outer = angle(rng);
+        Render::SpotLight sl(Math::vec3(xz(rng), unit(rng) * 10.0f, xz(rng)),
+            Math::normalize(Math::vec3(unit(rng), unit(rng), unit(rng) + 0.01f)), outer * 0.8f, outer,
+            white, white, white, Math::vec3(1.0f, 0.0f, 0.0f));
+        sl.SetRadius(radius(rng) * 2.0f);
+        lights.PushSpotLight(sl);
+    }
+}
+
+int main()
+{
+    printf("\n\n--- %s test\n", programName);
+
+    std::mt19937 rng(1234);
+    Render::Camera cam(Math::toRad(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    // the camera starts out looking down +x
+    cam.SetCameraPosition(Math::vec3(-80.0f, 0.0f, 0.0f));
+
+    Utils::ThreadPool pool;
+
+    {
+        printf("binning:\n");
+
+        Render::LightManager lights;
+        Scatter(lights, rng, 300, 100);
+
+        Render::LightClusterBuilder serial;
+        serial.Build(lights, cam);
+        VERIFY((int)serial.GetClusters().size() == serial.GetClusterCount());
+        VERIFY(serial.GetStats().references == serial.GetIndices().size());
+        VERIFY(NoFalseNegatives(serial, cam, lights, rng));
+
+        // the pool bins slice by slice into the same layout
+        Render::LightClusterBuilder parallel;
+        parallel.Build(lights, cam, &pool);
+        bool same = serial.GetIndices() == parallel.GetIndices();
+        for (int i = 0; same && i < serial.GetClusterCount(); ++i)
+            same = serial.GetClusters()[i].offset == parallel.GetClusters()[i].offset
+                && serial.GetClusters()[i].counts == parallel.GetClusters()[i].counts;
+        VERIFY(same);
+
+        // a coarser grid still holds every light it should
+        Render::LightClusterBuilder coarse;
+        coarse.SetSettings({ 4, 3, 8 });
+        coarse.Build(lights, cam, &pool);
+        VERIFY(coarse.GetClusterCount() == 4 * 3 * 8);
+        VERIFY(NoFalseNegatives(coarse, cam, lights, rng));
+    }
+
+    {
+        printf("culling:\n");
+
+        Render::LightManager lights;
+        const Math::vec3 white(1.0f, 1.0f, 1.0f);
+        // a light far behind the camera touches no cluster
+        lights.PushPointLight(Render::PointLight(Math::vec3(-150.0f, 0.0f, 0.0f), white, white, white, 2.0f, 1.0f));
+        // a narrow spot pointing back at the camera, the clusters well behind its apex stay empty
+        Render::SpotLight sl(Math::vec3(0.0f, 0.0f, 0.0f), Math::vec3(-1.0f, 0.0f, 0.0f), 0.1f, 0.2f,
+            white, white, white, Math::vec3(1.0f, 0.0f, 0.0f));
+        sl.SetRadius(30.0f);
+        lights.PushSpotLight(sl);
+
+        Render::LightClusterBuilder builder;
+        builder.Build(lights, cam);
+        const int behind = builder.ClusterOf(ToView(cam, Math::vec3(40.0f, 0.0f, 0.0f)));
+        const int inside = builder.ClusterOf(ToView(cam, Math::vec3(-15.0f, 0.0f, 0.0f)));
+        VERIFY(behind >= 0 && inside >= 0 && behind != inside);
+        VERIFY(behind >= 0 && !Lists(builder, behind, 0, true));
+        VERIFY(inside >= 0 && Lists(builder, inside, 0, true));
+        unsigned points = 0;
+        for (const auto& c : builder.GetClusters()) points += c.PointCount();
+        VERIFY(points == 0);
+        VERIFY(builder.ClusterOf(Math::vec3(0.0f, 0.0f, 1.0f)) == -1);
+    }
+
+    {
+        printf("benchmark:\n");
+
+        Render::LightManager lights;
+        Scatter(lights, rng, 4096, 1024);
+
+        Render::LightClusterBuilder serial;
+        Render::LightClusterBuilder parallel;
+        for (int i = 0; i < 20; ++i) {
+            serial.Build(lights, cam);
+            parallel.Build(lights, cam, &pool);
+        }
+        printf("  4096 point + 1024 spot lights, serial:\n");
+        serial.PrintStats(std::cout);
+        printf("  pool of %u workers:\n", (unsigned)pool.GetWorkerCount());
+        parallel.PrintStats(std::cout);
+        VERIFY(serial.GetIndices() == parallel.GetIndices());
+    }
+
+    //------------------------------------------------------------------------
+    printf("--- Done\n\n");
+    if (failedTests.empty())
+    {
+        printf("--- %u/%u tests passed!\n\n", testId, testId);
+        return 0;
+    }
+    for (auto t : failedTests)
+        printf("Test #%u failed. Line %u, Expression: %s\n", t.id, t.line, t.expr.c_str());
+    printf("--- %u/%u tests failed!\n\n", (unsigned)failedTests.size(), testId);
+    return 1;
+}
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include "config.h"
+
+#include "math/math.h"
+#include "render/light.h"
+#include "util/threadPool.h"
+
+const char* programName = "Light manager";
+const char* s = "OK";
+const char* f = "FAILED";
+
+typedef unsigned TestId;
+typedef unsigned Line;
+typedef std::string Expression;
+struct FailedTest {
+    TestId id;
+    Line line;
+    Expression expr;
+};
+static TestId testId = 0;
+static std::vector<FailedTest> failedTests;
+#define VERIFY(RESULT) {  testId++; printf("#%0*u: %*s\n", 3, testId, 6, RESULT ? s : f); if (!(RESULT)) failedTests.push_back({testId, __LINE__, #RESULT}); }
+
+static Render::PointLight MakeLight(float x)
+{
+    const Math::vec3 white(1.0f, 1.0f, 1.0f);
+    return Render::PointLight(Math::vec3(x, 0.0f, 0.0f), white, white, white, 1.0f, 1.0f);
+}
+
+int main()
+{
+    printf("\n\n--- %s test\n", programName);
+
+    Utils::ThreadPool pool;
+
+    {
+        printf("handles:\n");
+
+        Render::LightManager lights;
+        Render::LightHandle a = lights.PushPointLight(MakeLight(1.0f));
+        Render::LightHandle b = lights.PushPointLight(MakeLight(2.0f));
+        Render::LightHandle c = lights.PushPointLight(MakeLight(3.0f));
+        VERIFY(lights.GetPointLightCount() == 3);
+
+        // the last light fills the hole, the handles still name the same lights
+        lights.RemovePointLight(a);
+        VERIFY(lights.GetPointLightCount() == 2);
+        VERIFY(!lights.IsAlive(a));
+        VERIFY(lights.IsAlive(b) && lights.GetPointLight(b).GetPos().x == 2.0f);
+        VERIFY(lights.IsAlive(c) && lights.GetPointLight(c).GetPos().x == 3.0f);
+        VERIFY(lights.IndexOf(c) == 0);
+
+        // a reused slot does not revive the old handle
+        Render::LightHandle d = lights.PushPointLight(MakeLight(4.0f));
+        VERIFY(d.slot == a.slot && !lights.IsAlive(a) && lights.IsAlive(d));
+        lights.RemovePointLight(a);
+        VERIFY(lights.GetPointLightCount() == 3);
+
+        lights.SetPointLight(b, MakeLight(5.0f));
+        VERIFY(lights.GetPointLight(b).GetPos().x == 5.0f);
+
+        // a stale handle resolves to nothing and touches no live light
+        VERIFY(lights.IndexOf(a) == Render::LightManager::invalidIndex);
+        lights.SetPointLight(a, MakeLight(6.0f));
+        lights.SetPointLightVelocity(a, Math::vec3(1.0f, 1.0f, 1.0f));
+        VERIFY(lights.GetPointLight(d).GetPos().x == 4.0f && lights.GetPointLight(a).GetPos().x == 0.0f);
+    }
+
+    {
+        printf("animation:\n");
+
+        Render::LightManager lights;
+        std::vector<Render::LightHandle> handles;
+        // odd counts leave lights for the scalar tail
+        for (int i = 0; i < 7; ++i)
+            handles.push_back(lights.PushPointLight(MakeLight(0.0f), Math::vec3(1.0f, -2.0f, 0.0f)));
+
+        Render::PointLightAnimation anim;
+        anim.dt = 0.5f;
+        anim.boundsMin = Math::vec3(-1.0f, -1.0f, -1.0f);
+        anim.boundsMax = Math::vec3(1.0f, 1.0f, 1.0f);
+        lights.AnimatePointLights(anim);
+        bool moved = true;
+        for (const auto& h : handles) {
+            const auto p = lights.GetPointLight(h).GetPos();
+            moved = moved && p.x == 0.5f && p.y == -1.0f && p.z == 0.0f;
+        }
+        VERIFY(moved);
+
+        // past a face the light is clamped onto it and heads back inside: y turns on the second
+        // step and is back at 0 on the third, x turns on the third
+        lights.AnimatePointLights(anim);
+        lights.AnimatePointLights(anim);
+        bool bounced = true;
+        const auto& arrays = lights.GetPointLights();
+        for (std::size_t i = 0; i < arrays.size(); ++i)
+            bounced = bounced && arrays.x[i] == 1.0f && arrays.vx[i] < 0.0f && arrays.y[i] == 0.0f && arrays.vy[i] > 0.0f;
+        VERIFY(bounced);
+
+        // a full pulse dips to 1 - depth and comes back
+        anim.dt = 0.25f;
+        anim.pulseRate = 1.0f;
+        anim.pulseDepth = 0.5f;
+        float lowest = 1.0f;
+        for (int i = 0; i < 8; ++i) {
+            lights.AnimatePointLights(anim);
+            for (float v : arrays.intensity) lowest = std::min(lowest, v);
+        }
+        bool inRange = true;
+        for (float v : arrays.intensity) inRange = inRange && v >= 0.5f && v <= 1.0f;
+        VERIFY(inRange && lowest < 0.75f);
+    }
+
+    {
+        printf("benchmark:\n");
+
+        Render::LightManager serial;
+        Render::LightManager parallel;
+        for (int i = 0; i < 100000; ++i) {
+            const Math::vec3 v(Math::Random::rand_float(-5.0f, 5.0f), 0.0f, Math::Random::rand_float(-5.0f, 5.0f));
+            serial.PushPointLight(MakeLight((float)(i % 40) - 20.0f), v);
+            parallel.PushPointLight(MakeLight((float)(i % 40) - 20.0f), v);
+        }
+
+        Render::PointLightAnimation anim;
+        anim.dt = 1.0f / 60.0f;
+        anim.boundsMin = Math::vec3(-20.0f, 0.0f, -11.0f);
+        anim.boundsMax = Math::vec3(24.0f, 12.0f, 9.0f);
+        anim.pulseRate = 0.5f;
+        anim.pulseDepth = 0.3f;
+        for (int i = 0; i < 100; ++i) {
+            serial.AnimatePointLights(anim);
+            parallel.AnimatePointLights(anim, &pool);
+        }
+        printf("  100000 point lights, serial:\n");
+        serial.PrintStats(std::cout);
+        printf("  pool of %u workers:\n", (unsigned)pool.GetWorkerCount());
+        parallel.PrintStats(std::cout);
+        VERIFY(serial.GetPointLights().x == parallel.GetPointLights().x);
+        VERIFY(serial.GetPointLights().intensity == parallel.GetPointLights().intensity);
+    }
+
+    //------------------------------------------------------------------------
+    printf("--- Done\n\n");
+    if (failedTests.empty())
+    {
+        printf("--- %u/%u tests passed!\n\n", testId, testId);
+        return 0;
+    }
+    for (auto t : failedTests)
+        printf("Test #%u failed. Line %u, Expression: %s\n", t.id, t.line, t.expr.c_str());
+    printf("--- %u/%u tests failed!\n\n", (unsigned)failedTests.size(), testId);
+    return 1;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <string>
+
+#include "config.h"
+
+#include "render/renderQueue.h"
+
+const char* programName = "Render queue";
+const char* s = "OK";
+const char* f = "FAILED";
+
+typedef unsigned TestId;
+typedef unsigned Line;
+typedef std::string Expression;
+struct FailedTest {
+    TestId id;
+    Line line;
+    Expression expr;
+};
+static TestId testId = 0;
+static std::vector<FailedTest> failedTests;
+#define VERIFY(RESULT) {  testId++; printf("#%0*u: %*s\n", 3, testId, 6, RESULT ? s : f); if (!(RESULT)) failedTests.push_back({testId, __LINE__, #RESULT}); }
+
+using Render::RenderQueue;
+using Render::RenderPass;
+
+// the radix sort against std::stable_sort of the indices, keys and order must both match, so
+// equal keys keep their push order
+static bool MatchesStableSort(const std::vector<uint64>& keys)
+{
+    std::vector<uint32> expected(keys.size());
+    std::iota(expected.begin(), expected.end(), 0u);
+    std::stable_sort(expected.begin(), expected.end(), [&](uint32 a, uint32 b) { return keys[a] < keys[b]; });
+
+    std::vector<uint64> sorted = keys;
+    std::vector<uint32> order;
+    std::vector<uint64> scratchKeys;
+    std::vector<uint32> scratchOrder;
+    RenderQueue::RadixSort(sorted, order, scratchKeys, scratchOrder);
+    if (order != expected) return false;
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        if (sorted[i] != keys[expected[i]]) return false;
+    return true;
+}
+
+int main()
+{
+    printf("\n\n--- %s test\n", programName);
+
+    std::mt19937_64 rng(1234);
+
+    {
+        printf("radix sort:\n");
+
+        for (std::size_t n : { 0, 1, 2, 7, 1000, 100000 }) {
+            // every byte differs
+            std::vector<uint64> keys(n);
+            for (auto& k : keys) k = rng();
+            VERIFY(MatchesStableSort(keys));
+
+            // only a few middle bytes differ, the shared ones are skipped
+            for (auto& k : keys) k = 0x1200000000000034ull | (rng() & 0x0000FFFF00FF0000ull);
+            VERIFY(MatchesStableSort(keys));
+
+            // a handful of distinct keys, stability decides almost the whole order
+            for (auto& k : keys) k = (rng() % 5) << 40;
+            VERIFY(MatchesStableSort(keys));
+        }
+
+        // keys from MakeKey, the shape a frame actually has: one pass, few shaders and vertex arrays
+        std::vector<uint64> keys;
+        std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+        for (int i = 0; i < 20000; ++i)
+            keys.push_back(RenderQueue::MakeKey(RenderPass::Geometry, (uint32)(rng() % 4), (uint32)(rng() % 300), (uint32)(rng() % 60), depth(rng)));
+        VERIFY(MatchesStableSort(keys));
+
+        // scratch buffers reused from a larger sort hold stale keys, they must not leak into the result
+        std::vector<uint64> sorted(64);
+        std::vector<uint32> order;
+        std::vector<uint64> scratchKeys(100000, ~0ull);
+        std::vector<uint32> scratchOrder(100000, ~0u);
+        for (auto& k : sorted) k = rng();
+        std::vector<uint64> expected = sorted;
+        std::sort(expected.begin(), expected.end());
+        RenderQueue::RadixSort(sorted, order, scratchKeys, scratchOrder);
+        VERIFY(sorted == expected && order.size() == 64);
+    }
+
+    {
+        printf("keys:\n");
+
+        const uint64 base = RenderQueue::MakeKey(RenderPass::Geometry, 3, 7, 9, 10.0f);
+        // shader outranks material, material outranks vertex array, and that outranks depth
+        VERIFY(base < RenderQueue::MakeKey(RenderPass::Geometry, 4, 0, 0, 0.0f));
+        VERIFY(base < RenderQueue::MakeKey(RenderPass::Geometry, 3, 8, 0, 0.0f));
+        VERIFY(base < RenderQueue::MakeKey(RenderPass::Geometry, 3, 7, 10, 0.0f));
+        // front to back within a run, behind the camera clamps to the front
+        VERIFY(base < RenderQueue::MakeKey(RenderPass::Geometry, 3, 7, 9, 10.5f));
+        VERIFY(RenderQueue::MakeKey(RenderPass::Geometry, 3, 7, 9, -4.0f) == RenderQueue::MakeKey(RenderPass::Geometry, 3, 7, 9, 0.0f));
+        // ids wrap within their bits instead of spilling into the field above
+        VERIFY(RenderQueue::MakeKey(RenderPass::Geometry, 3, 7, 9 + (1u << RenderQueue::vertexArrayBits), 10.0f) == base);
+    }
+
+    //------------------------------------------------------------------------
+    printf("--- Done\n\n");
+    if (failedTests.empty())
+    {
+        printf("--- %u/%u tests passed!\n\n", testId, testId);
+        return 0;
+    }
+    for (auto t : failedTests)
+        printf("Test #%u failed. Line %u, Expression: %s\n", t.id, t.line, t.expr.c_str());
+    printf("--- %u/%u tests failed!\n\n", (unsigned)failedTests.size(), testId);
+    return 1;
+}
@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <string>
+
+#include "config.h"
+
+#include "render/bcEncoder.h"
+#include "render/mipGenerator.h"
+#include "render/texture.h"
+#include "util/threadPool.h"
+
+const char* programName = "Texture pipeline";
+const char* s = "OK";
+const char* f = "FAILED";
+
+typedef unsigned TestId;
+typedef unsigned Line;
+typedef std::string Expression;
+struct FailedTest {
+    TestId id;
+    Line line;
+    Expression expr;
+};
+static TestId testId = 0;
+static std::vector<FailedTest> failedTests;
+#define VERIFY(RESULT) {  testId++; printf("#%0*u: %*s\n", 3, testId, 6, RESULT ? s : f); if (!(RESULT)) failedTests.push_back({testId, __LINE__, #RESULT}); }
+
+using Resource::ImageData;
+using Resource::PixelFormat;
+using Resource::BCQuality;
+
+// gradients with a little noise, and alpha that ramps on the right half
+static ImageData MakeImage(int width, int height)
+{
+    ImageData img;
+    img.width = width;
+    img.height = height;
+    img.pixels.resize((std::size_t)width * height * 4);
+    std::mt19937 rng(7);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uchar* p = &img.pixels[((std::size_t)y * width + x) * 4];
+            p[0] = (uchar)((x * 255 / width + rng() % 16) & 255);
+            p[1] = (uchar)(y * 255 / height);
+            p[2] = (uchar)(((x + y) * 2) & 255);
+            p[3] = (uchar)(x > width / 2 ? (x * 3) & 255 : 255);
+        }
+    }
+    img.levels.push_back({ width, height, 0, img.pixels.size() });
+    return img;
+}
+
+// foliage like alpha: soft blobs of which under a third pass a 0.5 cutoff
+static ImageData MakeAlphaTested(int width, int height)
+{
+    ImageData img;
+    img.width = width;
+    img.height = height;
+    img.pixels.resize((std::size_t)width * height * 4);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uchar* p = &img.pixels[((std::size_t)y * width + x) * 4];
+            const float a = 0.3f + 0.7f * std::sin(x / 5.0f) * std::sin(y / 7.0f);
+            p[0] = (uchar)(x * 255 / width);
+            p[1] = (uchar)(y * 255 / height);
+            p[2] = 90;
+            p[3] = (uchar)std::lround(std::clamp(a, 0.0f, 1.0f) * 255.0f);
+        }
+    }
+    img.levels.push_back({ width, height, 0, img.pixels.size() });
+    return img;
+}
+
+//------------------------------------------------------------------------------
+// block decoders written from the format specs, independent of the encoder's own decoder, so a
+// bit layout the encoder and Decompress agree on but the GPU would not still fails
+
+struct Bits {
+    const uchar* in;
+    int pos = 0;
+    unsigned Get(int count)
+    {
+        unsigned value = 0;
+        for (int i = 0; i < count; ++i, ++pos)
+            value |= (unsigned)((in[pos >> 3] >> (pos & 7)) & 1) << i;
+        return value;
+    }
+};
+
+static void SpecBC1(const uchar* in, uchar* rgba, bool alwaysFourColor)
+{
+    const unsigned c0 = in[0] | (in[1] << 8);
+    const unsigned c1 = in[2] | (in[3] << 8);
+    int palette[4][4];
+    for (int e = 0; e < 2; ++e) {
+        const unsigned c = e == 0 ? c0 : c1;
+        const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        palette[e][0] = (r << 3) | (r >> 2);
+        palette[e][1] = (g << 2) | (g >> 4);
+        palette[e][2] = (b << 3) | (b >> 2);
+        palette[e][3] = 255;
+    }
+    const bool fourColor = alwaysFourColor || c0 > c1;
+    for (int ch = 0; ch < 3; ++ch) {
+        if (fourColor) {
+            palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+            palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+        } else {
+            palette[2][ch] = (palette[0][ch] + palette[1][ch]) / 2;
+            palette[3][ch] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = fourColor ? 255 : 0;
+    Bits bits{ in + 4 };
+    for (int i = 0; i < 16; ++i) {
+        const unsigned k = bits.Get(2);
+        for (int ch = 0; ch < 4; ++ch) rgba[i * 4 + ch] = (uchar)palette[k][ch];
+    }
+}
+
+static void SpecBC4(const uchar* in, uchar* rgba, int channel)
+{
+    const int r0 = in[0], r1 = in[1];
+    int palette[8] = { r0, r1 };
+    if (r0 > r1) {
+        for (int k = 1; k < 7; ++k) palette[k + 1] = ((7 - k) * r0 + k * r1 + 3) / 7;
+    } else {
+        for (int k = 1; k < 5; ++k) palette[k + 1] = ((5 - k) * r0 + k * r1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    Bits bits{ in + 2 };
+    for (int i = 0; i < 16; ++i) rgba[i * 4 + channel] = (uchar)palette[bits.Get(3)];
+}
+
+// mode 6: the mode bit, 7 bit RGBA endpoints, a p-bit each, and 4 bit indices of which the
+// anchor, the first, drops its implicit top bit
+static void SpecBC7(const uchar* in, uchar* rgba)
+{
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    Bits bits{ in };
+    if (bits.Get(7) != 0x40) {
+        std::memset(rgba, 0, 64);
+        return;
+    }
+    int e[2][4];
+    for (int ch = 0; ch < 4; ++ch) {
+        e[0][ch] = (int)bits.Get(7);
+        e[1][ch] = (int)bits.Get(7);
+    }
+    const int p0 = (int)bits.Get(1), p1 = (int)bits.Get(1);
+    for (int ch = 0; ch < 4; ++ch) {
+        e[0][ch] = (e[0][ch] << 1) | p0;
+        e[1][ch] = (e[1][ch] << 1) | p1;
+    }
+    for (int i = 0; i < 16; ++i) {
+        const int w = weights[bits.Get(i == 0 ? 3 : 4)];
+        for (int ch = 0; ch < 4; ++ch) rgba[i * 4 + ch] = (uchar)(((64 - w) * e[0][ch] + w * e[1][ch] + 32) >> 6);
+    }
+}
+
+static void SpecBlock(PixelFormat format, const uchar* in, uchar* rgba)
+{
+    std::memset(rgba, 0, 64);
+    for (int i = 0; i < 16; ++i) rgba[i * 4 + 3] = 255;
+    switch (format) {
+    case PixelFormat::BC1: SpecBC1(in, rgba, false); break;
+    case PixelFormat::BC3: SpecBC1(in + 8, rgba, true); SpecBC4(in, rgba, 3); break;
+    case PixelFormat::BC4: SpecBC4(in, rgba, 0); break;
+    case PixelFormat::BC5: SpecBC4(in, rgba, 0); SpecBC4(in + 8, rgba, 1); break;
+    case PixelFormat::BC7: SpecBC7(in, rgba); break;
+    default: break;
+    }
+}
+
+// level 0 through the spec decoders against BCn::Decompress, texel for texel
+static bool MatchesSpec(const ImageData& compressed)
+{
+    const ImageData decoded = Resource::BCn::Decompress(compressed);
+    const std::size_t blockBytes = compressed.format == PixelFormat::BC1 || compressed.format == PixelFormat::BC4 ? 8 : 16;
+    const int blocksWide = (compressed.width + 3) / 4;
+    const int blocksHigh = (compressed.height + 3) / 4;
+    uchar block[64];
+    for (int by = 0; by < blocksHigh; ++by) {
+        for (int bx = 0; bx < blocksWide; ++bx) {
+            SpecBlock(compressed.format, compressed.LevelData(0) + ((std::size_t)by * blocksWide + bx) * blockBytes, block);
+            for (int y = 0; y < 4 && by * 4 + y < compressed.height; ++y) {
+                for (int x = 0; x < 4 && bx * 4 + x < compressed.width; ++x) {
+                    const uchar* a = block + (y * 4 + x) * 4;
+                    const uchar* b = decoded.LevelData(0) + ((std::size_t)(by * 4 + y) * compressed.width + bx * 4 + x) * 4;
+                    for (int ch = 0; ch < 4; ++ch)
+                        if (std::abs(a[ch] - b[ch]) > 1) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static ImageData OneBlock(PixelFormat format, const uchar* encoded)
+{
+    ImageData img;
+    img.width = 4;
+    img.height = 4;
+    img.format = format;
+    const std::size_t size = format == PixelFormat::BC1 || format == PixelFormat::BC4 ? 8 : 16;
+    img.pixels.assign(encoded, encoded + size);
+    img.levels.push_back({ 4, 4, 0, size });
+    return img;
+}
+
+int main()
+{
+    printf("\n\n--- %s test\n", programName);
+
+    Utils::ThreadPool pool;
+    const ImageData image = MakeImage(257, 131);
+
+    {
+        printf("block compression:\n");
+
+        // PSNR floors per format at normal quality, a few dB under what the encoder reaches
+        struct Case { PixelFormat format; float64 minPSNR; };
+        const Case cases[] = {
+            { PixelFormat::BC1, 33.0 },
+            { PixelFormat::BC3, 34.0 },
+            { PixelFormat::BC4, 44.0 },
+            { PixelFormat::BC5, 46.0 },
+            { PixelFormat::BC7, 34.0 },
+        };
+        for (const Case& c : cases) {
+            const ImageData normal = Resource::BCn::Compress(image, c.format, BCQuality::Normal, &pool);
+            VERIFY(normal.format == c.format && normal.levels.size() == 9);
+            VERIFY(Resource::BCn::PSNR(image, normal) > c.minPSNR);
+            VERIFY(MatchesSpec(normal));
+
+            // the pool splits rows of blocks, it must not change a byte
+            const ImageData serial = Resource::BCn::Compress(image, c.format, BCQuality::Normal);
+            VERIFY(serial.pixels == normal.pixels);
+
+            const ImageData high = Resource::BCn::Compress(image, c.format, BCQuality::High, &pool);
+            VERIFY(Resource::BCn::PSNR(image, high) >= Resource::BCn::PSNR(image, normal));
+        }
+    }
+
+    {
+        printf("format choice:\n");
+
+        using Resource::BCn::ChooseFormat;
+        VERIFY(ChooseFormat(image, BCQuality::Normal) == PixelFormat::BC3);
+        VERIFY(ChooseFormat(image, BCQuality::High) == PixelFormat::BC7);
+
+        ImageData opaque = image;
+        for (std::size_t i = 3; i < opaque.pixels.size(); i += 4) opaque.pixels[i] = 255;
+        VERIFY(ChooseFormat(opaque, BCQuality::Normal) == PixelFormat::BC1);
+
+        // an occlusion like gray map and a two channel data map keep their own formats even at high quality
+        ImageData gray = opaque;
+        for (std::size_t i = 0; i < gray.pixels.size(); i += 4) gray.pixels[i + 1] = gray.pixels[i + 2] = gray.pixels[i];
+        VERIFY(ChooseFormat(gray, BCQuality::Normal) == PixelFormat::BC4);
+        VERIFY(ChooseFormat(gray, BCQuality::High) == PixelFormat::BC4);
+
+        ImageData twoChannel = opaque;
+        for (std::size_t i = 0; i < twoChannel.pixels.size(); i += 4) twoChannel.pixels[i + 2] = 0;
+        VERIFY(ChooseFormat(twoChannel, BCQuality::High) == PixelFormat::BC5);
+    }
+
+    {
+        printf("block layouts:\n");
+
+        uchar block[64];
+        uchar out[16];
+        uchar decoded[64];
+
+        // a flat color quantizes both ends to the same 565 value, which reads as the three color
+        // mode, so no index may pick its transparent black
+        for (int i = 0; i < 16; ++i) {
+            block[i * 4 + 0] = 200; block[i * 4 + 1] = 100; block[i * 4 + 2] = 50; block[i * 4 + 3] = 255;
+        }
+        Resource::BCn::EncodeBC1(block, out, BCQuality::Normal);
+        SpecBC1(out, decoded, false);
+        bool opaque = true;
+        for (int i = 0; i < 16; ++i) opaque = opaque && decoded[i * 4 + 3] == 255 && std::abs(decoded[i * 4] - 200) <= 4;
+        VERIFY(opaque);
+
+        // two grays far apart: whichever order the fit lands on, the ends are written larger first,
+        // or the decoder reads the three color mode and one of them turns transparent
+        for (int i = 0; i < 16; ++i) {
+            const uchar v = (i & 1) ? 240 : 16;
+            block[i * 4 + 0] = v; block[i * 4 + 1] = v; block[i * 4 + 2] = v; block[i * 4 + 3] = 255;
+        }
+        Resource::BCn::EncodeBC1(block, out, BCQuality::High);
+        const unsigned c0 = out[0] | (out[1] << 8);
+        const unsigned c1 = out[2] | (out[3] << 8);
+        VERIFY(c0 > c1);
+        SpecBC1(out, decoded, false);
+        bool exact = true;
+        for (int i = 0; i < 16; ++i) exact = exact && decoded[i * 4 + 3] == 255 && std::abs(decoded[i * 4] - block[i * 4]) <= 8;
+        VERIFY(exact);
+
+        // mid grays plus hard 0 and 255 texels: the 6 value mode gets the extremes for free, so
+        // they must come back exactly
+        for (int i = 0; i < 16; ++i) block[i * 4] = (uchar)(i == 0 ? 0 : i == 15 ? 255 : 100 + i * 3);
+        Resource::BCn::EncodeBC4(block, out, BCQuality::Normal, 0);
+        VERIFY(out[0] <= out[1]);
+        SpecBC4(out, decoded, 0);
+        bool extremes = decoded[0] == 0 && decoded[15 * 4] == 255;
+        for (int i = 1; i < 15; ++i) extremes = extremes && std::abs(decoded[i * 4] - block[i * 4]) <= 4;
+        VERIFY(extremes);
+
+        // a smooth ramp fits the 8 value mode
+        for (int i = 0; i < 16; ++i) block[i * 4] = (uchar)(40 + i * 8);
+        Resource::BCn::EncodeBC4(block, out, BCQuality::Normal, 0);
+        VERIFY(out[0] > out[1]);
+        SpecBC4(out, decoded, 0);
+        bool ramp = true;
+        for (int i = 0; i < 16; ++i) ramp = ramp && std::abs(decoded[i * 4] - block[i * 4]) <= 9;
+        VERIFY(ramp);
+
+        // random blocks through BC7: always mode 6, and the anchor index never needs its top bit
+        std::mt19937 rng(99);
+        bool mode6 = true;
+        bool close = true;
+        for (int n = 0; n < 256; ++n) {
+            for (int i = 0; i < 64; ++i) block[i] = (uchar)(rng() & 255);
+            Resource::BCn::EncodeBC7(block, out, BCQuality::Normal);
+            mode6 = mode6 && (out[0] & 0x7F) == 0x40;
+            SpecBC7(out, decoded);
+            const ImageData back = Resource::BCn::Decompress(OneBlock(PixelFormat::BC7, out));
+            close = close && std::memcmp(back.LevelData(0), decoded, 64) == 0;
+        }
+        VERIFY(mode6);
+        VERIFY(close);
+    }
+
+    {
+        printf("alpha coverage:\n");
+
+        const ImageData foliage = MakeAlphaTested(512, 256);
+        const float cutoff = 0.5f;
+        const float target = Resource::Mips::AlphaCoverage(foliage, 0, cutoff);
+        VERIFY(target > 0.2f && target < 0.4f);
+
+        for (Resource::MipFilter filter : { Resource::MipFilter::Box, Resource::MipFilter::Kaiser, Resource::MipFilter::Lanczos }) {
+            Resource::MipSettings settings;
+            settings.filter = filter;
+
+            // plain filtering averages the blobs away and the smaller levels go bare
+            const ImageData plain = Resource::Mips::Generate(foliage, settings, &pool);
+            VERIFY(plain.levels.size() == 10 && plain.levels.back().width == 1 && plain.levels.back().height == 1);
+            float drift = 0.0f;
+            for (std::size_t l = 0; l < plain.levels.size(); ++l)
+                drift = std::max(drift, std::abs(Resource::Mips::AlphaCoverage(plain, l, cutoff) - target));
+            VERIFY(drift > 0.2f);
+
+            // with the cutoff every level keeps level 0's coverage, as close as its texel count allows
+            settings.alphaCutoff = cutoff;
+            const ImageData fitted = Resource::Mips::Generate(foliage, settings, &pool);
+            bool kept = fitted.levels.size() == plain.levels.size();
+            for (std::size_t l = 1; kept && l < fitted.levels.size(); ++l) {
+                const float texels = (float)fitted.levels[l].width * fitted.levels[l].height;
+                kept = std::abs(Resource::Mips::AlphaCoverage(fitted, l, cutoff) - target) <= 0.5f / texels + 0.01f;
+            }
+            VERIFY(kept);
+
+            // the fit never touches color
+            bool sameColor = true;
+            for (std::size_t i = 0; sameColor && i < plain.pixels.size(); i += 4)
+                sameColor = std::equal(&plain.pixels[i], &plain.pixels[i] + 3, &fitted.pixels[i]);
+            VERIFY(sameColor);
+        }
+
+        // an opaque image stays opaque down to 1x1
+        ImageData opaque = foliage;
+        for (std::size_t i = 3; i < opaque.pixels.size(); i += 4) opaque.pixels[i] = 255;
+        Resource::MipSettings settings;
+        settings.alphaCutoff = cutoff;
+        const ImageData chain = Resource::Mips::Generate(opaque, settings, &pool);
+        bool allOpaque = true;
+        for (std::size_t l = 0; l < chain.levels.size(); ++l) allOpaque = allOpaque && Resource::Mips::AlphaCoverage(chain, l, 1.0f) == 1.0f;
+        VERIFY(allOpaque);
+    }
+
+    //------------------------------------------------------------------------
+    printf("--- Done\n\n");
+    if (failedTests.empty())
+    {
+        printf("--- %u/%u tests passed!\n\n", testId, testId);
+        return 0;
+    }
+    for (auto t : failedTests)
+        printf("Test #%u failed. Line %u, Expression: %s\n", t.id, t.line, t.expr.c_str());
+    printf("--- %u/%u tests failed!\n\n", (unsigned)failedTests.size(), testId);
+    return 1;
+}